@@ -0,0 +1,399 @@
+/**
+ * @file bitmap.h
+ * @brief Bit-packed 1 bit image with 64 bit word operations: rt::Bitmap
+ * @see https://github.com/rktrlng/pixelbuffer
+ */
+
+#ifndef BITMAP_H
+#define BITMAP_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+#include <pixelbuffer/color.h>
+#include <pixelbuffer/pixelbuffer.h>
+#include <pixelbuffer/imagebuffer.h>
+
+namespace rt {
+
+// One bit per pixel, 64 pixels per uint64_t word. Every row starts at a new
+// word. Like 1 bit pbf pixeldata the most significant bit comes first: pixel x
+// is bit 63 - x%64 of word x/64, so the bytes of a word (most significant
+// first) are the bytes of the pbf. Bits beyond the width are always 0.
+// Logic operations, counting and shifting work on whole words.
+class Bitmap
+{
+private:
+	uint16_t m_width = 0;
+	uint16_t m_height = 0;
+	size_t m_words = 0; // words per row
+	std::vector<uint64_t> m_data;
+
+	void _init(uint16_t width, uint16_t height)
+	{
+		m_width = width;
+		m_height = height;
+		m_words = (width + 63) / 64;
+		m_data.assign(m_words * height, 0);
+	}
+
+	// the valid bits of the last word of a row
+	uint64_t _lastmask() const
+	{
+		const size_t bits = m_width % 64;
+		return bits == 0 ? ~0ull : ~0ull << (64 - bits);
+	}
+
+	void _clearPadding()
+	{
+		if (m_width % 64 == 0) { return; }
+		const uint64_t mask = _lastmask();
+		for (size_t y = 0; y < m_height; y++) { row(y)[m_words - 1] &= mask; }
+	}
+
+	static int _popcount(uint64_t w)
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		return __builtin_popcountll(w);
+#else
+		w = w - ((w >> 1) & 0x5555555555555555ull);
+		w = (w & 0x3333333333333333ull) + ((w >> 2) & 0x3333333333333333ull);
+		w = (w + (w >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+		return (int) ((w * 0x0101010101010101ull) >> 56);
+#endif
+	}
+
+	// the 8 pixels of every byte value, most significant bit first
+	static std::vector<RGBAColor> _makeUnpackTable()
+	{
+		std::vector<RGBAColor> table(256 * 8);
+		for (size_t value = 0; value < 256; value++) {
+			for (size_t bit = 0; bit < 8; bit++) {
+				table[value * 8 + bit] = ((value >> (7 - bit)) & 1) ? RGBAColor(255, 255, 255, 255) : RGBAColor(0, 0, 0, 255);
+			}
+		}
+		return table;
+	}
+
+	static const RGBAColor* _unpackTable()
+	{
+		static const std::vector<RGBAColor> table = _makeUnpackTable();
+		return table.data();
+	}
+
+	// binary operation on all words of two bitmaps of the same size
+	template <class Op>
+	Bitmap& _apply(const Bitmap& other, Op op)
+	{
+		if (other.m_width != m_width || other.m_height != m_height) { return *this; }
+		for (size_t i = 0; i < m_data.size(); i++) { m_data[i] = op(m_data[i], other.m_data[i]); }
+		return *this;
+	}
+
+public:
+	Bitmap() { }
+
+	Bitmap(uint16_t width, uint16_t height, bool value = false)
+	{
+		_init(width, height);
+		fill(value);
+	}
+
+	explicit Bitmap(const PixelBuffer& pb)
+	{
+		fromPixelBuffer(pb);
+	}
+
+	explicit Bitmap(const std::string& filename)
+	{
+		read(filename);
+	}
+
+	uint16_t width() const { return m_width; }
+	uint16_t height() const { return m_height; }
+	size_t wordsPerRow() const { return m_words; }
+	bool valid() const { return m_width > 0 && m_height > 0 && m_data.size() == m_words * m_height; }
+
+	uint64_t* data() { return m_data.data(); }
+	const uint64_t* data() const { return m_data.data(); }
+	uint64_t* row(size_t y) { return &m_data[y * m_words]; }
+	const uint64_t* row(size_t y) const { return &m_data[y * m_words]; }
+
+	int setPixel(int x, int y, bool value)
+	{
+		if ( (x < 0) || (x >= m_width) || (y < 0) || (y >= m_height) ) {
+			return 0;
+		}
+		const uint64_t bit = 1ull << (63 - x % 64);
+		uint64_t& word = row(y)[x / 64];
+		word = value ? (word | bit) : (word & ~bit);
+		return 1;
+	}
+
+	bool getPixel(int x, int y) const
+	{
+		if ( (x < 0) || (x >= m_width) || (y < 0) || (y >= m_height) ) {
+			return false;
+		}
+		return (row(y)[x / 64] >> (63 - x % 64)) & 1;
+	}
+
+	void fill(bool value)
+	{
+		std::fill(m_data.begin(), m_data.end(), value ? ~0ull : 0ull);
+		_clearPadding();
+	}
+
+	// =========================================================
+	// word operations
+	// =========================================================
+
+	// (other must have the same size, otherwise nothing changes)
+	Bitmap& operator&=(const Bitmap& other) { return _apply(other, [](uint64_t a, uint64_t b) { return a & b; }); }
+	Bitmap& operator|=(const Bitmap& other) { return _apply(other, [](uint64_t a, uint64_t b) { return a | b; }); }
+	Bitmap& operator^=(const Bitmap& other) { return _apply(other, [](uint64_t a, uint64_t b) { return a ^ b; }); }
+	// clear the pixels that are set in other
+	Bitmap& andNot(const Bitmap& other) { return _apply(other, [](uint64_t a, uint64_t b) { return a & ~b; }); }
+
+	Bitmap operator&(const Bitmap& other) const { Bitmap b = *this; return b &= other; }
+	Bitmap operator|(const Bitmap& other) const { Bitmap b = *this; return b |= other; }
+	Bitmap operator^(const Bitmap& other) const { Bitmap b = *this; return b ^= other; }
+	Bitmap operator~() const { Bitmap b = *this; b.invert(); return b; }
+
+	bool operator==(const Bitmap& other) const
+	{
+		return m_width == other.m_width && m_height == other.m_height && m_data == other.m_data;
+	}
+	bool operator!=(const Bitmap& other) const { return !(*this == other); }
+
+	// NOT
+	void invert()
+	{
+		for (uint64_t& word : m_data) { word = ~word; }
+		_clearPadding();
+	}
+
+	// number of set pixels
+	size_t count() const
+	{
+		size_t total = 0;
+		for (uint64_t word : m_data) { total += _popcount(word); }
+		return total;
+	}
+
+	// number of set pixels in row y
+	size_t count(size_t y) const
+	{
+		size_t total = 0;
+		const uint64_t* r = row(y);
+		for (size_t i = 0; i < m_words; i++) { total += _popcount(r[i]); }
+		return total;
+	}
+
+	// Move all pixels dx to the right and dy down (negative: left, up).
+	// Pixels shifted out are lost, pixels shifted in are 0.
+	void shift(int dx, int dy)
+	{
+		if (dx != 0) {
+			for (size_t y = 0; y < m_height; y++) { _shiftRow(row(y), dx); }
+			_clearPadding();
+		}
+		const size_t offset = (size_t) std::abs(dy) * m_words;
+		if (offset >= m_data.size()) {
+			std::fill(m_data.begin(), m_data.end(), 0);
+		} else if (dy > 0) {
+			std::copy_backward(m_data.begin(), m_data.end() - offset, m_data.end());
+			std::fill(m_data.begin(), m_data.begin() + offset, 0);
+		} else if (dy < 0) {
+			std::copy(m_data.begin() + offset, m_data.end(), m_data.begin());
+			std::fill(m_data.end() - offset, m_data.end(), 0);
+		}
+	}
+
+private:
+	void _shiftRow(uint64_t* r, int dx)
+	{
+		const size_t n = m_words;
+		const size_t distance = std::abs(dx);
+		const size_t words = distance / 64;
+		const size_t bits = distance % 64;
+		if (words >= n) { std::fill(r, r + n, 0); return; }
+		if (dx > 0) {
+			// to the right: towards the less significant bits and the next words
+			for (size_t i = n; i-- > 0; ) {
+				uint64_t value = 0;
+				if (i >= words) {
+					value = r[i - words] >> bits;
+					if (bits > 0 && i >= words + 1) { value |= r[i - words - 1] << (64 - bits); }
+				}
+				r[i] = value;
+			}
+		} else {
+			for (size_t i = 0; i < n; i++) {
+				uint64_t value = 0;
+				if (i + words < n) {
+					value = r[i + words] << bits;
+					if (bits > 0 && i + words + 1 < n) { value |= r[i + words + 1] >> (64 - bits); }
+				}
+				r[i] = value;
+			}
+		}
+	}
+
+public:
+	// =========================================================
+	// conversion
+	// =========================================================
+
+	// pbf 1 bit pixeldata of a row: (width + 7) / 8 bytes
+	size_t rowBytes() const { return (m_width + 7) / 8; }
+
+	// row y as pbf pixeldata
+	void packRow(size_t y, uint8_t* dst) const
+	{
+		const uint64_t* r = row(y);
+		for (size_t i = 0; i < rowBytes(); i++) {
+			dst[i] = (r[i / 8] >> (56 - 8 * (i % 8))) & 0xFF;
+		}
+	}
+
+	// set row y from pbf pixeldata
+	void unpackRow(size_t y, const uint8_t* src)
+	{
+		uint64_t* r = row(y);
+		std::fill(r, r + m_words, 0);
+		for (size_t i = 0; i < rowBytes(); i++) {
+			r[i / 8] |= (uint64_t) src[i] << (56 - 8 * (i % 8));
+		}
+		if (m_words > 0) { r[m_words - 1] &= _lastmask(); }
+	}
+
+	// white (average >= 128, alpha >= 128) is 1, like 1 bit pbf files
+	int fromPixelBuffer(const PixelBuffer& pb)
+	{
+		if (!pb.valid()) { return 0; }
+		if (pb.premultiplied()) {
+			PixelBuffer straight = pb;
+			straight.unpremultiply();
+			return fromPixelBuffer(straight);
+		}
+		_init(pb.width(), pb.height());
+		for (size_t y = 0; y < m_height; y++) {
+			const RGBAColor* src = pb.row(y);
+			uint64_t* dst = row(y);
+			for (size_t w = 0; w < m_words; w++) {
+				const size_t n = std::min<size_t>(64, m_width - w * 64);
+				uint64_t word = 0;
+				for (size_t b = 0; b < n; b++) {
+					const RGBAColor& c = src[w * 64 + b];
+					const uint64_t white = ((c.r + c.g + c.b) / 3 >= 128) & (c.a >= 128);
+					word |= white << (63 - b);
+				}
+				dst[w] = word;
+			}
+		}
+		return 1;
+	}
+
+	// 1 is white, 0 is black (opaque)
+	void toPixelBuffer(PixelBuffer& pb) const
+	{
+		if (pb.width() != m_width || pb.height() != m_height || !pb.valid() || pb.premultiplied()) {
+			pb = PixelBuffer(m_width, m_height, 1);
+		}
+		pb.bitdepth(1);
+		const RGBAColor* table = _unpackTable();
+		std::vector<uint8_t> bytes(rowBytes());
+		for (size_t y = 0; y < m_height; y++) {
+			packRow(y, bytes.data());
+			RGBAColor* dst = pb.row(y);
+			for (size_t x = 0; x < m_width; x += 8) {
+				const RGBAColor* pixels = &table[bytes[x / 8] * 8];
+				std::copy(pixels, pixels + std::min<size_t>(8, m_width - x), dst + x);
+			}
+		}
+	}
+
+	PixelBuffer toPixelBuffer() const
+	{
+		PixelBuffer pb(m_width, m_height, 1);
+		toPixelBuffer(pb);
+		return pb;
+	}
+
+	BitBuffer toBitBuffer() const
+	{
+		BitBuffer bits(m_width, m_height, false);
+		for (size_t y = 0; y < m_height; y++) { packRow(y, bits.row(y)); }
+		return bits;
+	}
+
+	void fromBitBuffer(const BitBuffer& bits)
+	{
+		_init(bits.width(), bits.height());
+		for (size_t y = 0; y < m_height; y++) { unpackRow(y, bits.row(y)); }
+	}
+
+	// =========================================================
+	// i/o
+	// =========================================================
+
+	// 1 bit pbf files (compressed or not) are read as is, others through a PixelBuffer
+	int read(const std::string& filename)
+	{
+		BitBuffer bits;
+		const int size = bits.read(filename);
+		if (!size) {
+			*this = Bitmap();
+			return 0;
+		}
+		fromBitBuffer(bits);
+		return size;
+	}
+
+	// a 1 bit pbf (the width must be a multiple of 8)
+	int write(const std::string& filename) const
+	{
+		if (!valid() || m_width % 8 != 0) {
+			std::cout << "Invalid bitmap, not writing: " << filename << std::endl;
+			return 0;
+		}
+
+		std::ofstream file(filename, std::fstream::out|std::fstream::binary|std::fstream::trunc);
+		if (!file.is_open()) {
+			std::cout << "Unable to write to file: " << filename << std::endl;
+			return 0;
+		}
+
+		PixelBuffer::PBHeader header;
+		header.width = m_width;
+		header.height = m_height;
+		header.bitdepth = 1;
+		file.write((const char*)&header, sizeof(header));
+		std::vector<uint8_t> bytes(rowBytes());
+		for (size_t y = 0; y < m_height; y++) {
+			packRow(y, bytes.data());
+			file.write((const char*)bytes.data(), bytes.size());
+		}
+		return file.good() ? 1 : 0;
+	}
+
+	// a compressed 1 bit pbf (see PixelBuffer::writeCompressed)
+	int writeCompressed(const std::string& filename, uint16_t bandrows = 64) const
+	{
+		if (!valid() || m_width % 8 != 0) {
+			std::cout << "Invalid bitmap, not writing: " << filename << std::endl;
+			return 0;
+		}
+		return toBitBuffer().writeCompressed(filename, bandrows);
+	}
+};
+
+} // namespace rt
+
+#endif // BITMAP_H
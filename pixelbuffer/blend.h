@@ -0,0 +1,202 @@
+/**
+ * @file blend.h
+ * @brief Blending whole spans of pixels at once: rt::blendSpan
+ * @see https://github.com/rktrlng/pixelbuffer
+ */
+
+#ifndef BLEND_H
+#define BLEND_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+	#include <emmintrin.h>
+	#define BLEND_SSE2
+#endif
+#if defined(__AVX2__)
+	#include <immintrin.h>
+	#define BLEND_AVX2
+#endif
+
+#include <pixelbuffer/color.h>
+
+namespace rt {
+
+// blendSpan() gives exactly the same pixels as rt::alphaBlend(src, dst) for
+// every pixel, but works on groups of 4 (SSE2) or 8 (AVX2) pixels:
+//   all opaque sources: copied
+//   all transparent sources: dst unchanged
+//   all opaque destinations: (src * a + dst * (255 - a)) / 255 on 16 bit lanes
+//   anything else: rt::alphaBlend per pixel
+
+#ifdef BLEND_SSE2
+// 4 pixels of src over 4 opaque pixels of dst
+inline __m128i _blend4_opaque(__m128i s, __m128i d)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i c255 = _mm_set1_epi16(255);
+	const __m128i c128 = _mm_set1_epi16(128);
+	// widen to 16 bit lanes: 2 pixels per register
+	__m128i slo = _mm_unpacklo_epi8(s, zero);
+	__m128i shi = _mm_unpackhi_epi8(s, zero);
+	__m128i dlo = _mm_unpacklo_epi8(d, zero);
+	__m128i dhi = _mm_unpackhi_epi8(d, zero);
+	// the alpha of each pixel in all 4 of its lanes
+	__m128i alo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(slo, 0xFF), 0xFF);
+	__m128i ahi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(shi, 0xFF), 0xFF);
+	// src * a + dst * (255 - a) + 128, then (x + (x >> 8)) >> 8
+	__m128i xlo = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(slo, alo), _mm_mullo_epi16(dlo, _mm_sub_epi16(c255, alo))), c128);
+	__m128i xhi = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(shi, ahi), _mm_mullo_epi16(dhi, _mm_sub_epi16(c255, ahi))), c128);
+	xlo = _mm_srli_epi16(_mm_add_epi16(xlo, _mm_srli_epi16(xlo, 8)), 8);
+	xhi = _mm_srli_epi16(_mm_add_epi16(xhi, _mm_srli_epi16(xhi, 8)), 8);
+	// the result is opaque
+	return _mm_or_si128(_mm_packus_epi16(xlo, xhi), _mm_set1_epi32((int) 0xFF000000));
+}
+#endif
+
+#ifdef BLEND_AVX2
+// 8 pixels of src over 8 opaque pixels of dst
+inline __m256i _blend8_opaque(__m256i s, __m256i d)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i c255 = _mm256_set1_epi16(255);
+	const __m256i c128 = _mm256_set1_epi16(128);
+	__m256i slo = _mm256_unpacklo_epi8(s, zero);
+	__m256i shi = _mm256_unpackhi_epi8(s, zero);
+	__m256i dlo = _mm256_unpacklo_epi8(d, zero);
+	__m256i dhi = _mm256_unpackhi_epi8(d, zero);
+	__m256i alo = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(slo, 0xFF), 0xFF);
+	__m256i ahi = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(shi, 0xFF), 0xFF);
+	__m256i xlo = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(slo, alo), _mm256_mullo_epi16(dlo, _mm256_sub_epi16(c255, alo))), c128);
+	__m256i xhi = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(shi, ahi), _mm256_mullo_epi16(dhi, _mm256_sub_epi16(c255, ahi))), c128);
+	xlo = _mm256_srli_epi16(_mm256_add_epi16(xlo, _mm256_srli_epi16(xlo, 8)), 8);
+	xhi = _mm256_srli_epi16(_mm256_add_epi16(xhi, _mm256_srli_epi16(xhi, 8)), 8);
+	return _mm256_or_si256(_mm256_packus_epi16(xlo, xhi), _mm256_set1_epi32((int) 0xFF000000));
+}
+#endif
+
+/**
+ * @brief blend count pixels of src over dst: dst[i] = alphaBlend(src[i], dst[i])
+ * @param dst the pixels to blend onto
+ * @param src the pixels to blend (may not overlap dst, unless src == dst)
+ * @param count number of pixels
+ */
+inline void blendSpan(RGBAColor* dst, const RGBAColor* src, size_t count)
+{
+	size_t i = 0;
+#ifdef BLEND_AVX2
+	{
+		const __m256i amask = _mm256_set1_epi32((int) 0xFF000000);
+		for (; i + 8 <= count; i += 8) {
+			__m256i s = _mm256_loadu_si256((const __m256i*)&src[i]);
+			__m256i sa = _mm256_and_si256(s, amask);
+			if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(sa, amask)) == -1) {
+				_mm256_storeu_si256((__m256i*)&dst[i], s);
+				continue;
+			}
+			if (_mm256_testz_si256(s, amask)) { continue; }
+			__m256i d = _mm256_loadu_si256((const __m256i*)&dst[i]);
+			if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(_mm256_and_si256(d, amask), amask)) == -1) {
+				_mm256_storeu_si256((__m256i*)&dst[i], _blend8_opaque(s, d));
+				continue;
+			}
+			for (size_t k = i; k < i + 8; k++) { dst[k] = rt::alphaBlend(src[k], dst[k]); }
+		}
+	}
+#endif
+#ifdef BLEND_SSE2
+	{
+		const __m128i amask = _mm_set1_epi32((int) 0xFF000000);
+		const __m128i zero = _mm_setzero_si128();
+		for (; i + 4 <= count; i += 4) {
+			__m128i s = _mm_loadu_si128((const __m128i*)&src[i]);
+			__m128i sa = _mm_and_si128(s, amask);
+			if (_mm_movemask_epi8(_mm_cmpeq_epi32(sa, amask)) == 0xFFFF) {
+				_mm_storeu_si128((__m128i*)&dst[i], s);
+				continue;
+			}
+			if (_mm_movemask_epi8(_mm_cmpeq_epi32(sa, zero)) == 0xFFFF) { continue; }
+			__m128i d = _mm_loadu_si128((const __m128i*)&dst[i]);
+			if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(d, amask), amask)) == 0xFFFF) {
+				_mm_storeu_si128((__m128i*)&dst[i], _blend4_opaque(s, d));
+				continue;
+			}
+			for (size_t k = i; k < i + 4; k++) { dst[k] = rt::alphaBlend(src[k], dst[k]); }
+		}
+	}
+#endif
+	for (; i < count; i++) {
+		const uint8_t a = src[i].a;
+		if (a == 255) { dst[i] = src[i]; }
+		else if (a != 0) { dst[i] = rt::alphaBlend(src[i], dst[i]); }
+	}
+}
+
+/**
+ * @brief blend one color over count pixels: dst[i] = alphaBlend(color, dst[i])
+ * @param dst the pixels to blend onto
+ * @param color the color to blend
+ * @param count number of pixels
+ */
+inline void blendSpan(RGBAColor* dst, RGBAColor color, size_t count)
+{
+	if (color.a == 255) {
+		for (size_t i = 0; i < count; i++) { dst[i] = color; }
+		return;
+	}
+	if (color.a == 0) { return; }
+
+	size_t i = 0;
+#ifdef BLEND_SSE2
+	{
+		const __m128i amask = _mm_set1_epi32((int) 0xFF000000);
+		uint32_t value;
+		std::memcpy(&value, (const void*)&color, sizeof(value));
+		const __m128i s = _mm_set1_epi32((int) value);
+		for (; i + 4 <= count; i += 4) {
+			__m128i d = _mm_loadu_si128((const __m128i*)&dst[i]);
+			if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(d, amask), amask)) == 0xFFFF) {
+				_mm_storeu_si128((__m128i*)&dst[i], _blend4_opaque(s, d));
+				continue;
+			}
+			for (size_t k = i; k < i + 4; k++) { dst[k] = rt::alphaBlend(color, dst[k]); }
+		}
+	}
+#endif
+	for (; i < count; i++) {
+		dst[i] = rt::alphaBlend(color, dst[i]);
+	}
+}
+
+// what the alpha channel of a brush holds, see rt::alphaSummary()
+enum AlphaSummary {
+	ALPHA_UNKNOWN = 0,     // not looked at: every pixel is checked
+	ALPHA_OPAQUE,          // all pixels have alpha 255: rows are copied
+	ALPHA_TRANSPARENT,     // all pixels have alpha 0: nothing to do
+	ALPHA_MIXED            // anything else: rows are blended
+};
+
+/**
+ * @brief look at the alpha of count pixels once, so it doesn't have to be
+ * checked again every time they are pasted
+ * @param pixels the pixels
+ * @param count number of pixels
+ * @return AlphaSummary (ALPHA_TRANSPARENT if count is 0)
+ */
+inline AlphaSummary alphaSummary(const RGBAColor* pixels, size_t count)
+{
+	uint8_t all = 255;
+	uint8_t any = 0;
+	for (size_t i = 0; i < count; i++) {
+		all &= pixels[i].a;
+		any |= pixels[i].a;
+	}
+	if (count == 0 || any == 0) { return ALPHA_TRANSPARENT; }
+	return (all == 255) ? ALPHA_OPAQUE : ALPHA_MIXED;
+}
+
+} // namespace rt
+
+#endif // BLEND_H
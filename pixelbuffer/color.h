@@ -170,38 +170,95 @@ inline RGBAColor rotate(const RGBAColor& rgba, float step) {
 	return HSVA2RGBA(hsva);
 }
 
+/// @brief a * b / 255, rounded, without a division
+/// @param a 0-255
+/// @param b 0-255
+/// @return return uint8_t the product
+inline uint8_t mul255(uint32_t a, uint32_t b) {
+	uint32_t t = a * b + 128;
+	return (t + (t >> 8)) >> 8;
+}
+
+/// @brief x / 255, rounded, without a division
+/// @param x 0-65535
+/// @return return uint32_t the quotient
+inline uint32_t div255(uint32_t x) {
+	x += 128;
+	return (x + (x >> 8)) >> 8;
+}
+
 // https://stackoverflow.com/questions/28900598/how-to-combine-two-colors-with-varying-alpha-values
 // https://en.wikipedia.org/wiki/Alpha_compositing#Alpha_blending
 /// @brief blend an alpha color over an alpha color
+/// Integer math, rounded. Over an opaque color (the common case) there is no
+/// division: (top * a + bottom * (255 - a)) / 255 through div255().
+/// blendSpan() in blend.h gives the same results for whole rows at once.
 /// @param top top RGBAColor
 /// @param bottom bottom RGBAColor
 /// @return return RGBAColor blended color
 inline RGBAColor alphaBlend(const RGBAColor& top, const RGBAColor& bottom) {
-	// if we want to overlay top(0) over bottom(1) both with some alpha then:
-
-	// uint8_t 0-255 to float 0.0-1.0
-	float r0 = top.r / 255.0f;
-	float g0 = top.g / 255.0f;
-	float b0 = top.b / 255.0f;
-	float a0 = top.a / 255.0f;
-
-	float r1 = bottom.r / 255.0f;
-	float g1 = bottom.g / 255.0f;
-	float b1 = bottom.b / 255.0f;
-	float a1 = bottom.a / 255.0f;
+	const uint32_t a0 = top.a;
+	const uint32_t a1 = bottom.a;
+	if (a0 == 255) { return top; }
+	if (a0 == 0) { return bottom; }
+
+	if (a1 == 255) {
+		const uint32_t inv = 255 - a0;
+		return RGBAColor(
+			div255(top.r * a0 + bottom.r * inv),
+			div255(top.g * a0 + bottom.g * inv),
+			div255(top.b * a0 + bottom.b * inv),
+			255
+		);
+	}
 
 	// Note the division by a01 in the formulas for the components of color. It's important.
-	float a01 =  (1 - a0) * a1 + a0;
-	float r01 = ((1 - a0) * a1 * r1 + a0 * r0) / a01;
-	float g01 = ((1 - a0) * a1 * g1 + a0 * g0) / a01;
-	float b01 = ((1 - a0) * a1 * b1 + a0 * b0) / a01;
+	// (weights scaled by 255 * 255)
+	const uint32_t w0 = a0 * 255;
+	const uint32_t w1 = a1 * (255 - a0);
+	const uint32_t a01 = w0 + w1;
+	const uint32_t half = a01 / 2;
+	return RGBAColor(
+		(top.r * w0 + bottom.r * w1 + half) / a01,
+		(top.g * w0 + bottom.g * w1 + half) / a01,
+		(top.b * w0 + bottom.b * w1 + half) / a01,
+		div255(a01)
+	);
+}
 
-	uint8_t r = r01 * 255;
-	uint8_t g = g01 * 255;
-	uint8_t b = b01 * 255;
-	uint8_t a = a01 * 255;
+/// @brief convert a straight alpha color to premultiplied alpha (r, g, b scaled by a)
+/// @param rgba the straight alpha color
+/// @return return RGBAColor premultiplied color
+inline RGBAColor premultiply(const RGBAColor& rgba) {
+	return RGBAColor(mul255(rgba.r, rgba.a), mul255(rgba.g, rgba.a), mul255(rgba.b, rgba.a), rgba.a);
+}
+
+/// @brief convert a premultiplied alpha color back to straight alpha
+/// @param rgba the premultiplied color
+/// @return return RGBAColor straight alpha color (0, 0, 0, 0 if fully transparent)
+inline RGBAColor unpremultiply(const RGBAColor& rgba) {
+	if (rgba.a == 255) { return rgba; }
+	if (rgba.a == 0) { return RGBAColor(0, 0, 0, 0); }
+	const uint32_t half = rgba.a / 2;
+	uint8_t r = std::min<uint32_t>(255, (rgba.r * 255 + half) / rgba.a);
+	uint8_t g = std::min<uint32_t>(255, (rgba.g * 255 + half) / rgba.a);
+	uint8_t b = std::min<uint32_t>(255, (rgba.b * 255 + half) / rgba.a);
+	return RGBAColor(r, g, b, rgba.a);
+}
 
-	return RGBAColor(r, g, b, a);
+/// @brief blend a premultiplied color over a premultiplied color ("over")
+/// Integer multiply-add per channel, no division: top + bottom * (1 - top.a)
+/// @param top top RGBAColor (premultiplied)
+/// @param bottom bottom RGBAColor (premultiplied)
+/// @return return RGBAColor blended color (premultiplied)
+inline RGBAColor premultipliedBlend(const RGBAColor& top, const RGBAColor& bottom) {
+	const uint32_t inv = 255 - top.a;
+	return RGBAColor(
+		top.r + mul255(bottom.r, inv),
+		top.g + mul255(bottom.g, inv),
+		top.b + mul255(bottom.b, inv),
+		top.a + mul255(bottom.a, inv)
+	);
 }
 
 /// @brief quantize a color (find closest palette color)
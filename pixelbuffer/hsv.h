@@ -0,0 +1,259 @@
+/**
+ * @file hsv.h
+ * @brief HSV conversion and hue rotation of whole spans of pixels
+ * @see https://github.com/rktrlng/pixelbuffer
+ */
+
+#ifndef HSV_H
+#define HSV_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+	#include <emmintrin.h>
+	#define HSV_SSE2
+#endif
+
+#include <pixelbuffer/color.h>
+
+namespace rt {
+
+// toHSVA() and fromHSVA() give exactly the same values as rt::RGBA2HSVA() and
+// rt::HSVA2RGBA() (the same float operations in the same order), with SSE2
+// on 4 pixels at a time: the branches become selects.
+
+#ifdef HSV_SSE2
+// a ? b : c for every lane, a is a mask
+inline __m128 _hsv_select(__m128 a, __m128 b, __m128 c)
+{
+	return _mm_or_ps(_mm_and_ps(a, b), _mm_andnot_ps(a, c));
+}
+
+inline __m128i _hsv_select(__m128i a, __m128i b, __m128i c)
+{
+	return _mm_or_si128(_mm_and_si128(a, b), _mm_andnot_si128(a, c));
+}
+#endif
+
+/**
+ * @brief RGBA to HSVA conversion of count pixels
+ * @param src the RGBAColors to convert
+ * @param dst the HSVAColors
+ * @param count number of pixels
+ */
+inline void toHSVA(const RGBAColor* src, HSVAColor* dst, size_t count)
+{
+	size_t i = 0;
+#ifdef HSV_SSE2
+	const __m128i mask = _mm_set1_epi32(0xFF);
+	const __m128 c255 = _mm_set1_ps(255.0f);
+	const __m128 c6 = _mm_set1_ps(6.0f);
+	const __m128 c2 = _mm_set1_ps(2.0f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 third = _mm_set1_ps(1.0f / 3.0f);
+	const __m128 twothirds = _mm_set1_ps(2.0f / 3.0f);
+	for (; i + 4 <= count; i += 4) {
+		const __m128i p = _mm_loadu_si128((const __m128i*)&src[i]);
+		const __m128 R = _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(p, mask)), c255);
+		const __m128 G = _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(p, 8), mask)), c255);
+		const __m128 B = _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(p, 16), mask)), c255);
+		__m128 A = _mm_div_ps(_mm_cvtepi32_ps(_mm_srli_epi32(p, 24)), c255);
+
+		const __m128 min = _mm_min_ps(_mm_min_ps(R, G), B);
+		__m128 V = _mm_max_ps(_mm_max_ps(R, G), B);
+		const __m128 del = _mm_sub_ps(V, min);
+		const __m128 gray = _mm_cmpeq_ps(del, zero);
+
+		const __m128 half = _mm_div_ps(del, c2);
+		const __m128 delR = _mm_div_ps(_mm_add_ps(_mm_div_ps(_mm_sub_ps(V, R), c6), half), del);
+		const __m128 delG = _mm_div_ps(_mm_add_ps(_mm_div_ps(_mm_sub_ps(V, G), c6), half), del);
+		const __m128 delB = _mm_div_ps(_mm_add_ps(_mm_div_ps(_mm_sub_ps(V, B), c6), half), del);
+
+		__m128 H = _mm_sub_ps(_mm_add_ps(twothirds, delG), delR);
+		H = _hsv_select(_mm_cmpeq_ps(G, V), _mm_sub_ps(_mm_add_ps(third, delR), delB), H);
+		H = _hsv_select(_mm_cmpeq_ps(R, V), _mm_sub_ps(delB, delG), H);
+		H = _hsv_select(_mm_cmplt_ps(H, zero), _mm_add_ps(H, one), H);
+		H = _hsv_select(_mm_cmpgt_ps(H, one), _mm_sub_ps(H, one), H);
+		H = _mm_andnot_ps(gray, H);
+		__m128 S = _mm_andnot_ps(gray, _mm_div_ps(del, V));
+
+		_MM_TRANSPOSE4_PS(H, S, V, A);
+		float* out = &dst[i].h;
+		_mm_storeu_ps(out + 0, H);
+		_mm_storeu_ps(out + 4, S);
+		_mm_storeu_ps(out + 8, V);
+		_mm_storeu_ps(out + 12, A);
+	}
+#endif
+	for (; i < count; i++) {
+		dst[i] = rt::RGBA2HSVA(src[i]);
+	}
+}
+
+/**
+ * @brief HSVA to RGBA conversion of count pixels
+ * @param src the HSVAColors to convert
+ * @param dst the RGBAColors
+ * @param count number of pixels
+ */
+inline void fromHSVA(const HSVAColor* src, RGBAColor* dst, size_t count)
+{
+	size_t i = 0;
+#ifdef HSV_SSE2
+	const __m128 c255 = _mm_set1_ps(255.0f);
+	const __m128 c6 = _mm_set1_ps(6.0f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	for (; i + 4 <= count; i += 4) {
+		const float* in = &src[i].h;
+		__m128 H = _mm_loadu_ps(in + 0);
+		__m128 S = _mm_loadu_ps(in + 4);
+		__m128 V = _mm_loadu_ps(in + 8);
+		__m128 A = _mm_loadu_ps(in + 12);
+		_MM_TRANSPOSE4_PS(H, S, V, A);
+
+		__m128 varh = _mm_mul_ps(H, c6);
+		varh = _mm_andnot_ps(_mm_cmpge_ps(varh, c6), varh);
+		const __m128i vari = _mm_cvttps_epi32(varh);
+		const __m128 frac = _mm_sub_ps(varh, _mm_cvtepi32_ps(vari));
+		const __m128 var1 = _mm_mul_ps(V, _mm_sub_ps(one, S));
+		const __m128 var2 = _mm_mul_ps(V, _mm_sub_ps(one, _mm_mul_ps(S, frac)));
+		const __m128 var3 = _mm_mul_ps(V, _mm_sub_ps(one, _mm_mul_ps(S, _mm_sub_ps(one, frac))));
+
+		// the sector (var_i 0-4, anything else is 5)
+		const __m128 i0 = _mm_castsi128_ps(_mm_cmpeq_epi32(vari, _mm_set1_epi32(0)));
+		const __m128 i1 = _mm_castsi128_ps(_mm_cmpeq_epi32(vari, _mm_set1_epi32(1)));
+		const __m128 i2 = _mm_castsi128_ps(_mm_cmpeq_epi32(vari, _mm_set1_epi32(2)));
+		const __m128 i3 = _mm_castsi128_ps(_mm_cmpeq_epi32(vari, _mm_set1_epi32(3)));
+		const __m128 i4 = _mm_castsi128_ps(_mm_cmpeq_epi32(vari, _mm_set1_epi32(4)));
+		__m128 r = _hsv_select(i0, V, _hsv_select(i1, var2, _hsv_select(i2, var1, _hsv_select(i3, var1, _hsv_select(i4, var3, V)))));
+		__m128 g = _hsv_select(i0, var3, _hsv_select(i1, V, _hsv_select(i2, V, _hsv_select(i3, var2, _hsv_select(i4, var1, var1)))));
+		__m128 b = _hsv_select(i0, var1, _hsv_select(i1, var1, _hsv_select(i2, var3, _hsv_select(i3, V, _hsv_select(i4, V, var2)))));
+
+		// no saturation: gray
+		const __m128 gray = _mm_cmpeq_ps(S, zero);
+		r = _hsv_select(gray, V, r);
+		g = _hsv_select(gray, V, g);
+		b = _hsv_select(gray, V, b);
+
+		const __m128i R = _mm_cvttps_epi32(_mm_mul_ps(r, c255));
+		const __m128i G = _mm_cvttps_epi32(_mm_mul_ps(g, c255));
+		const __m128i B = _mm_cvttps_epi32(_mm_mul_ps(b, c255));
+		const __m128i Al = _mm_cvttps_epi32(_mm_mul_ps(A, c255));
+		const __m128i p = _mm_or_si128(_mm_or_si128(R, _mm_slli_epi32(G, 8)), _mm_or_si128(_mm_slli_epi32(B, 16), _mm_slli_epi32(Al, 24)));
+		_mm_storeu_si128((__m128i*)&dst[i], p);
+	}
+#endif
+	for (; i < count; i++) {
+		dst[i] = rt::HSVA2RGBA(src[i]);
+	}
+}
+
+/**
+ * @brief rotate the hue of count pixels, like rt::rotate(color, step)
+ * Integer HSV: max(r, g, b), min(r, g, b) and alpha stay the same, the hue
+ * position (0 - 6 * chroma) moves by step * 6 * chroma. No branches per
+ * pixel (selects), 4 pixels at a time with SSE2. The result is within 1 or
+ * 2 of rt::rotate(), which truncates.
+ * @param pixels the pixels to rotate
+ * @param count number of pixels
+ * @param step amount to rotate (1.0f is a full turn)
+ */
+inline void rotateHue(RGBAColor* pixels, size_t count, float step)
+{
+	const float turn = step - std::floor(step); // 0.0f - 1.0f
+	if (turn == 0.0f) { return; }
+	// the shift of the hue position for every chroma (rounded, like below)
+	const float turn6 = turn * 6;
+	int shift[256];
+	for (int c = 0; c < 256; c++) {
+		shift[c] = (int) ((float) c * turn6 + 0.5f);
+	}
+
+	size_t i = 0;
+#ifdef HSV_SSE2
+	const __m128i mask = _mm_set1_epi32(0xFF);
+	const __m128 t6 = _mm_set1_ps(turn6);
+	const __m128 half = _mm_set1_ps(0.5f);
+	for (; i + 4 <= count; i += 4) {
+		const __m128i p = _mm_loadu_si128((const __m128i*)&pixels[i]);
+		const __m128i r = _mm_and_si128(p, mask);
+		const __m128i g = _mm_and_si128(_mm_srli_epi32(p, 8), mask);
+		const __m128i b = _mm_and_si128(_mm_srli_epi32(p, 16), mask);
+		// (the upper 16 bits are 0, so the 16 bit min/max work on 32 bit lanes)
+		const __m128i max = _mm_max_epi16(_mm_max_epi16(r, g), b);
+		const __m128i min = _mm_min_epi16(_mm_min_epi16(r, g), b);
+		const __m128i c = _mm_sub_epi32(max, min);
+		const __m128i c2 = _mm_add_epi32(c, c);
+		const __m128i c4 = _mm_add_epi32(c2, c2);
+		const __m128i c6 = _mm_add_epi32(c4, c2);
+
+		// hue position: r max: g - b, g max: 2c + b - r, b max: 4c + r - g
+		__m128i pos = _mm_add_epi32(c4, _mm_sub_epi32(r, g));
+		pos = _hsv_select(_mm_cmpeq_epi32(g, max), _mm_add_epi32(c2, _mm_sub_epi32(b, r)), pos);
+		pos = _hsv_select(_mm_cmpeq_epi32(r, max), _mm_sub_epi32(g, b), pos);
+		pos = _mm_add_epi32(pos, _mm_and_si128(c6, _mm_cmplt_epi32(pos, _mm_setzero_si128())));
+
+		// rotate
+		pos = _mm_add_epi32(pos, _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(c), t6), half)));
+		pos = _mm_sub_epi32(pos, _mm_andnot_si128(_mm_cmplt_epi32(pos, c6), c6));
+
+		// back to r, g, b: sector by sector (s1 - s5: pos >= 1c - 5c)
+		const __m128i p1 = _mm_add_epi32(pos, _mm_set1_epi32(1));
+		const __m128i c3 = _mm_add_epi32(c2, c);
+		const __m128i s1 = _mm_cmpgt_epi32(p1, c);
+		const __m128i s2 = _mm_cmpgt_epi32(p1, c2);
+		const __m128i s3 = _mm_cmpgt_epi32(p1, c3);
+		const __m128i s4 = _mm_cmpgt_epi32(p1, c4);
+		const __m128i s5 = _mm_cmpgt_epi32(p1, _mm_add_epi32(c4, c));
+		// f = pos - sector * c
+		const __m128i sector = _mm_sub_epi32(_mm_setzero_si128(), _mm_add_epi32(_mm_add_epi32(_mm_add_epi32(s1, s2), _mm_add_epi32(s3, s4)), s5));
+		const __m128i f = _mm_sub_epi32(pos, _mm_madd_epi16(sector, c));
+		const __m128i mf = _mm_add_epi32(min, f);
+		const __m128i Mf = _mm_sub_epi32(max, f);
+		__m128i nr = _hsv_select(s1, Mf, max);
+		nr = _hsv_select(s2, min, nr);
+		nr = _hsv_select(s4, mf, nr);
+		nr = _hsv_select(s5, max, nr);
+		__m128i ng = _hsv_select(s1, max, mf);
+		ng = _hsv_select(s3, Mf, ng);
+		ng = _hsv_select(s4, min, ng);
+		__m128i nb = _hsv_select(s2, mf, min);
+		nb = _hsv_select(s3, max, nb);
+		nb = _hsv_select(s5, Mf, nb);
+		const __m128i alpha = _mm_andnot_si128(_mm_set1_epi32(0x00FFFFFF), p);
+		const __m128i out = _mm_or_si128(_mm_or_si128(nr, _mm_slli_epi32(ng, 8)), _mm_or_si128(_mm_slli_epi32(nb, 16), alpha));
+		_mm_storeu_si128((__m128i*)&pixels[i], out);
+	}
+#endif
+
+	// which of { max, min + f, max - f, min } is r, g, b in each sector
+	static const uint8_t sectors[6][3] = { {0,1,3}, {2,0,3}, {3,0,1}, {3,2,0}, {1,3,0}, {0,3,2} };
+	for (; i < count; i++) {
+		RGBAColor& p = pixels[i];
+		const int r = p.r;
+		const int g = p.g;
+		const int b = p.b;
+		const int max = std::max(std::max(r, g), b);
+		const int min = std::min(std::min(r, g), b);
+		const int c = max - min;
+		int pos = (r == max) ? g - b : (g == max) ? 2 * c + b - r : 4 * c + r - g;
+		pos += (pos < 0) ? 6 * c : 0;
+		pos += shift[c];
+		pos -= (pos >= 6 * c) ? 6 * c : 0;
+		const int sector = (pos >= c) + (pos >= 2 * c) + (pos >= 3 * c) + (pos >= 4 * c) + (pos >= 5 * c);
+		const int f = pos - sector * c;
+		const int values[4] = { max, min + f, max - f, min };
+		p.r = values[sectors[sector][0]];
+		p.g = values[sectors[sector][1]];
+		p.b = values[sectors[sector][2]];
+	}
+}
+
+} // namespace rt
+
+#endif // HSV_H
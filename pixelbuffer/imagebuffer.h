@@ -0,0 +1,645 @@
+/**
+ * @file imagebuffer.h
+ * @brief Image stored in its pbf pixel format: rt::ImageBuffer<Format>
+ * @see https://github.com/rktrlng/pixelbuffer
+ */
+
+#ifndef IMAGEBUFFER_H
+#define IMAGEBUFFER_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include <pixelbuffer/color.h>
+#include <pixelbuffer/lz.h>
+#include <pixelbuffer/pixelbuffer.h>
+
+namespace rt {
+
+// ###############################################
+// # Pixel formats                               #
+// ###############################################
+
+// A pixel format describes how one pixel is stored in a row of bytes:
+//   value_type                     the value of a pixel
+//   bitdepth                       bits per pixel, as in the pbf header
+//   get(row, x) / set(row, x, v)   read/write pixel x of a row
+//   fromRGBA(c) / toRGBA(v)        convert from/to RGBAColor (like PixelBuffer::encodePixels/decodePixels)
+//   blend(top, bottom)             top over bottom (formats without alpha return top)
+
+struct GrayAlpha {
+	uint8_t gray;
+	uint8_t alpha;
+	GrayAlpha(uint8_t g = 0, uint8_t a = 255) : gray(g), alpha(a) { }
+	bool operator==(const GrayAlpha& other) const { return gray == other.gray && alpha == other.alpha; }
+	bool operator!=(const GrayAlpha& other) const { return !(*this == other); }
+};
+
+struct RGBColor {
+	uint8_t r;
+	uint8_t g;
+	uint8_t b;
+	RGBColor(uint8_t red = 0, uint8_t green = 0, uint8_t blue = 0) : r(red), g(green), b(blue) { }
+	bool operator==(const RGBColor& other) const { return r == other.r && g == other.g && b == other.b; }
+	bool operator!=(const RGBColor& other) const { return !(*this == other); }
+};
+
+// 1 bit: black or white, 8 pixels per byte, most significant bit first
+struct Bit1 {
+	typedef bool value_type;
+	static const uint8_t bitdepth = 1;
+	static value_type get(const uint8_t* row, size_t x) { return (row[x/8] >> (7 - x%8)) & 1; }
+	static void set(uint8_t* row, size_t x, value_type v) {
+		if (v) { row[x/8] |= (1 << (7 - x%8)); } else { row[x/8] &= ~(1 << (7 - x%8)); }
+	}
+	static value_type fromRGBA(const RGBAColor& c) { return (c.r + c.g + c.b) / 3 >= 128 && c.a >= 128; }
+	static RGBAColor toRGBA(value_type v) { return v ? RGBAColor(255, 255, 255, 255) : RGBAColor(0, 0, 0, 255); }
+	static value_type blend(value_type top, value_type) { return top; }
+};
+
+// 8 bit: gray
+struct Gray8 {
+	typedef uint8_t value_type;
+	static const uint8_t bitdepth = 8;
+	static value_type get(const uint8_t* row, size_t x) { return row[x]; }
+	static void set(uint8_t* row, size_t x, value_type v) { row[x] = v; }
+	static value_type fromRGBA(const RGBAColor& c) { return rt::luminance(c).r; }
+	static RGBAColor toRGBA(value_type v) { return RGBAColor(v, 255); }
+	static value_type blend(value_type top, value_type) { return top; }
+};
+
+// 16 bit: gray + alpha
+struct GrayAlpha16 {
+	typedef GrayAlpha value_type;
+	static const uint8_t bitdepth = 16;
+	static value_type get(const uint8_t* row, size_t x) { return GrayAlpha(row[x*2+0], row[x*2+1]); }
+	static void set(uint8_t* row, size_t x, value_type v) { row[x*2+0] = v.gray; row[x*2+1] = v.alpha; }
+	static value_type fromRGBA(const RGBAColor& c) { return GrayAlpha(rt::luminance(c).r, c.a); }
+	static RGBAColor toRGBA(value_type v) { return RGBAColor(v.gray, v.alpha); }
+	static value_type blend(value_type top, value_type bottom) {
+		if (top.alpha == 255) { return top; }
+		// same as rt::alphaBlend on a single channel
+		const uint32_t w0 = top.alpha * 255;
+		const uint32_t w1 = bottom.alpha * (255 - top.alpha);
+		const uint32_t a01 = w0 + w1;
+		if (a01 == 0) { return GrayAlpha(0, 0); }
+		return GrayAlpha((top.gray * w0 + bottom.gray * w1 + a01 / 2) / a01, rt::div255(a01));
+	}
+};
+
+// 24 bit: red, green, blue
+struct RGB24 {
+	typedef RGBColor value_type;
+	static const uint8_t bitdepth = 24;
+	static value_type get(const uint8_t* row, size_t x) { return RGBColor(row[x*3+0], row[x*3+1], row[x*3+2]); }
+	static void set(uint8_t* row, size_t x, value_type v) { row[x*3+0] = v.r; row[x*3+1] = v.g; row[x*3+2] = v.b; }
+	static value_type fromRGBA(const RGBAColor& c) { return RGBColor(c.r, c.g, c.b); }
+	static RGBAColor toRGBA(value_type v) { return RGBAColor(v.r, v.g, v.b, 255); }
+	static value_type blend(value_type top, value_type) { return top; }
+};
+
+// 32 bit: red, green, blue, alpha (the pixels of a PixelBuffer)
+struct RGBA32 {
+	typedef RGBAColor value_type;
+	static const uint8_t bitdepth = 32;
+	static value_type get(const uint8_t* row, size_t x) { return RGBAColor(row[x*4+0], row[x*4+1], row[x*4+2], row[x*4+3]); }
+	static void set(uint8_t* row, size_t x, value_type v) { std::memcpy(&row[x*4], (const void*)&v, 4); }
+	static value_type fromRGBA(const RGBAColor& c) { return c; }
+	static RGBAColor toRGBA(value_type v) { return v; }
+	static value_type blend(value_type top, value_type bottom) { return top.a == 255 ? top : rt::alphaBlend(top, bottom); }
+};
+
+
+// ###############################################
+// # ImageBuffer                                 #
+// ###############################################
+
+// Holds its pixels exactly as the pbf pixeldata of its format: a Gray8 mask
+// takes 1 byte per pixel, a Bit1 mask 1 bit. Drawing and filters work on
+// the stored values, PixelBuffer (RGBA) is only used to convert from and to.
+template <class Format>
+class ImageBuffer
+{
+public:
+	typedef Format format_type;
+	typedef typename Format::value_type value_type;
+
+private:
+	PixelBuffer::PBHeader m_header;
+	size_t m_rowbytes = 0;
+	std::vector<uint8_t> m_data;
+
+	void _init(uint16_t width, uint16_t height)
+	{
+		m_header = PixelBuffer::PBHeader();
+		m_header.width = width;
+		m_header.height = height;
+		m_header.bitdepth = Format::bitdepth;
+		m_rowbytes = ((size_t) width * Format::bitdepth + 7) / 8;
+		m_data.assign(m_rowbytes * height, 0);
+	}
+
+	// set pixels [x0, x1] of row y, clipped
+	void _span(int x0, int x1, int y, value_type value, bool blend)
+	{
+		if (y < 0 || y >= m_header.height) { return; }
+		x0 = std::max(x0, 0);
+		x1 = std::min(x1, m_header.width - 1);
+		uint8_t* r = row(y);
+		for (int x = x0; x <= x1; x++) {
+			Format::set(r, x, blend ? Format::blend(value, Format::get(r, x)) : value);
+		}
+	}
+
+	bool _decompress(const uint8_t* data, size_t size, const PixelBuffer::PBHeader& header)
+	{
+		PixelBuffer::PBZHeader zheader;
+		if (!PixelBuffer::readChunkTable(data, size, header, zheader, nullptr)) { return false; }
+		std::vector<uint64_t> offsets(zheader.chunks + 1);
+		if (!PixelBuffer::readChunkTable(data, size, header, zheader, offsets.data()) || offsets[zheader.chunks] > size) {
+			return false;
+		}
+
+		_init(header.width, header.height);
+		for (size_t c = 0; c < zheader.chunks; c++) {
+			const size_t y = c * zheader.bandrows;
+			const size_t rawsize = std::min<size_t>(zheader.bandrows, header.height - y) * m_rowbytes;
+			if (lz_decompress(data + offsets[c], offsets[c+1] - offsets[c], row(y), rawsize) != rawsize) { return false; }
+		}
+		return true;
+	}
+
+public:
+	ImageBuffer() { }
+
+	ImageBuffer(uint16_t width, uint16_t height)
+	{
+		_init(width, height);
+		fill(Format::fromRGBA(TRANSPARENT));
+	}
+
+	ImageBuffer(uint16_t width, uint16_t height, value_type value)
+	{
+		_init(width, height);
+		fill(value);
+	}
+
+	explicit ImageBuffer(const PixelBuffer& pb)
+	{
+		fromPixelBuffer(pb);
+	}
+
+	explicit ImageBuffer(const std::string& filename)
+	{
+		read(filename);
+	}
+
+	const PixelBuffer::PBHeader& header() const { return m_header; }
+	uint16_t width() const { return m_header.width; }
+	uint16_t height() const { return m_header.height; }
+	uint8_t bitdepth() const { return m_header.bitdepth; }
+
+	// bytes per row (a 1 bit row is padded to a whole byte)
+	size_t rowbytes() const { return m_rowbytes; }
+	// the pixeldata: height() rows of rowbytes() bytes
+	uint8_t* data() { return m_data.data(); }
+	const uint8_t* data() const { return m_data.data(); }
+	size_t size() const { return m_data.size(); }
+	uint8_t* row(size_t y) { return &m_data[y * m_rowbytes]; }
+	const uint8_t* row(size_t y) const { return &m_data[y * m_rowbytes]; }
+
+	bool valid() const
+	{
+		return PixelBuffer::validHeader(m_header) && m_data.size() == m_rowbytes * m_header.height;
+	}
+
+	int setPixel(int x, int y, value_type value, bool blend = false)
+	{
+		if ( (x < 0) || (x >= m_header.width) || (y < 0) || (y >= m_header.height) ) {
+			return 0;
+		}
+		uint8_t* r = row(y);
+		Format::set(r, x, blend ? Format::blend(value, Format::get(r, x)) : value);
+		return 1;
+	}
+
+	value_type getPixel(int x, int y) const
+	{
+		if ( (x < 0) || (x >= m_header.width) || (y < 0) || (y >= m_header.height) ) {
+			return Format::fromRGBA(TRANSPARENT);
+		}
+		return Format::get(row(y), x);
+	}
+
+	// =========================================================
+	// conversion
+	// =========================================================
+
+	int fromPixelBuffer(const PixelBuffer& pb)
+	{
+		if (pb.premultiplied()) {
+			PixelBuffer straight = pb;
+			straight.unpremultiply();
+			return fromPixelBuffer(straight);
+		}
+		_init(pb.width(), pb.height());
+		const RGBAColor* pixels = pb.pixels().data();
+		const bool packed = m_rowbytes * 8 == (size_t) m_header.width * Format::bitdepth;
+		for (size_t y = 0; y < m_header.height; y++) {
+			const RGBAColor* src = &pixels[y * m_header.width];
+			if (packed) {
+				PixelBuffer::encodePixels(src, row(y), m_header.width, Format::bitdepth);
+			} else {
+				for (size_t x = 0; x < m_header.width; x++) { Format::set(row(y), x, Format::fromRGBA(src[x])); }
+			}
+		}
+		return 1;
+	}
+
+	PixelBuffer toPixelBuffer() const
+	{
+		PixelBuffer pb(m_header.width, m_header.height, 32);
+		if (!PixelBuffer::validBitdepth(Format::bitdepth, m_header.width)) {
+			for (size_t y = 0; y < m_header.height; y++) {
+				for (size_t x = 0; x < m_header.width; x++) { pb.pixels()[y * m_header.width + x] = Format::toRGBA(Format::get(row(y), x)); }
+			}
+		} else {
+			pb.bitdepth(Format::bitdepth);
+			PixelBuffer::decodePixels(m_data.data(), pb.pixels().data(), pb.pixels().size(), Format::bitdepth);
+		}
+		return pb;
+	}
+
+	// =========================================================
+	// files
+	// =========================================================
+
+	// Read a pbf. Pixeldata in this format is read as is, other bitdepths
+	// and compressed files are converted.
+	int read(const std::string& filename)
+	{
+		std::ifstream file(filename, std::fstream::in|std::fstream::binary|std::fstream::ate);
+		if (!file.is_open()) {
+			std::cout << "Unable to open file: " << filename << std::endl;
+			return 0;
+		}
+
+		const size_t size = file.tellg();
+		PixelBuffer::PBHeader header;
+		if (size >= sizeof(header)) {
+			file.seekg(0, std::fstream::beg);
+			file.read((char*)&header, sizeof(header));
+		}
+
+		if (size >= sizeof(header) && header.bitdepth == Format::bitdepth && PixelBuffer::validHeader(header) &&
+			size - sizeof(header) >= PixelBuffer::payloadSize(header.width, header.height, header.bitdepth))
+		{
+			_init(header.width, header.height);
+			file.read((char*)m_data.data(), m_data.size());
+			return size;
+		}
+
+		// compressed pixeldata in this format: decompress the chunks in place
+		if (size >= sizeof(header) && header.bitdepth == (Format::bitdepth | PBF_COMPRESSED)) {
+			header.bitdepth = Format::bitdepth;
+			std::vector<uint8_t> memblock(size);
+			file.seekg(0, std::fstream::beg);
+			file.read((char*)memblock.data(), size);
+			if (PixelBuffer::validHeader(header) && _decompress(memblock.data(), size, header)) {
+				return size;
+			}
+			std::cout << "Invalid pbf file: " << filename << std::endl;
+			*this = ImageBuffer();
+			return 0;
+		}
+
+		file.close();
+		PixelBuffer pb;
+		if (!pb.read(filename)) {
+			*this = ImageBuffer();
+			return 0;
+		}
+		fromPixelBuffer(pb);
+		return size;
+	}
+
+	int write(const std::string& filename) const
+	{
+		if (!valid()) {
+			std::cout << "Invalid imagebuffer, not writing: " << filename << std::endl;
+			return 0;
+		}
+
+		std::ofstream file(filename, std::fstream::out|std::fstream::binary|std::fstream::trunc);
+		if (!file.is_open()) {
+			std::cout << "Unable to write to file: " << filename << std::endl;
+			return 0;
+		}
+
+		file.write((const char*)&m_header, sizeof(m_header));
+		file.write((const char*)m_data.data(), m_data.size());
+		return file.good() ? 1 : 0;
+	}
+
+	// Write a compressed pbf (see PixelBuffer::writeCompressed)
+	int writeCompressed(const std::string& filename, uint16_t bandrows = 64) const
+	{
+		if (!valid() || bandrows == 0) {
+			std::cout << "Invalid imagebuffer, not writing: " << filename << std::endl;
+			return 0;
+		}
+
+		std::ofstream file(filename, std::fstream::out|std::fstream::binary|std::fstream::trunc);
+		if (!file.is_open()) {
+			std::cout << "Unable to write to file: " << filename << std::endl;
+			return 0;
+		}
+
+		PixelBuffer::PBHeader header = m_header;
+		header.bitdepth |= PBF_COMPRESSED;
+		PixelBuffer::PBZHeader zheader;
+		zheader.bandrows = bandrows;
+		zheader.chunks = (m_header.height + bandrows - 1) / bandrows;
+
+		const size_t tablesize = (zheader.chunks + 1) * sizeof(uint64_t);
+		const size_t start = sizeof(header) + sizeof(zheader) + tablesize;
+		std::vector<uint64_t> offsets(zheader.chunks + 1, start);
+		std::vector<uint8_t> chunks;
+		for (size_t c = 0; c < zheader.chunks; c++) {
+			const size_t y = c * bandrows;
+			const size_t rows = std::min<size_t>(bandrows, m_header.height - y);
+			lz_compress(row(y), rows * m_rowbytes, chunks);
+			offsets[c+1] = start + chunks.size();
+		}
+
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)&zheader, sizeof(zheader));
+		file.write((const char*)offsets.data(), tablesize);
+		file.write((const char*)chunks.data(), chunks.size());
+		return file.good() ? 1 : 0;
+	}
+
+	// =========================================================
+	// drawing
+	// =========================================================
+
+	void fill(value_type value)
+	{
+		if (m_data.empty()) { return; }
+		if (Format::bitdepth == 1 || Format::bitdepth == 8) {
+			// every byte is the same
+			uint8_t byte = 0;
+			Format::set(&byte, 0, value);
+			if (Format::bitdepth == 1) { byte = (byte & 0x80) ? 0xFF : 0x00; }
+			std::memset(m_data.data(), byte, m_data.size());
+			return;
+		}
+		uint8_t* first = row(0);
+		for (size_t x = 0; x < m_header.width; x++) { Format::set(first, x, value); }
+		for (size_t y = 1; y < m_header.height; y++) {
+			std::memcpy(row(y), first, m_rowbytes);
+		}
+	}
+
+	void drawLine(int x0, int y0, int x1, int y1, value_type value)
+	{
+		bool steep = false;
+		if (std::abs(x0-x1) < std::abs(y0-y1)) {
+			std::swap(x0, y0);
+			std::swap(x1, y1);
+			steep = true;
+		}
+		if (x0 > x1) {
+			std::swap(x0, x1);
+			std::swap(y0, y1);
+		}
+		int dx = x1-x0;
+		int dy = y1-y0;
+		int derror2 = std::abs(dy)*2;
+		int error2 = 0;
+		int y = y0;
+
+		for (int x = x0; x <= x1; x++) {
+			if (steep) {
+				setPixel(y, x, value, true);
+			} else {
+				setPixel(x, y, value, true);
+			}
+			error2 += derror2;
+
+			if (error2 > dx) {
+				y += (y1 > y0 ? 1 : -1);
+				error2 -= dx*2;
+			}
+		}
+	}
+
+	void drawSquare(int x, int y, int width, int height, value_type value)
+	{
+		drawLine(x,       y,        x+width, y,        value);
+		drawLine(x+width, y,        x+width, y+height, value);
+		drawLine(x,       y+height, x+width, y+height, value);
+		drawLine(x,       y,        x,       y+height, value);
+	}
+
+	void drawSquareFilled(int x, int y, int width, int height, value_type value)
+	{
+		for (int r = 0; r < height; r++) {
+			_span(x, x + width - 1, y + r, value, true);
+		}
+	}
+
+	void drawCircle(int circlex, int circley, int radius, value_type value)
+	{
+		int x = radius;
+		int y = 0;
+		int err = 0;
+
+		while (x >= y) {
+			setPixel(circlex + x, circley + y, value, true);
+			setPixel(circlex + y, circley + x, value, true);
+			setPixel(circlex - y, circley + x, value, true);
+			setPixel(circlex - x, circley + y, value, true);
+			setPixel(circlex - x, circley - y, value, true);
+			setPixel(circlex - y, circley - x, value, true);
+			setPixel(circlex + y, circley - x, value, true);
+			setPixel(circlex + x, circley - y, value, true);
+
+			if (err <= 0) {
+				y += 1;
+				err += 2*y + 1;
+			}
+			if (err > 0) {
+				x -= 1;
+				err -= 2*x + 1;
+			}
+		}
+	}
+
+	void drawCircleFilled(int circlex, int circley, int radius, value_type value)
+	{
+		for (int dy = -radius; dy <= radius; dy++) {
+			int dx = 0;
+			while ((dx + 1) * (dx + 1) + dy * dy <= radius * radius) { dx++; }
+			_span(circlex - dx, circlex + dx, circley + dy, value, true);
+		}
+	}
+
+	// fill the area of pixels with the value at (x, y)
+	void floodFill(int x, int y, value_type value)
+	{
+		if (x < 0 || x >= m_header.width || y < 0 || y >= m_header.height) { return; }
+		const value_type check = getPixel(x, y);
+		if (check == value) { return; }
+
+		std::vector<vec2i> stack;
+		stack.push_back(vec2i(x, y));
+		while (!stack.empty()) {
+			vec2i p = stack.back();
+			stack.pop_back();
+			if (getPixel(p.x, p.y) != check || p.x < 0 || p.x >= m_header.width || p.y < 0 || p.y >= m_header.height) { continue; }
+
+			// fill the run of pixels left and right of p
+			int left = p.x;
+			int right = p.x;
+			while (left > 0 && getPixel(left - 1, p.y) == check) { left--; }
+			while (right < m_header.width - 1 && getPixel(right + 1, p.y) == check) { right++; }
+			_span(left, right, p.y, value, false);
+
+			// and look for runs above and below it
+			for (int dy = -1; dy <= 1; dy += 2) {
+				const int ny = p.y + dy;
+				if (ny < 0 || ny >= m_header.height) { continue; }
+				bool inrun = false;
+				for (int nx = left; nx <= right; nx++) {
+					const bool match = getPixel(nx, ny) == check;
+					if (match && !inrun) { stack.push_back(vec2i(nx, ny)); }
+					inrun = match;
+				}
+			}
+		}
+	}
+
+	void flipRows()
+	{
+		for (size_t y = 0; y < m_header.height / 2u; y++) {
+			std::swap_ranges(row(y), row(y) + m_rowbytes, row(m_header.height - y - 1));
+		}
+	}
+
+	ImageBuffer copy(uint16_t x, uint16_t y, uint16_t width, uint16_t height) const
+	{
+		ImageBuffer buffer(width, height);
+		for (size_t ny = 0; ny < height; ny++) {
+			for (size_t nx = 0; nx < width; nx++) {
+				buffer.setPixel(nx, ny, getPixel(x + nx, y + ny));
+			}
+		}
+		return buffer;
+	}
+
+	int paste(const ImageBuffer& brush, int pos_x, int pos_y)
+	{
+		const int x0 = std::max(0, pos_x);
+		const int y0 = std::max(0, pos_y);
+		const int x1 = std::min<int>(m_header.width, pos_x + brush.width());
+		const int y1 = std::min<int>(m_header.height, pos_y + brush.height());
+		for (int y = y0; y < y1; y++) {
+			const uint8_t* src = brush.row(y - pos_y);
+			uint8_t* dst = row(y);
+			for (int x = x0; x < x1; x++) {
+				Format::set(dst, x, Format::blend(Format::get(src, x - pos_x), Format::get(dst, x)));
+			}
+		}
+		return 1;
+	}
+
+	// =========================================================
+	// filters
+	// =========================================================
+
+	// sharpness 1 = fully blurred
+	// sharpness ..50+ = less blurred
+	void blur(int sharpness = 1)
+	{
+		const int rows = m_header.height;
+		const int cols = m_header.width;
+
+		for (int y = 0; y < rows; y++) {
+			for (int x = 0; x < cols; x++) {
+				int total[4] = { 0, 0, 0, 0 };
+				for (int r = -1; r < 2; r++) {
+					for (int c = -1; c < 2; c++) {
+						vec2i n = clamp(vec2i(x+c, y+r), cols, rows);
+						RGBAColor color = Format::toRGBA(getPixel(n.x, n.y));
+						int weight = (r==0 && c==0) ? sharpness : 1;
+						for (int i = 0; i < 4; i++) { total[i] += color[i] * weight; }
+					}
+				}
+				RGBAColor avg(total[0] / (8 + sharpness), total[1] / (8 + sharpness), total[2] / (8 + sharpness), total[3] / (8 + sharpness));
+				setPixel(x, y, Format::fromRGBA(avg), true);
+			}
+		}
+	}
+
+	// stretch the gray (red) values to 0-255
+	void contrast_8()
+	{
+		uint8_t min = 255;
+		uint8_t max = 0;
+		for (size_t y = 0; y < m_header.height; y++) {
+			for (size_t x = 0; x < m_header.width; x++) {
+				uint8_t value = Format::toRGBA(Format::get(row(y), x)).r;
+				if (value < min) min = value;
+				if (value > max) max = value;
+			}
+		}
+		if (min == max) { return; }
+
+		_mapGray([&](uint8_t value) { return (uint8_t) rt::map(value, min, max, 0, 255); });
+	}
+
+	void posterize_8(uint8_t levels)
+	{
+		_mapGray([&](uint8_t value) {
+			uint8_t level = rt::map(value, 0, 255, 0, levels);
+			return (uint8_t) rt::map(level, 0, levels, 0, 255);
+		});
+	}
+
+private:
+	// replace every pixel with an opaque gray func(gray (red) value), through a table of 256 values
+	template <class Func>
+	void _mapGray(Func func)
+	{
+		uint8_t table[256];
+		for (int i = 0; i < 256; i++) { table[i] = func(i); }
+
+		if (Format::bitdepth == 8) {
+			for (uint8_t& value : m_data) { value = table[value]; }
+			return;
+		}
+		for (size_t y = 0; y < m_header.height; y++) {
+			uint8_t* r = row(y);
+			for (size_t x = 0; x < m_header.width; x++) {
+				uint8_t value = table[Format::toRGBA(Format::get(r, x)).r];
+				Format::set(r, x, Format::fromRGBA(RGBAColor(value, 255)));
+			}
+		}
+	}
+};
+
+typedef ImageBuffer<Bit1>        BitBuffer;       // 1 bit per pixel
+typedef ImageBuffer<Gray8>       GrayBuffer;      // 1 byte per pixel
+typedef ImageBuffer<GrayAlpha16> GrayAlphaBuffer; // 2 bytes per pixel
+typedef ImageBuffer<RGB24>       RGBBuffer;       // 3 bytes per pixel
+typedef ImageBuffer<RGBA32>      RGBABuffer;      // 4 bytes per pixel, like PixelBuffer
+
+} // namespace rt
+
+#endif // IMAGEBUFFER_H
@@ -0,0 +1,185 @@
+/**
+ * @file lut.h
+ * @brief Per channel lookup tables for point operations: rt::LUT
+ * @see https://github.com/rktrlng/pixelbuffer
+ */
+
+#ifndef LUT_H
+#define LUT_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#include <pixelbuffer/color.h>
+#include <pixelbuffer/util.h>
+
+namespace rt {
+
+// A 256 entry table for each of R, G, B and A. A point operation that works
+// on each channel on its own (negative, quantize, posterize, contrast, gamma,
+// or any function or lambda uint8_t -> uint8_t) is computed 256 times when the
+// table is built, instead of once per pixel. Tables can be chained with then()
+// to apply several operations in a single pass.
+// apply() works on whole spans of pixels: 4 loads from the tables and a
+// single 32 bit store per pixel. (There is no 256 entry byte shuffle in SSE2
+// or AVX2, and gathers are slower than these loads.)
+// rt::average and rt::luminance mix the channels, so they are not a LUT.
+class LUT
+{
+public:
+	enum Channel { R = 0, G = 1, B = 2, A = 3 };
+
+private:
+	uint8_t m_tables[4][256];
+
+public:
+	// the identity: every value maps to itself
+	LUT()
+	{
+		for (int c = 0; c < 4; c++) {
+			for (int v = 0; v < 256; v++) { m_tables[c][v] = v; }
+		}
+	}
+
+	// f(uint8_t) for R, G and B (and A if alpha is true)
+	template <class F>
+	static LUT fromFunction(F f, bool alpha = false)
+	{
+		LUT lut;
+		lut.set(R, f);
+		lut.set(G, f);
+		lut.set(B, f);
+		if (alpha) { lut.set(A, f); }
+		return lut;
+	}
+
+	template <class F>
+	void set(Channel channel, F f)
+	{
+		for (int v = 0; v < 256; v++) { m_tables[channel][v] = f((uint8_t) v); }
+	}
+
+	uint8_t* table(Channel channel) { return m_tables[channel]; }
+	const uint8_t* table(Channel channel) const { return m_tables[channel]; }
+
+	bool identity(Channel channel) const
+	{
+		for (int v = 0; v < 256; v++) {
+			if (m_tables[channel][v] != v) { return false; }
+		}
+		return true;
+	}
+
+	RGBAColor operator()(const RGBAColor& color) const
+	{
+		return RGBAColor(m_tables[R][color.r], m_tables[G][color.g], m_tables[B][color.b], m_tables[A][color.a]);
+	}
+
+	// this LUT, then next: a single table for both
+	LUT then(const LUT& next) const
+	{
+		LUT lut;
+		for (int c = 0; c < 4; c++) {
+			for (int v = 0; v < 256; v++) { lut.m_tables[c][v] = next.m_tables[c][m_tables[c][v]]; }
+		}
+		return lut;
+	}
+
+	/**
+	 * @brief apply the tables to count pixels
+	 * @param pixels the pixels
+	 * @param count number of pixels
+	 */
+	void apply(RGBAColor* pixels, size_t count) const
+	{
+		const uint8_t* tr = m_tables[R];
+		const uint8_t* tg = m_tables[G];
+		const uint8_t* tb = m_tables[B];
+		const uint8_t* ta = m_tables[A];
+		if (identity(A)) {
+			for (size_t i = 0; i < count; i++) {
+				uint32_t p;
+				std::memcpy(&p, (const void*)&pixels[i], 4);
+				p = tr[p & 0xFF] | (tg[(p >> 8) & 0xFF] << 8) | (tb[(p >> 16) & 0xFF] << 16) | (p & 0xFF000000);
+				std::memcpy((void*)&pixels[i], &p, 4);
+			}
+			return;
+		}
+		for (size_t i = 0; i < count; i++) {
+			uint32_t p;
+			std::memcpy(&p, (const void*)&pixels[i], 4);
+			p = tr[p & 0xFF] | (tg[(p >> 8) & 0xFF] << 8) | (tb[(p >> 16) & 0xFF] << 16) | ((uint32_t) ta[p >> 24] << 24);
+			std::memcpy((void*)&pixels[i], &p, 4);
+		}
+	}
+
+	// =========================================================
+	// tables for the point operations in color.h and pixelbuffer.h
+	// =========================================================
+
+	/**
+	 * @brief a LUT from a color function that treats each channel on its own,
+	 * like rt::negative or rt::quantize (not rt::average or rt::luminance)
+	 * @param f RGBAColor f(const RGBAColor&)
+	 * @return LUT with f(v, v, v, v) for every v
+	 */
+	template <class F>
+	static LUT fromColor(F f)
+	{
+		LUT lut;
+		for (int v = 0; v < 256; v++) {
+			const RGBAColor color = f(RGBAColor(v, v, v, v));
+			lut.m_tables[R][v] = color.r;
+			lut.m_tables[G][v] = color.g;
+			lut.m_tables[B][v] = color.b;
+			lut.m_tables[A][v] = color.a;
+		}
+		return lut;
+	}
+
+	// rt::negative
+	static LUT negative()
+	{
+		return fromFunction([](uint8_t v) { return (uint8_t) (255 - v); });
+	}
+
+	// rt::quantize
+	static LUT quantize(int factor = 1)
+	{
+		return fromColor([factor](const RGBAColor& c) { return rt::quantize(c, factor); });
+	}
+
+	// levels + 1 values per channel (PixelBuffer::posterize_8 on every channel)
+	static LUT posterize(uint8_t levels)
+	{
+		return fromFunction([levels](uint8_t v) {
+			uint8_t level = rt::map(v, 0, 255, 0, levels);
+			return (uint8_t) rt::map(level, 0, levels, 0, 255);
+		});
+	}
+
+	// min - max to 0 - 255 (PixelBuffer::contrast_8 on every channel)
+	// values below min and above max are clamped, all values are 0 if min == max
+	// (like contrast_8; PixelView::contrast keeps such a channel instead)
+	static LUT stretch(uint8_t min, uint8_t max)
+	{
+		return fromFunction([min, max](uint8_t v) {
+			if (max <= min) { return (uint8_t) 0; }
+			v = std::min(std::max(v, min), max);
+			return (uint8_t) rt::map(v, min, max, 0, 255);
+		});
+	}
+
+	// out = 255 * (in / 255) ^ gamma
+	static LUT gamma(float gamma)
+	{
+		return fromFunction([gamma](uint8_t v) { return (uint8_t) (255.0f * std::pow(v / 255.0f, gamma) + 0.5f); });
+	}
+};
+
+} // namespace rt
+
+#endif // LUT_H
@@ -0,0 +1,169 @@
+/**
+ * @file lz.h
+ * @brief Fast byte oriented LZ77 compression: rt::lz_compress, rt::lz_decompress
+ * @see https://github.com/rktrlng/pixelbuffer
+ */
+
+#ifndef LZ_H
+#define LZ_H
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace rt {
+
+// The compressed stream is a list of sequences (like LZ4):
+//   token:    1 byte, high nibble = literal length, low nibble = match length - 4
+//   [length]: if a nibble is 15, more bytes follow, each adds 0-255 (until a byte < 255)
+//   literals: literal length bytes copied as is
+//   offset:   2 bytes (little endian), distance back to the match (1-65535)
+//   [length]: extra match length bytes
+// The last sequence only has a token and literals (no offset).
+
+const size_t LZ_MINMATCH = 4;
+
+inline void _lz_put_length(std::vector<uint8_t>& dst, size_t length)
+{
+	while (length >= 255) {
+		dst.push_back(255);
+		length -= 255;
+	}
+	dst.push_back((uint8_t) length);
+}
+
+inline uint32_t _lz_read32(const uint8_t* p)
+{
+	uint32_t value;
+	std::memcpy(&value, p, 4);
+	return value;
+}
+
+/**
+ * @brief compress a block of bytes
+ * @param src bytes to compress
+ * @param size number of bytes
+ * @param dst compressed bytes are appended to dst
+ * @return number of bytes appended
+ */
+inline size_t lz_compress(const uint8_t* src, size_t size, std::vector<uint8_t>& dst)
+{
+	const size_t HASHBITS = 12;
+	uint32_t table[1 << HASHBITS] = { 0 }; // position + 1 of last occurrence of a hash
+
+	const size_t begin = dst.size();
+	size_t anchor = 0; // first literal not yet written
+	size_t pos = 0;
+	// stop looking for matches close to the end, the tail is written as literals
+	const size_t limit = size > 12 ? size - 12 : 0;
+
+	while (pos < limit) {
+		const uint32_t sequence = _lz_read32(&src[pos]);
+		const uint32_t hash = (sequence * 2654435761u) >> (32 - HASHBITS);
+		const size_t candidate = table[hash];
+		table[hash] = pos + 1;
+
+		if (candidate == 0 || pos - (candidate - 1) > 0xFFFF ||
+			_lz_read32(&src[candidate - 1]) != sequence)
+		{
+			pos++;
+			continue;
+		}
+
+		// found a match: extend it
+		const size_t match = candidate - 1;
+		size_t length = LZ_MINMATCH;
+		while (pos + length < size - 5 && src[match + length] == src[pos + length]) { length++; }
+
+		// token
+		const size_t literals = pos - anchor;
+		const size_t extra = length - LZ_MINMATCH;
+		dst.push_back((uint8_t) ((std::min<size_t>(literals, 15) << 4) | std::min<size_t>(extra, 15)));
+		if (literals >= 15) { _lz_put_length(dst, literals - 15); }
+		dst.insert(dst.end(), src + anchor, src + pos);
+
+		// offset + match length
+		const size_t offset = pos - match;
+		dst.push_back(offset & 0xFF);
+		dst.push_back((offset >> 8) & 0xFF);
+		if (extra >= 15) { _lz_put_length(dst, extra - 15); }
+
+		pos += length;
+		anchor = pos;
+	}
+
+	// last literals
+	const size_t literals = size - anchor;
+	dst.push_back((uint8_t) (std::min<size_t>(literals, 15) << 4));
+	if (literals >= 15) { _lz_put_length(dst, literals - 15); }
+	dst.insert(dst.end(), src + anchor, src + size);
+
+	return dst.size() - begin;
+}
+
+/**
+ * @brief decompress a block of bytes
+ * @param src compressed bytes
+ * @param size number of compressed bytes
+ * @param dst room for the decompressed bytes
+ * @param dstsize the expected number of decompressed bytes
+ * @return number of bytes decompressed, 0 on corrupt input
+ */
+inline size_t lz_decompress(const uint8_t* src, size_t size, uint8_t* dst, size_t dstsize)
+{
+	size_t ip = 0;
+	size_t op = 0;
+
+	while (ip < size) {
+		const uint8_t token = src[ip++];
+
+		// literals
+		size_t literals = token >> 4;
+		if (literals == 15) {
+			uint8_t b;
+			do {
+				if (ip >= size) { return 0; }
+				b = src[ip++];
+				literals += b;
+			} while (b == 255);
+		}
+		if (literals > size - ip || literals > dstsize - op) { return 0; }
+		std::memcpy(dst + op, src + ip, literals);
+		ip += literals;
+		op += literals;
+
+		if (ip == size) { break; } // last sequence
+
+		// match
+		if (size - ip < 2) { return 0; }
+		const size_t offset = src[ip] | (src[ip + 1] << 8);
+		ip += 2;
+		size_t length = (token & 0x0F);
+		if (length == 15) {
+			uint8_t b;
+			do {
+				if (ip >= size) { return 0; }
+				b = src[ip++];
+				length += b;
+			} while (b == 255);
+		}
+		length += LZ_MINMATCH;
+		if (offset == 0 || offset > op || length > dstsize - op) { return 0; }
+
+		const uint8_t* match = dst + op - offset;
+		if (offset >= length) {
+			std::memcpy(dst + op, match, length);
+		} else {
+			// overlapping copy (repeating pattern)
+			for (size_t i = 0; i < length; i++) { dst[op + i] = match[i]; }
+		}
+		op += length;
+	}
+
+	return (op == dstsize) ? op : 0;
+}
+
+} // namespace rt
+
+#endif // LZ_H
@@ -0,0 +1,130 @@
+/**
+ * @file mappedfile.h
+ * @brief Read-only memory mapped file: rt::MappedFile
+ * @see https://github.com/rktrlng/pixelbuffer
+ */
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#if defined(_WIN32)
+	// no mmap: the file is read into memory instead
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
+
+namespace rt {
+
+class MappedFile
+{
+private:
+	const uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+#if defined(_WIN32)
+	std::vector<uint8_t> m_memblock;
+#endif
+
+public:
+	MappedFile() { }
+
+	MappedFile(const std::string& filename)
+	{
+		open(filename);
+	}
+
+	~MappedFile()
+	{
+		close();
+	}
+
+	MappedFile(const MappedFile& other) = delete;
+	MappedFile& operator=(const MappedFile& other) = delete;
+
+	const uint8_t* data() const { return m_data; }
+	size_t size() const { return m_size; }
+	bool isOpen() const { return m_data != nullptr; }
+
+	int open(const std::string& filename)
+	{
+		close();
+
+#if defined(_WIN32)
+		std::ifstream file(filename, std::fstream::in|std::fstream::binary|std::fstream::ate);
+		if (!file.is_open()) {
+			std::cout << "Unable to open file: " << filename << std::endl;
+			return 0;
+		}
+		m_size = file.tellg();
+		m_memblock.resize(m_size);
+		file.seekg(0, std::fstream::beg);
+		file.read((char*)m_memblock.data(), m_size);
+		m_data = m_memblock.data();
+#else
+		int fd = ::open(filename.c_str(), O_RDONLY);
+		if (fd < 0) {
+			std::cout << "Unable to open file: " << filename << std::endl;
+			return 0;
+		}
+
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0) {
+			::close(fd);
+			std::cout << "Unable to map file: " << filename << std::endl;
+			return 0;
+		}
+
+		void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd); // the mapping stays valid
+		if (addr == MAP_FAILED) {
+			std::cout << "Unable to map file: " << filename << std::endl;
+			return 0;
+		}
+
+		m_data = (const uint8_t*) addr;
+		m_size = st.st_size;
+#endif
+		return m_size;
+	}
+
+	void close()
+	{
+#if defined(_WIN32)
+		m_memblock.clear();
+#else
+		if (m_data != nullptr) {
+			munmap((void*)m_data, m_size);
+		}
+#endif
+		m_data = nullptr;
+		m_size = 0;
+	}
+
+	// hint the os to page in a range of the file ahead of use
+	void willNeed(size_t offset, size_t length) const
+	{
+#if !defined(_WIN32)
+		if (m_data == nullptr || offset >= m_size) { return; }
+		if (offset + length > m_size) { length = m_size - offset; }
+		// madvise needs a page aligned address
+		size_t pagesize = sysconf(_SC_PAGESIZE);
+		size_t aligned = offset - (offset % pagesize);
+		madvise((void*)(m_data + aligned), length + (offset - aligned), MADV_WILLNEED);
+#else
+		(void) offset;
+		(void) length;
+#endif
+	}
+};
+
+} // namespace rt
+
+#endif // MAPPEDFILE_H
@@ -0,0 +1,119 @@
+/**
+ * @file mappedpixelbuffer.h
+ * @brief Zero-copy, memory mapped pbf file: rt::MappedPixelBuffer
+ * @see https://github.com/rktrlng/pixelbuffer
+ */
+
+#ifndef MAPPEDPIXELBUFFER_H
+#define MAPPEDPIXELBUFFER_H
+
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <cstdint>
+
+#include <pixelbuffer/color.h>
+#include <pixelbuffer/mappedfile.h>
+#include <pixelbuffer/pixelbuffer.h>
+
+namespace rt {
+
+// A read-only view on a pbf file on disk.
+// 32 bit pixels are used straight from the mapping without copying,
+// other bitdepths are decoded when a pixel or row is requested.
+class MappedPixelBuffer
+{
+private:
+	MappedFile m_file;
+	PixelBuffer::PBHeader m_header;
+	const uint8_t* m_payload = nullptr;
+
+public:
+	MappedPixelBuffer() { }
+
+	MappedPixelBuffer(const std::string& filename)
+	{
+		map(filename);
+	}
+
+	int map(const std::string& filename)
+	{
+		unmap();
+		if (!m_file.open(filename)) { return 0; }
+
+		const size_t size = m_file.size();
+		if (size < sizeof(PixelBuffer::PBHeader)) {
+			std::cout << "Invalid pbf file: " << filename << std::endl;
+			unmap();
+			return 0;
+		}
+		std::memcpy(&m_header, m_file.data(), sizeof(PixelBuffer::PBHeader));
+
+		const size_t payload = PixelBuffer::payloadSize(m_header.width, m_header.height, m_header.bitdepth);
+		if (!PixelBuffer::validHeader(m_header) || size - sizeof(PixelBuffer::PBHeader) < payload) {
+			std::cout << "Invalid pbf file: " << filename << std::endl;
+			unmap();
+			return 0;
+		}
+		m_payload = m_file.data() + sizeof(PixelBuffer::PBHeader);
+
+		return size;
+	}
+
+	void unmap()
+	{
+		m_file.close();
+		m_header = PixelBuffer::PBHeader();
+		m_payload = nullptr;
+	}
+
+	bool valid() const { return m_payload != nullptr; }
+	uint16_t width() const { return m_header.width; }
+	uint16_t height() const { return m_header.height; }
+	uint8_t bitdepth() const { return m_header.bitdepth; }
+
+	// raw pixeldata as stored in the file
+	const uint8_t* data() const { return m_payload; }
+
+	// pixels straight from the file, only for 32 bit files (nullptr otherwise)
+	const RGBAColor* pixels() const
+	{
+		if (m_payload == nullptr || m_header.bitdepth != 32) { return nullptr; }
+		return (const RGBAColor*) m_payload;
+	}
+
+	RGBAColor getPixel(int x, int y) const
+	{
+		// Sanity check
+		if ( (x < 0) || (x >= m_header.width) || (y < 0) || (y >= m_header.height) || m_payload == nullptr ) {
+			return { 0, 0, 0, 0 };
+		}
+		size_t index = ((size_t) y * m_header.width) + x;
+		return PixelBuffer::decodePixel(m_payload, index, m_header.bitdepth);
+	}
+
+	// decode row y into width() pixels at dst
+	int decodeRow(int y, RGBAColor* dst) const
+	{
+		if ( (y < 0) || (y >= m_header.height) || m_payload == nullptr ) {
+			return 0;
+		}
+		const size_t rowbytes = PixelBuffer::payloadSize(m_header.width, 1, m_header.bitdepth);
+		PixelBuffer::decodePixels(m_payload + rowbytes * y, dst, m_header.width, m_header.bitdepth);
+		return 1;
+	}
+
+	// decode (or copy) the whole image into a PixelBuffer
+	PixelBuffer toPixelBuffer() const
+	{
+		PixelBuffer buffer(m_header.width, m_header.height, m_header.bitdepth);
+		if (m_payload != nullptr) {
+			PixelBuffer::decodePixels(m_payload, buffer.pixels().data(), buffer.pixels().size(), m_header.bitdepth);
+		}
+		return buffer;
+	}
+};
+
+} // namespace rt
+
+#endif // MAPPEDPIXELBUFFER_H
@@ -0,0 +1,396 @@
+/**
+ * @file palette.h
+ * @brief Palette reduction (median cut) and 8 bit indexed images: rt::Palette, rt::IndexedBuffer
+ * @see https://github.com/rktrlng/pixelbuffer
+ */
+
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include <pixelbuffer/color.h>
+#include <pixelbuffer/pixelbuffer.h>
+
+namespace rt {
+
+// Up to 256 colors. medianCut() picks them for an image: the colors of the
+// image are put in a box that is split at the median of its widest channel
+// (r, g, b or a), and again, until there are enough boxes. Each box gives the
+// (pixel weighted) average of its colors.
+// index() finds the nearest palette color through a cache of 32768 entries,
+// one for every 5:5:5 bit r, g, b of an opaque color, filled on first use
+// with the nearest color to the center of that cell. Colors that are not
+// opaque are looked up exactly (nearest()), all fully transparent colors are
+// (0, 0, 0, 0).
+class Palette
+{
+private:
+	std::vector<RGBAColor> m_colors;
+	std::vector<int16_t> m_inverse; // the inverse color map (see index())
+	uint8_t m_transparent = 0;      // the index for pixels with alpha 0
+
+	static const int16_t UNKNOWN = -1;   // not looked up yet
+	static const int16_t AMBIGUOUS = -2; // more than one palette color: nearest()
+
+	static size_t _cell(const RGBAColor& color)
+	{
+		return ((color.r >> 3) << 10) | ((color.g >> 3) << 5) | (color.b >> 3);
+	}
+
+	// A cell with an opaque palette color maps to that color, so the colors
+	// of the palette always find themselves.
+	void _initInverse()
+	{
+		m_inverse.assign(1 << 15, UNKNOWN);
+		for (size_t i = 0; i < m_colors.size(); i++) {
+			if (m_colors[i].a != 255) { continue; }
+			int16_t& entry = m_inverse[_cell(m_colors[i])];
+			entry = (entry == UNKNOWN || (entry >= 0 && m_colors[entry] == m_colors[i])) ? (int16_t) i : AMBIGUOUS;
+		}
+		m_transparent = nearest(RGBAColor(0, 0, 0, 0));
+	}
+
+	// a color with its number of pixels
+	struct Entry {
+		RGBAColor color;
+		uint32_t count;
+	};
+
+	static uint8_t _channel(const RGBAColor& color, int channel)
+	{
+		return channel == 0 ? color.r : channel == 1 ? color.g : channel == 2 ? color.b : color.a;
+	}
+
+	// entries [begin, end), with the channel (r, g, b or a) they differ most in
+	struct Box {
+		size_t begin;
+		size_t end;
+		int channel;
+		int range; // 0: a single color, not split any further
+	};
+
+	static Box _box(const std::vector<Entry>& entries, size_t begin, size_t end)
+	{
+		uint8_t lo[4] = { 255, 255, 255, 255 };
+		uint8_t hi[4] = { 0, 0, 0, 0 };
+		for (size_t i = begin; i < end; i++) {
+			for (int c = 0; c < 4; c++) {
+				const uint8_t v = _channel(entries[i].color, c);
+				lo[c] = std::min(lo[c], v);
+				hi[c] = std::max(hi[c], v);
+			}
+		}
+		Box box = { begin, end, 0, 0 };
+		for (int c = 0; c < 4; c++) {
+			if (hi[c] - lo[c] > box.range) { box.range = hi[c] - lo[c]; box.channel = c; }
+		}
+		return box;
+	}
+
+	static RGBAColor _average(const std::vector<Entry>& entries, size_t begin, size_t end)
+	{
+		uint64_t total[4] = { 0, 0, 0, 0 };
+		uint64_t count = 0;
+		for (size_t i = begin; i < end; i++) {
+			for (int c = 0; c < 4; c++) { total[c] += (uint64_t) _channel(entries[i].color, c) * entries[i].count; }
+			count += entries[i].count;
+		}
+		const uint64_t half = count / 2;
+		return RGBAColor((total[0] + half) / count, (total[1] + half) / count, (total[2] + half) / count, (total[3] + half) / count);
+	}
+
+public:
+	Palette() { }
+
+	explicit Palette(const std::vector<RGBAColor>& colors) :
+		m_colors(colors.begin(), colors.begin() + std::min<size_t>(colors.size(), 256))
+	{ }
+
+	const std::vector<RGBAColor>& colors() const { return m_colors; }
+	size_t size() const { return m_colors.size(); }
+	bool empty() const { return m_colors.empty(); }
+	const RGBAColor& operator[](size_t index) const { return m_colors[index]; }
+
+	/**
+	 * @brief a palette of (at most) numcolors colors for the pixels of a view
+	 * @param view the pixels (straight alpha)
+	 * @param numcolors 1-256
+	 * @return Palette (with fewer colors if the image has fewer)
+	 */
+	static Palette medianCut(const ConstPixelView& view, size_t numcolors = 256)
+	{
+		numcolors = std::min<size_t>(std::max<size_t>(numcolors, 1), 256);
+
+		// every distinct color once, with its number of pixels
+		// (all fully transparent pixels are the same color)
+		std::vector<uint32_t> values;
+		values.reserve((size_t) view.width() * view.height());
+		for (size_t y = 0; y < view.height(); y++) {
+			const RGBAColor* r = view.row(y);
+			for (size_t x = 0; x < view.width(); x++) {
+				values.push_back(r[x].a == 0 ? 0 : r[x].asInt());
+			}
+		}
+		std::sort(values.begin(), values.end());
+		std::vector<Entry> entries;
+		for (size_t i = 0; i < values.size(); ) {
+			size_t j = i;
+			while (j < values.size() && values[j] == values[i]) { j++; }
+			entries.push_back({ RGBAColor::fromInt(values[i]), (uint32_t) (j - i) });
+			i = j;
+		}
+		if (entries.empty()) { return Palette(); }
+
+		// boxes are ranges of entries: split the box with the widest channel
+		std::vector<Box> boxes(1, _box(entries, 0, entries.size()));
+		while (boxes.size() < numcolors) {
+			size_t best = 0;
+			for (size_t b = 1; b < boxes.size(); b++) {
+				if (boxes[b].range > boxes[best].range) { best = b; }
+			}
+			if (boxes[best].range == 0) { break; } // every box is a single color
+
+			// sort the box by that channel and split where half of its pixels are
+			const size_t begin = boxes[best].begin;
+			const size_t end = boxes[best].end;
+			const int channel = boxes[best].channel;
+			std::sort(entries.begin() + begin, entries.begin() + end, [channel](const Entry& a, const Entry& b) {
+				return _channel(a.color, channel) < _channel(b.color, channel);
+			});
+			uint64_t total = 0;
+			for (size_t i = begin; i < end; i++) { total += entries[i].count; }
+			uint64_t running = 0;
+			size_t split = begin + 1;
+			for (size_t i = begin; i < end - 1; i++) {
+				running += entries[i].count;
+				split = i + 1;
+				if (running * 2 >= total) { break; }
+			}
+			boxes[best] = _box(entries, begin, split);
+			boxes.push_back(_box(entries, split, end));
+		}
+
+		std::vector<RGBAColor> colors;
+		for (const Box& box : boxes) {
+			colors.push_back(_average(entries, box.begin, box.end));
+		}
+		return Palette(colors);
+	}
+
+	static Palette medianCut(const PixelBuffer& pb, size_t numcolors = 256)
+	{
+		if (pb.premultiplied()) {
+			PixelBuffer straight = pb;
+			straight.unpremultiply();
+			return medianCut(straight.view(), numcolors);
+		}
+		return medianCut(pb.view(), numcolors);
+	}
+
+	/**
+	 * @brief the index of the nearest palette color (squared distance of r, g, b, a)
+	 * @param color the color to look up
+	 * @return uint8_t index (0 for an empty palette)
+	 */
+	uint8_t nearest(const RGBAColor& color) const
+	{
+		int best = 0;
+		int bestdistance = 4 * 255 * 255 + 1;
+		for (size_t i = 0; i < m_colors.size(); i++) {
+			const int dr = color.r - m_colors[i].r;
+			const int dg = color.g - m_colors[i].g;
+			const int db = color.b - m_colors[i].b;
+			const int da = color.a - m_colors[i].a;
+			const int distance = dr * dr + dg * dg + db * db + da * da;
+			if (distance < bestdistance) { best = i; bestdistance = distance; }
+		}
+		return best;
+	}
+
+	/**
+	 * @brief the index of the nearest palette color, through the inverse color map for opaque colors
+	 * @param color the color to look up
+	 * @return uint8_t index
+	 */
+	uint8_t index(const RGBAColor& color)
+	{
+		if (m_inverse.empty()) { _initInverse(); }
+		if (color.a == 0) { return m_transparent; }
+		if (color.a != 255) { return nearest(color); }
+		const int16_t entry = m_inverse[_cell(color)];
+		if (entry >= 0) { return entry; }
+		if (entry == AMBIGUOUS) { return nearest(color); }
+		const uint8_t found = nearest(RGBAColor((color.r & 0xF8) | 4, (color.g & 0xF8) | 4, (color.b & 0xF8) | 4, 255));
+		m_inverse[_cell(color)] = found;
+		return found;
+	}
+
+	// replace every pixel with its palette color
+	void remap(PixelBuffer& pb)
+	{
+		if (m_colors.empty()) { return; }
+		const bool premultiplied = pb.premultiplied();
+		pb.unpremultiply();
+		for (RGBAColor& pixel : pb.pixels()) { pixel = m_colors[index(pixel)]; }
+		if (premultiplied) { pb.premultiply(); }
+	}
+};
+
+// An 8 bit image: a palette and one palette index per pixel, a quarter of the
+// size of 32 bit pixels. Read and written as an indexed pbf (PBF_INDEXED, see
+// PixelBuffer::PBPHeader), which PixelBuffer::read() also reads.
+class IndexedBuffer
+{
+private:
+	uint16_t m_width = 0;
+	uint16_t m_height = 0;
+	Palette m_palette;
+	std::vector<uint8_t> m_indices;
+
+public:
+	IndexedBuffer() { }
+
+	// numcolors colors through Palette::medianCut()
+	explicit IndexedBuffer(const PixelBuffer& pb, size_t numcolors = 256)
+	{
+		fromPixelBuffer(pb, Palette::medianCut(pb, numcolors));
+	}
+
+	IndexedBuffer(const PixelBuffer& pb, const Palette& palette)
+	{
+		fromPixelBuffer(pb, palette);
+	}
+
+	IndexedBuffer(const std::string& filename)
+	{
+		read(filename);
+	}
+
+	uint16_t width() const { return m_width; }
+	uint16_t height() const { return m_height; }
+	const Palette& palette() const { return m_palette; }
+	std::vector<uint8_t>& indices() { return m_indices; }
+	const std::vector<uint8_t>& indices() const { return m_indices; }
+
+	bool valid() const { return m_width > 0 && m_height > 0 && !m_palette.empty() && m_indices.size() == (size_t) m_width * m_height; }
+
+	RGBAColor getPixel(int x, int y) const
+	{
+		if ( (x < 0) || (x >= m_width) || (y < 0) || (y >= m_height) ) {
+			return { 0, 0, 0, 0 };
+		}
+		return m_palette[m_indices[(size_t) y * m_width + x]];
+	}
+
+	// every pixel of pb as the index of its nearest palette color
+	int fromPixelBuffer(const PixelBuffer& pb, Palette palette)
+	{
+		if (!pb.valid() || palette.empty()) { return 0; }
+		m_width = pb.width();
+		m_height = pb.height();
+		m_indices.resize(pb.pixels().size());
+		const bool premultiplied = pb.premultiplied();
+		const std::vector<RGBAColor>& pixels = pb.pixels();
+		for (size_t i = 0; i < pixels.size(); i++) {
+			m_indices[i] = palette.index(premultiplied ? rt::unpremultiply(pixels[i]) : pixels[i]);
+		}
+		m_palette = palette;
+		return 1;
+	}
+
+	PixelBuffer toPixelBuffer() const
+	{
+		PixelBuffer pb(m_width, m_height, 32);
+		if (!valid()) { return pb; }
+		RGBAColor* dst = pb.pixels().data();
+		for (size_t i = 0; i < m_indices.size(); i++) {
+			dst[i] = m_palette[m_indices[i]];
+		}
+		return pb;
+	}
+
+	int read(const std::string& filename)
+	{
+		std::ifstream file(filename, std::fstream::in|std::fstream::binary|std::fstream::ate);
+		if (!file.is_open()) {
+			std::cout << "Unable to open file: " << filename << std::endl;
+			return 0;
+		}
+		const size_t size = file.tellg();
+		std::vector<uint8_t> data(size);
+		file.seekg(0, std::fstream::beg);
+		file.read((char*)data.data(), size);
+
+		PixelBuffer::PBHeader header;
+		PixelBuffer::PBPHeader pheader;
+		const size_t offset = sizeof(header) + sizeof(pheader);
+		bool ok = size >= offset;
+		if (ok) {
+			std::memcpy(&header, data.data(), sizeof(header));
+			std::memcpy(&pheader, data.data() + sizeof(header), sizeof(pheader));
+			const size_t numpixels = (size_t) header.width * header.height;
+			ok = header.bitdepth == (8 | PBF_INDEXED) && header.typep == 0x70 && header.typeb == 0x62 && header.end == 0x3A &&
+				pheader.colors > 0 && pheader.colors <= 256 &&
+				size >= offset + pheader.colors * sizeof(RGBAColor) + numpixels;
+		}
+		if (ok) {
+			// every index is in the palette
+			const uint8_t* indices = data.data() + offset + pheader.colors * sizeof(RGBAColor);
+			const size_t numpixels = (size_t) header.width * header.height;
+			const uint16_t colors = pheader.colors;
+			ok = std::none_of(indices, indices + numpixels, [colors](uint8_t index) { return index >= colors; });
+		}
+		if (!ok) {
+			std::cout << "Invalid indexed pbf file: " << filename << std::endl;
+			*this = IndexedBuffer();
+			return 0;
+		}
+
+		std::vector<RGBAColor> colors(pheader.colors);
+		std::memcpy((void*)colors.data(), data.data() + offset, colors.size() * sizeof(RGBAColor));
+		const uint8_t* indices = data.data() + offset + colors.size() * sizeof(RGBAColor);
+		m_width = header.width;
+		m_height = header.height;
+		m_palette = Palette(colors);
+		m_indices.assign(indices, indices + (size_t) m_width * m_height);
+		return size;
+	}
+
+	// an indexed pbf: header, palette, indices
+	int write(const std::string& filename) const
+	{
+		if (!valid()) {
+			std::cout << "Invalid indexedbuffer, not writing: " << filename << std::endl;
+			return 0;
+		}
+
+		std::ofstream file(filename, std::fstream::out|std::fstream::binary|std::fstream::trunc);
+		if (!file.is_open()) {
+			std::cout << "Unable to write to file: " << filename << std::endl;
+			return 0;
+		}
+
+		PixelBuffer::PBHeader header;
+		header.width = m_width;
+		header.height = m_height;
+		header.bitdepth = 8 | PBF_INDEXED;
+		PixelBuffer::PBPHeader pheader;
+		pheader.colors = m_palette.size();
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)&pheader, sizeof(pheader));
+		file.write((const char*)m_palette.colors().data(), m_palette.size() * sizeof(RGBAColor));
+		file.write((const char*)m_indices.data(), m_indices.size());
+		return file.good() ? 1 : 0;
+	}
+};
+
+} // namespace rt
+
+#endif // PALETTE_H
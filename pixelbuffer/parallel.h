@@ -0,0 +1,273 @@
+/**
+ * @file parallel.h
+ * @brief Thread pool and multithreaded pbf reading/writing: rt::ThreadPool, rt::readParallel, rt::writeParallel
+ * @see https://github.com/rktrlng/pixelbuffer
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+#include <pixelbuffer/lz.h>
+#include <pixelbuffer/pixelbuffer.h>
+
+namespace rt {
+
+// A fixed set of worker threads. run() hands out the indices of a task to the
+// workers and the calling thread, and returns when all of them are done.
+class ThreadPool
+{
+private:
+	std::vector<std::thread> m_threads;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	const std::function<void(size_t)>* m_task = nullptr;
+	size_t m_count = 0;
+	size_t m_next = 0;
+	size_t m_finished = 0;
+	uint64_t m_generation = 0;
+	bool m_stop = false;
+
+	// take indices of the current task until there are none left
+	void _work(std::unique_lock<std::mutex>& lock)
+	{
+		while (m_next < m_count) {
+			size_t index = m_next++;
+			const std::function<void(size_t)>& task = *m_task;
+			lock.unlock();
+			task(index);
+			lock.lock();
+			if (++m_finished == m_count) { m_done.notify_all(); }
+		}
+	}
+
+	void _worker()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		uint64_t generation = 0;
+		while (true) {
+			m_wake.wait(lock, [&] { return m_stop || m_generation != generation; });
+			if (m_stop) { return; }
+			generation = m_generation;
+			_work(lock);
+		}
+	}
+
+public:
+	// threads: total number of threads working on a task, including the caller of run()
+	explicit ThreadPool(unsigned threads = std::thread::hardware_concurrency())
+	{
+		if (threads < 1) { threads = 1; }
+		for (unsigned i = 1; i < threads; i++) {
+			m_threads.emplace_back(&ThreadPool::_worker, this);
+		}
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_wake.notify_all();
+		for (auto& thread : m_threads) {
+			thread.join();
+		}
+	}
+
+	ThreadPool(const ThreadPool& other) = delete;
+	ThreadPool& operator=(const ThreadPool& other) = delete;
+
+	size_t size() const { return m_threads.size() + 1; }
+
+	// call task(i) for every i in [0, count), blocks until all calls returned
+	void run(size_t count, const std::function<void(size_t)>& task)
+	{
+		if (count == 0) { return; }
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_task = &task;
+		m_count = count;
+		m_next = 0;
+		m_finished = 0;
+		m_generation++;
+		m_wake.notify_all();
+
+		_work(lock);
+		m_done.wait(lock, [&] { return m_finished == m_count; });
+		m_task = nullptr;
+		m_count = 0;
+	}
+
+	// split [0, count) in about ranges ranges and call func(begin, end) for each of them
+	void runRanges(size_t count, size_t ranges, const std::function<void(size_t, size_t)>& func)
+	{
+		if (count == 0) { return; }
+		if (ranges < 1) { ranges = 1; }
+		if (ranges > count) { ranges = count; }
+		const size_t step = (count + ranges - 1) / ranges;
+		run((count + step - 1) / step, [&](size_t i) {
+			func(i * step, std::min(count, (i + 1) * step));
+		});
+	}
+};
+
+/**
+ * @brief read a pbf (compressed or not) and decode it on all threads of a pool
+ * Bands of rows are read and decoded by separate threads, each with its own
+ * file stream. Chunks of compressed pbf files are decompressed in parallel.
+ * @param pb the PixelBuffer to read into
+ * @param filename the file to read
+ * @param pool the threads to use
+ * @return size of the file, 0 on failure
+ */
+inline int readParallel(PixelBuffer& pb, const std::string& filename, ThreadPool& pool)
+{
+	std::ifstream file(filename, std::fstream::in|std::fstream::binary|std::fstream::ate);
+	if (!file.is_open()) {
+		std::cout << "Unable to open file: " << filename << std::endl;
+		return 0;
+	}
+
+	const size_t size = file.tellg();
+	PixelBuffer::PBHeader header;
+	if (size >= sizeof(header)) {
+		file.seekg(0, std::fstream::beg);
+		file.read((char*)&header, sizeof(header));
+	}
+	const bool compressed = header.bitdepth & PBF_COMPRESSED;
+	header.bitdepth &= ~PBF_COMPRESSED;
+
+	const size_t rowbytes = PixelBuffer::payloadSize(header.width, 1, header.bitdepth);
+	if (size < sizeof(header) || !PixelBuffer::validHeader(header) ||
+		(!compressed && size - sizeof(header) < rowbytes * header.height))
+	{
+		std::cout << "Invalid pbf file: " << filename << std::endl;
+		return 0;
+	}
+
+	pb = PixelBuffer(header.width, header.height, header.bitdepth);
+	RGBAColor* pixels = pb.pixels().data();
+	std::atomic<bool> ok(true);
+
+	if (compressed) {
+		std::vector<uint8_t> memblock(size);
+		file.seekg(0, std::fstream::beg);
+		file.read((char*)memblock.data(), size);
+
+		PixelBuffer::PBZHeader zheader;
+		std::vector<uint64_t> offsets;
+		if (PixelBuffer::readChunkTable(memblock.data(), size, header, zheader, nullptr)) {
+			offsets.resize(zheader.chunks + 1);
+		}
+		if (offsets.empty() || !PixelBuffer::readChunkTable(memblock.data(), size, header, zheader, offsets.data()) ||
+			offsets.back() > size)
+		{
+			std::cout << "Invalid pbf file: " << filename << std::endl;
+			return 0;
+		}
+
+		pool.run(zheader.chunks, [&](size_t c) {
+			const size_t y = c * zheader.bandrows;
+			const size_t rows = std::min<size_t>(zheader.bandrows, header.height - y);
+			const size_t rawsize = rows * rowbytes;
+			const uint8_t* chunk = memblock.data() + offsets[c];
+			const size_t chunksize = offsets[c+1] - offsets[c];
+			if (header.bitdepth == 32) {
+				if (lz_decompress(chunk, chunksize, (uint8_t*)&pixels[y * header.width], rawsize) != rawsize) { ok = false; }
+			} else {
+				std::vector<uint8_t> raw(rawsize);
+				if (lz_decompress(chunk, chunksize, raw.data(), rawsize) != rawsize) { ok = false; }
+				PixelBuffer::decodePixels(raw.data(), &pixels[y * header.width], rows * header.width, header.bitdepth);
+			}
+		});
+	} else {
+		file.close();
+		pool.runRanges(header.height, pool.size() * 4, [&](size_t y0, size_t y1) {
+			std::ifstream band(filename, std::fstream::in|std::fstream::binary);
+			band.seekg(sizeof(header) + y0 * rowbytes, std::fstream::beg);
+			const size_t bytes = (y1 - y0) * rowbytes;
+			if (header.bitdepth == 32) {
+				band.read((char*)&pixels[y0 * header.width], bytes);
+			} else {
+				std::vector<uint8_t> raw(bytes);
+				band.read((char*)raw.data(), bytes);
+				PixelBuffer::decodePixels(raw.data(), &pixels[y0 * header.width], (y1 - y0) * header.width, header.bitdepth);
+			}
+			if (!band) { ok = false; }
+		});
+	}
+
+	if (!ok) {
+		std::cout << "Invalid pbf file: " << filename << std::endl;
+		pb = PixelBuffer();
+		return 0;
+	}
+	return size;
+}
+
+/**
+ * @brief encode and write a pbf on all threads of a pool
+ * Bands of rows are encoded and written by separate threads, each with its own
+ * file stream, at their place in the file.
+ * @param pb the PixelBuffer to write
+ * @param filename the file to write
+ * @param pool the threads to use
+ * @return 1 on success, 0 on failure
+ */
+inline int writeParallel(const PixelBuffer& pb, const std::string& filename, ThreadPool& pool)
+{
+	if (!pb.valid()) {
+		std::cout << "Invalid pixelbuffer, not writing: " << filename << std::endl;
+		return 0;
+	}
+	if (pb.premultiplied()) {
+		PixelBuffer straight = pb;
+		straight.unpremultiply();
+		return writeParallel(straight, filename, pool);
+	}
+
+	// Write the header (and truncate the file)
+	{
+		std::ofstream file(filename, std::fstream::out|std::fstream::binary|std::fstream::trunc);
+		if (!file.is_open()) {
+			std::cout << "Unable to write to file: " << filename << std::endl;
+			return 0;
+		}
+		file.write((const char*)&pb.header(), sizeof(PixelBuffer::PBHeader));
+	}
+
+	const PixelBuffer::PBHeader& header = pb.header();
+	const size_t rowbytes = PixelBuffer::payloadSize(header.width, 1, header.bitdepth);
+	const RGBAColor* pixels = pb.pixels().data();
+	std::atomic<bool> ok(true);
+
+	pool.runRanges(header.height, pool.size() * 4, [&](size_t y0, size_t y1) {
+		std::fstream band(filename, std::fstream::in|std::fstream::out|std::fstream::binary);
+		band.seekp(sizeof(header) + y0 * rowbytes, std::fstream::beg);
+		const size_t bytes = (y1 - y0) * rowbytes;
+		if (header.bitdepth == 32) {
+			band.write((const char*)&pixels[y0 * header.width], bytes);
+		} else {
+			std::vector<uint8_t> raw(bytes);
+			PixelBuffer::encodePixels(&pixels[y0 * header.width], raw.data(), (y1 - y0) * header.width, header.bitdepth);
+			band.write((const char*)raw.data(), bytes);
+		}
+		if (!band) { ok = false; }
+	});
+
+	return ok ? 1 : 0;
+}
+
+} // namespace rt
+
+#endif // PARALLEL_H
@@ -0,0 +1,232 @@
+/**
+ * @file pbfcontainer.h
+ * @brief Many pbf frames in one indexed file: rt::PbfContainerWriter, rt::PbfContainerReader
+ * @see https://github.com/rktrlng/pixelbuffer
+ */
+
+#ifndef PBFCONTAINER_H
+#define PBFCONTAINER_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+#include <pixelbuffer/mappedfile.h>
+#include <pixelbuffer/pixelbuffer.h>
+
+namespace rt {
+
+// A container file (.pba) is:
+//   PBAHeader
+//   frame 0, frame 1, ... each a complete pbf (PBHeader + pixeldata, may be compressed)
+//   index: one uint64_t file offset per frame
+//   PBATrailer
+// Frame n spans index[n] to index[n+1] (or to the index itself for the last frame).
+
+struct PBAHeader {
+	uint8_t typep = 0x70;      // 1 byte: 0x70 = 'p'
+	uint8_t typeb = 0x62;      // 1 byte: 0x62 = 'b'
+	uint8_t typea = 0x61;      // 1 byte: 0x61 = 'a'
+	uint8_t version = 0x01;    // 1 byte: 1
+	uint32_t reserved = 0;     // 4 bytes
+};                             // sizeof(PBAHeader) = 8 bytes
+
+struct PBATrailer {
+	uint64_t index = 0;        // 8 bytes: file offset of the index
+	uint32_t frames = 0;       // 4 bytes: number of frames
+	uint8_t typei = 0x69;      // 1 byte: 0x69 = 'i'
+	uint8_t typed = 0x64;      // 1 byte: 0x64 = 'd'
+	uint8_t typex = 0x78;      // 1 byte: 0x78 = 'x'
+	uint8_t end = 0x3A;        // 1 byte: 0x3A = ':'
+};                             // sizeof(PBATrailer) = 16 bytes
+
+class PbfContainerWriter
+{
+private:
+	std::ofstream m_file;
+	std::vector<uint64_t> m_index;
+	ScratchBuffer m_scratch;
+
+public:
+	PbfContainerWriter() { }
+
+	PbfContainerWriter(const std::string& filename)
+	{
+		open(filename);
+	}
+
+	~PbfContainerWriter()
+	{
+		close();
+	}
+
+	int open(const std::string& filename)
+	{
+		close();
+
+		m_file.open(filename, std::fstream::out|std::fstream::binary|std::fstream::trunc);
+		if (!m_file.is_open()) {
+			std::cout << "Unable to write to file: " << filename << std::endl;
+			return 0;
+		}
+
+		PBAHeader header;
+		m_file.write((const char*)&header, sizeof(header));
+		return 1;
+	}
+
+	bool isOpen() const { return m_file.is_open(); }
+	size_t frames() const { return m_index.size(); }
+
+	// append a frame, returns its frame number + 1 (0 on failure)
+	size_t append(const PixelBuffer& frame, bool compressed = false)
+	{
+		if (!isOpen()) { return 0; }
+		const uint64_t offset = m_file.tellp();
+		int ok = compressed ? frame.writeCompressed(m_file) : frame.write(m_file, m_scratch);
+		if (!ok) {
+			m_file.seekp(offset);
+			return 0;
+		}
+		m_index.push_back(offset);
+		return m_index.size();
+	}
+
+	// append an already encoded frame, returns its frame number + 1 (0 on failure)
+	size_t appendRaw(const uint8_t* data, size_t size)
+	{
+		if (!isOpen()) { return 0; }
+		const uint64_t offset = m_file.tellp();
+		m_file.write((const char*)data, size);
+		if (!m_file) { return 0; }
+		m_index.push_back(offset);
+		return m_index.size();
+	}
+
+	// write the index, returns 1 on success
+	int close()
+	{
+		if (!isOpen()) { return 0; }
+
+		PBATrailer trailer;
+		trailer.index = m_file.tellp();
+		trailer.frames = m_index.size();
+		m_file.write((const char*)m_index.data(), m_index.size() * sizeof(uint64_t));
+		m_file.write((const char*)&trailer, sizeof(trailer));
+		int ok = m_file.good() ? 1 : 0;
+
+		m_file.close();
+		m_index.clear();
+		return ok;
+	}
+};
+
+// Maps a container file: any frame can be decoded in O(1), sequential reads
+// ask the os to page in the next frames ahead of time.
+class PbfContainerReader
+{
+private:
+	MappedFile m_file;
+	std::vector<uint64_t> m_index; // frames + 1 offsets, the last one is the start of the index
+	size_t m_position = 0;
+	size_t m_readahead = 4;
+
+public:
+	PbfContainerReader() { }
+
+	PbfContainerReader(const std::string& filename)
+	{
+		open(filename);
+	}
+
+	int open(const std::string& filename)
+	{
+		close();
+		if (!m_file.open(filename)) { return 0; }
+
+		const uint8_t* data = m_file.data();
+		const size_t size = m_file.size();
+
+		PBAHeader header;
+		PBATrailer trailer;
+		PBATrailer check;
+		bool ok = size >= sizeof(PBAHeader) + sizeof(PBATrailer);
+		if (ok) {
+			std::memcpy(&header, data, sizeof(PBAHeader));
+			std::memcpy(&trailer, data + size - sizeof(PBATrailer), sizeof(PBATrailer));
+			ok = header.typep == 0x70 && header.typeb == 0x62 && header.typea == 0x61 && header.version == 1 &&
+				trailer.typei == check.typei && trailer.typed == check.typed && trailer.typex == check.typex &&
+				trailer.end == check.end &&
+				trailer.index >= sizeof(PBAHeader) &&
+				trailer.index <= size - sizeof(PBATrailer) &&
+				(size - sizeof(PBATrailer) - trailer.index) / sizeof(uint64_t) == trailer.frames;
+		}
+		if (ok) {
+			m_index.resize(trailer.frames + 1);
+			std::memcpy(m_index.data(), data + trailer.index, trailer.frames * sizeof(uint64_t));
+			m_index[trailer.frames] = trailer.index;
+			for (size_t i = 0; i < trailer.frames; i++) {
+				if (m_index[i] < sizeof(PBAHeader) || m_index[i] > m_index[i+1]) { ok = false; }
+			}
+		}
+		if (!ok) {
+			std::cout << "Invalid pba file: " << filename << std::endl;
+			close();
+			return 0;
+		}
+
+		return size;
+	}
+
+	void close()
+	{
+		m_file.close();
+		m_index.clear();
+		m_position = 0;
+	}
+
+	bool isOpen() const { return m_file.isOpen(); }
+	size_t frames() const { return m_index.empty() ? 0 : m_index.size() - 1; }
+
+	// the frame next() will return
+	size_t position() const { return m_position; }
+	void seek(size_t n) { m_position = n; }
+
+	// number of frames next() pages in ahead of time
+	void readahead(size_t frames) { m_readahead = frames; }
+
+	// the encoded frame as stored in the file (nullptr if n is out of range)
+	const uint8_t* frameData(size_t n, size_t& size) const
+	{
+		if (n >= frames()) { size = 0; return nullptr; }
+		size = m_index[n+1] - m_index[n];
+		return m_file.data() + m_index[n];
+	}
+
+	// decode frame n
+	int frame(size_t n, PixelBuffer& out) const
+	{
+		size_t size = 0;
+		const uint8_t* data = frameData(n, size);
+		if (data == nullptr) { return 0; }
+		return out.read(data, size) ? 1 : 0;
+	}
+
+	// decode the frame at position() and move on to the next
+	int next(PixelBuffer& out)
+	{
+		if (m_position >= frames()) { return 0; }
+		if (m_readahead > 0 && m_position + 1 < frames()) {
+			size_t last = std::min(m_position + 1 + m_readahead, frames());
+			m_file.willNeed(m_index[m_position + 1], m_index[last] - m_index[m_position + 1]);
+		}
+		return frame(m_position++, out);
+	}
+};
+
+} // namespace rt
+
+#endif // PBFCONTAINER_H
@@ -0,0 +1,334 @@
+/**
+ * @file pbfdelta.h
+ * @brief Keyframe + changed tiles encoding of frame sequences: rt::DeltaSequenceWriter, rt::DeltaSequenceReader
+ * @see https://github.com/rktrlng/pixelbuffer
+ */
+
+#ifndef PBFDELTA_H
+#define PBFDELTA_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+#include <pixelbuffer/lz.h>
+#include <pixelbuffer/pbfcontainer.h>
+#include <pixelbuffer/pixelbuffer.h>
+
+namespace rt {
+
+// A delta sequence is a pba container (see pbfcontainer.h) that holds a keyframe
+// (a regular pbf) every so many frames. The frames in between are delta frames
+// that only hold the tiles that changed since the previous frame:
+//   PBHeader (end = 0x64 'd')
+//   PBDHeader
+//   tiles x uint32_t tile index (row major, tilesize x tilesize tiles)
+//   lz compressed pixeldata of the changed tiles (row by row, clipped at the edges)
+
+const uint8_t PBF_DELTA = 0x64; // PBHeader end marker of a delta frame: 0x64 = 'd'
+
+struct PBDHeader {
+	uint16_t tilesize = 16;    // 2 bytes: tile width and height in pixels (multiple of 8)
+	uint16_t reserved = 0;     // 2 bytes
+	uint32_t tiles = 0;        // 4 bytes: number of changed tiles
+};                             // sizeof(PBDHeader) = 8 bytes
+
+// position and size of a tile, clipped to width x height
+inline void _delta_tile(size_t index, uint16_t tilesize, uint16_t width, uint16_t height, size_t& x, size_t& y, size_t& w, size_t& h)
+{
+	const size_t cols = (width + tilesize - 1) / tilesize;
+	x = (index % cols) * tilesize;
+	y = (index / cols) * tilesize;
+	w = std::min<size_t>(tilesize, width - x);
+	h = std::min<size_t>(tilesize, height - y);
+}
+
+/**
+ * @brief encode the tiles of current that differ from previous as a delta frame
+ * (in straight alpha, like keyframes: premultiplied frames are converted)
+ * @param previous the previous frame (same size and bitdepth as current)
+ * @param current the frame to encode
+ * @param tilesize tile width and height, a multiple of 8
+ * @param out the delta frame is appended to out (nothing is appended on a size, bitdepth or tilesize mismatch)
+ * @return number of changed tiles
+ */
+inline size_t encodeDelta(const PixelBuffer& previous, const PixelBuffer& current, uint16_t tilesize, std::vector<uint8_t>& out)
+{
+	if (!previous.valid() || !current.valid() || previous.width() != current.width() ||
+		previous.height() != current.height() || previous.bitdepth() != current.bitdepth() ||
+		tilesize == 0 || tilesize % 8 != 0)
+	{
+		return 0;
+	}
+	if (previous.premultiplied() || current.premultiplied()) {
+		PixelBuffer straightprevious = previous;
+		PixelBuffer straightcurrent = current;
+		straightprevious.unpremultiply();
+		straightcurrent.unpremultiply();
+		return encodeDelta(straightprevious, straightcurrent, tilesize, out);
+	}
+
+	const uint16_t width = current.width();
+	const uint16_t height = current.height();
+	const uint8_t bitdepth = current.bitdepth();
+	const size_t cols = (width + tilesize - 1) / tilesize;
+	const size_t rows = (height + tilesize - 1) / tilesize;
+
+	// find the changed tiles
+	std::vector<uint32_t> tiles;
+	for (size_t ty = 0; ty < rows; ty++) {
+		for (size_t tx = 0; tx < cols; tx++) {
+			size_t x, y, w, h;
+			_delta_tile(ty * cols + tx, tilesize, width, height, x, y, w, h);
+			for (size_t r = 0; r < h; r++) {
+				const size_t offset = (y + r) * width + x;
+				if (std::memcmp((const void*)&previous.pixels()[offset], (const void*)&current.pixels()[offset], w * sizeof(RGBAColor)) != 0) {
+					tiles.push_back(ty * cols + tx);
+					break;
+				}
+			}
+		}
+	}
+
+	// encode their pixels
+	std::vector<uint8_t> raw;
+	for (uint32_t tile : tiles) {
+		size_t x, y, w, h;
+		_delta_tile(tile, tilesize, width, height, x, y, w, h);
+		const size_t rowbytes = PixelBuffer::payloadSize(w, 1, bitdepth);
+		for (size_t r = 0; r < h; r++) {
+			raw.resize(raw.size() + rowbytes);
+			PixelBuffer::encodePixels(&current.pixels()[(y + r) * width + x], &raw[raw.size() - rowbytes], w, bitdepth);
+		}
+	}
+
+	PixelBuffer::PBHeader header = current.header();
+	header.end = PBF_DELTA;
+	PBDHeader dheader;
+	dheader.tilesize = tilesize;
+	dheader.tiles = tiles.size();
+
+	out.insert(out.end(), (const uint8_t*)&header, (const uint8_t*)&header + sizeof(header));
+	out.insert(out.end(), (const uint8_t*)&dheader, (const uint8_t*)&dheader + sizeof(dheader));
+	out.insert(out.end(), (const uint8_t*)tiles.data(), (const uint8_t*)(tiles.data() + tiles.size()));
+	lz_compress(raw.data(), raw.size(), out);
+
+	return tiles.size();
+}
+
+/**
+ * @brief apply a delta frame to the previous frame
+ * @param data the delta frame
+ * @param size size of the delta frame
+ * @param frame the previous frame, becomes the current frame (the changed tiles are premultiplied if frame is)
+ * @return 1 on success, 0 on invalid data or a size/bitdepth mismatch
+ */
+inline int applyDelta(const uint8_t* data, size_t size, PixelBuffer& frame)
+{
+	PixelBuffer::PBHeader header;
+	PBDHeader dheader;
+	if (size < sizeof(header) + sizeof(dheader)) { return 0; }
+	std::memcpy(&header, data, sizeof(header));
+	std::memcpy(&dheader, data + sizeof(header), sizeof(dheader));
+	if (header.end != PBF_DELTA || header.width != frame.width() || header.height != frame.height() ||
+		header.bitdepth != frame.bitdepth() || !frame.valid() || dheader.tilesize == 0 || dheader.tilesize % 8 != 0)
+	{
+		return 0;
+	}
+
+	const size_t numtiles = (size_t) ((header.width + dheader.tilesize - 1) / dheader.tilesize) *
+		((header.height + dheader.tilesize - 1) / dheader.tilesize);
+	const size_t start = sizeof(header) + sizeof(dheader);
+	if ((size - start) / sizeof(uint32_t) < dheader.tiles) { return 0; }
+	std::vector<uint32_t> tiles(dheader.tiles);
+	std::memcpy(tiles.data(), data + start, dheader.tiles * sizeof(uint32_t));
+
+	size_t rawsize = 0;
+	for (uint32_t tile : tiles) {
+		if (tile >= numtiles) { return 0; }
+		size_t x, y, w, h;
+		_delta_tile(tile, dheader.tilesize, header.width, header.height, x, y, w, h);
+		rawsize += h * PixelBuffer::payloadSize(w, 1, header.bitdepth);
+	}
+
+	const size_t compressed = start + dheader.tiles * sizeof(uint32_t);
+	std::vector<uint8_t> raw(rawsize);
+	if (lz_decompress(data + compressed, size - compressed, raw.data(), rawsize) != rawsize) { return 0; }
+
+	const uint8_t* src = raw.data();
+	for (uint32_t tile : tiles) {
+		size_t x, y, w, h;
+		_delta_tile(tile, dheader.tilesize, header.width, header.height, x, y, w, h);
+		const size_t rowbytes = PixelBuffer::payloadSize(w, 1, header.bitdepth);
+		for (size_t r = 0; r < h; r++) {
+			RGBAColor* dst = &frame.pixels()[(y + r) * header.width + x];
+			PixelBuffer::decodePixels(src, dst, w, header.bitdepth);
+			if (frame.premultiplied()) {
+				for (size_t i = 0; i < w; i++) { dst[i] = rt::premultiply(dst[i]); }
+			}
+			src += rowbytes;
+		}
+	}
+
+	return 1;
+}
+
+class DeltaSequenceWriter
+{
+private:
+	PbfContainerWriter m_container;
+	PixelBuffer m_previous;
+	size_t m_keyinterval = 30;
+	uint16_t m_tilesize = 16;
+	size_t m_count = 0;
+	size_t m_keyframes = 0;
+	size_t m_tiles = 0;
+	std::vector<uint8_t> m_delta;
+
+public:
+	DeltaSequenceWriter() { }
+
+	DeltaSequenceWriter(const std::string& filename, size_t keyinterval = 30, uint16_t tilesize = 16)
+	{
+		open(filename, keyinterval, tilesize);
+	}
+
+	// keyinterval: a keyframe every keyinterval frames
+	// tilesize: changes are stored in tiles of tilesize x tilesize pixels (multiple of 8)
+	int open(const std::string& filename, size_t keyinterval = 30, uint16_t tilesize = 16)
+	{
+		if (tilesize == 0 || tilesize % 8 != 0) { return 0; }
+		m_keyinterval = keyinterval > 0 ? keyinterval : 1;
+		m_tilesize = tilesize;
+		m_count = 0;
+		m_keyframes = 0;
+		m_tiles = 0;
+		m_previous = PixelBuffer();
+		return m_container.open(filename);
+	}
+
+	int close() { return m_container.close(); }
+
+	bool isOpen() const { return m_container.isOpen(); }
+	size_t frames() const { return m_count; }
+	size_t keyframes() const { return m_keyframes; }
+	// total number of changed tiles stored in delta frames
+	size_t tiles() const { return m_tiles; }
+
+	int append(const PixelBuffer& frame)
+	{
+		if (!isOpen() || !frame.valid()) { return 0; }
+		// keyframes are written in straight alpha, so the delta frames are too
+		if (frame.premultiplied()) {
+			PixelBuffer straight = frame;
+			straight.unpremultiply();
+			return append(straight);
+		}
+
+		const bool key = (m_count % m_keyinterval == 0) ||
+			frame.width() != m_previous.width() ||
+			frame.height() != m_previous.height() ||
+			frame.bitdepth() != m_previous.bitdepth();
+
+		size_t ok = 0;
+		if (key) {
+			ok = m_container.append(frame, true);
+			m_keyframes++;
+		} else {
+			m_delta.clear();
+			m_tiles += encodeDelta(m_previous, frame, m_tilesize, m_delta);
+			ok = m_container.appendRaw(m_delta.data(), m_delta.size());
+		}
+		if (!ok) { return 0; }
+
+		m_previous = frame;
+		m_count++;
+		return 1;
+	}
+};
+
+class DeltaSequenceReader
+{
+private:
+	PbfContainerReader m_container;
+	PixelBuffer m_current;
+	size_t m_position = 0; // the frame after m_current
+	bool m_decoded = false;
+
+	bool _isKeyframe(size_t n) const
+	{
+		size_t size = 0;
+		const uint8_t* data = m_container.frameData(n, size);
+		if (data == nullptr || size < sizeof(PixelBuffer::PBHeader)) { return false; }
+		return data[sizeof(PixelBuffer::PBHeader) - 1] != PBF_DELTA;
+	}
+
+	int _decode(size_t n)
+	{
+		size_t size = 0;
+		const uint8_t* data = m_container.frameData(n, size);
+		if (data == nullptr) { return 0; }
+		int ok = _isKeyframe(n) ? m_current.read(data, size) : applyDelta(data, size, m_current);
+		m_decoded = ok;
+		m_position = n + 1;
+		return ok ? 1 : 0;
+	}
+
+public:
+	DeltaSequenceReader() { }
+
+	DeltaSequenceReader(const std::string& filename)
+	{
+		open(filename);
+	}
+
+	int open(const std::string& filename)
+	{
+		m_position = 0;
+		m_decoded = false;
+		return m_container.open(filename);
+	}
+
+	bool isOpen() const { return m_container.isOpen(); }
+	size_t frames() const { return m_container.frames(); }
+
+	// the frame next() will return
+	size_t position() const { return m_position; }
+
+	// decode the frame after the last decoded one
+	int next(PixelBuffer& out)
+	{
+		if (m_position >= frames()) { return 0; }
+		if (!m_decoded && !_isKeyframe(m_position)) { return frame(m_position, out); }
+		if (!_decode(m_position)) { return 0; }
+		out = m_current;
+		return 1;
+	}
+
+	// decode frame n: from the current frame if n is ahead of it,
+	// otherwise from the nearest keyframe before n
+	int frame(size_t n, PixelBuffer& out)
+	{
+		if (n >= frames()) { return 0; }
+		if (m_decoded && m_position == n + 1) {
+			out = m_current;
+			return 1;
+		}
+
+		size_t start = n;
+		while (start > 0 && !_isKeyframe(start)) { start--; }
+		if (m_decoded && m_position > start && m_position <= n) {
+			start = m_position; // continue from the current frame
+		}
+		for (size_t i = start; i <= n; i++) {
+			if (!_decode(i)) { return 0; }
+		}
+		out = m_current;
+		return 1;
+	}
+};
+
+} // namespace rt
+
+#endif // PBFDELTA_H
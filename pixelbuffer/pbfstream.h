@@ -0,0 +1,310 @@
+/**
+ * @file pbfstream.h
+ * @brief Streaming scanline access to pbf files: rt::PbfReader, rt::PbfWriter
+ * @see https://github.com/rktrlng/pixelbuffer
+ */
+
+#ifndef PBFSTREAM_H
+#define PBFSTREAM_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+#include <pixelbuffer/color.h>
+#include <pixelbuffer/pixelbuffer.h>
+
+namespace rt {
+
+// Reads a pbf file a band of rows at a time into a caller supplied buffer,
+// so images larger than memory can be processed.
+// Compressed pbf files are read one chunk at a time, seekRow() only decompresses
+// the chunk that holds the requested row.
+class PbfReader
+{
+private:
+	std::ifstream m_file;
+	PixelBuffer::PBHeader m_header;
+	size_t m_row = 0;
+	std::vector<uint8_t> m_scratch;
+
+	bool m_compressed = false;
+	PixelBuffer::PBZHeader m_zheader;
+	std::vector<uint64_t> m_offsets;
+	size_t m_chunkindex = 0;
+	std::vector<uint8_t> m_chunk; // decompressed pixeldata of chunk m_chunkindex
+
+	size_t _rowbytes() const { return PixelBuffer::payloadSize(m_header.width, 1, m_header.bitdepth); }
+
+	bool _loadChunk(size_t c)
+	{
+		if (!m_chunk.empty() && m_chunkindex == c) { return true; }
+		m_chunk.clear();
+
+		const size_t rows = std::min<size_t>(m_zheader.bandrows, m_header.height - c * m_zheader.bandrows);
+		const size_t rawsize = rows * _rowbytes();
+		m_scratch.resize(m_offsets[c+1] - m_offsets[c]);
+		m_file.clear();
+		m_file.seekg(m_offsets[c], std::fstream::beg);
+		m_file.read((char*)m_scratch.data(), m_scratch.size());
+		if (!m_file) { return false; }
+
+		m_chunk.resize(rawsize);
+		if (lz_decompress(m_scratch.data(), m_scratch.size(), m_chunk.data(), rawsize) != rawsize) {
+			m_chunk.clear();
+			return false;
+		}
+		m_chunkindex = c;
+		return true;
+	}
+
+	bool _readChunkTable(size_t size)
+	{
+		std::vector<uint8_t> head(sizeof(PixelBuffer::PBHeader) + sizeof(PixelBuffer::PBZHeader));
+		m_file.seekg(0, std::fstream::beg);
+		m_file.read((char*)head.data(), head.size());
+		if (!m_file || !PixelBuffer::readChunkTable(head.data(), head.size(), m_header, m_zheader, nullptr)) {
+			return false;
+		}
+
+		head.resize(head.size() + (m_zheader.chunks + 1) * sizeof(uint64_t));
+		m_file.seekg(0, std::fstream::beg);
+		m_file.read((char*)head.data(), head.size());
+		m_offsets.resize(m_zheader.chunks + 1);
+		if (!m_file || !PixelBuffer::readChunkTable(head.data(), head.size(), m_header, m_zheader, m_offsets.data())) {
+			return false;
+		}
+		return m_offsets.back() <= size;
+	}
+
+public:
+	PbfReader() { }
+
+	PbfReader(const std::string& filename)
+	{
+		open(filename);
+	}
+
+	int open(const std::string& filename)
+	{
+		close();
+
+		m_file.open(filename, std::fstream::in|std::fstream::binary|std::fstream::ate);
+		if (!m_file.is_open()) {
+			std::cout << "Unable to open file: " << filename << std::endl;
+			return 0;
+		}
+
+		const size_t size = m_file.tellg();
+		m_file.seekg(0, std::fstream::beg);
+		if (size >= sizeof(PixelBuffer::PBHeader)) {
+			m_file.read((char*)&m_header, sizeof(PixelBuffer::PBHeader));
+		}
+		m_compressed = m_header.bitdepth & PBF_COMPRESSED;
+		m_header.bitdepth &= ~PBF_COMPRESSED;
+
+		const size_t payload = PixelBuffer::payloadSize(m_header.width, m_header.height, m_header.bitdepth);
+		if (size < sizeof(PixelBuffer::PBHeader) || !PixelBuffer::validHeader(m_header) ||
+			(m_compressed && !_readChunkTable(size)) ||
+			(!m_compressed && size - sizeof(PixelBuffer::PBHeader) < payload))
+		{
+			std::cout << "Invalid pbf file: " << filename << std::endl;
+			close();
+			return 0;
+		}
+
+		return 1;
+	}
+
+	void close()
+	{
+		if (m_file.is_open()) { m_file.close(); }
+		m_header = PixelBuffer::PBHeader();
+		m_row = 0;
+		m_compressed = false;
+		m_offsets.clear();
+		m_chunk.clear();
+	}
+
+	bool isOpen() const { return m_file.is_open(); }
+	bool compressed() const { return m_compressed; }
+	const PixelBuffer::PBHeader& header() const { return m_header; }
+	uint16_t width() const { return m_header.width; }
+	uint16_t height() const { return m_header.height; }
+	uint8_t bitdepth() const { return m_header.bitdepth; }
+
+	// the next row readRows() will return
+	size_t row() const { return m_row; }
+
+	int seekRow(size_t y)
+	{
+		if (!isOpen() || y > m_header.height) { return 0; }
+		if (m_compressed) {
+			m_row = y;
+			return 1;
+		}
+		m_file.clear();
+		m_file.seekg(sizeof(PixelBuffer::PBHeader) + y * _rowbytes(), std::fstream::beg);
+		m_row = y;
+		return 1;
+	}
+
+	// Read up to rows rows into dst (room for rows * width() pixels).
+	// Returns the number of rows read, 0 at the end of the image.
+	size_t readRows(RGBAColor* dst, size_t rows)
+	{
+		if (!isOpen()) { return 0; }
+		rows = std::min<size_t>(rows, m_header.height - m_row);
+		if (rows == 0) { return 0; }
+
+		if (m_compressed) {
+			const size_t rowbytes = _rowbytes();
+			if (rowbytes == 0) { m_row += rows; return rows; }
+			size_t done = 0;
+			while (done < rows) {
+				const size_t y = m_row + done;
+				const size_t c = y / m_zheader.bandrows;
+				if (!_loadChunk(c)) { return 0; }
+				const size_t first = y - c * m_zheader.bandrows;
+				const size_t n = std::min(rows - done, m_chunk.size() / rowbytes - first);
+				PixelBuffer::decodePixels(&m_chunk[first * rowbytes], dst + done * m_header.width, n * m_header.width, m_header.bitdepth);
+				done += n;
+			}
+			m_row += rows;
+			return rows;
+		}
+
+		const size_t numpixels = rows * m_header.width;
+		const size_t bytes = rows * _rowbytes();
+		if (m_header.bitdepth == 32) {
+			m_file.read((char*)dst, bytes);
+		} else {
+			m_scratch.resize(bytes);
+			m_file.read((char*)m_scratch.data(), bytes);
+			PixelBuffer::decodePixels(m_scratch.data(), dst, numpixels, m_header.bitdepth);
+		}
+		if (!m_file) { return 0; }
+
+		m_row += rows;
+		return rows;
+	}
+};
+
+// Writes a pbf file a band of rows at a time from a caller supplied buffer.
+class PbfWriter
+{
+private:
+	std::ofstream m_file;
+	PixelBuffer::PBHeader m_header;
+	size_t m_row = 0;
+	std::vector<uint8_t> m_scratch;
+
+public:
+	PbfWriter() { }
+
+	PbfWriter(const std::string& filename, uint16_t width, uint16_t height, uint8_t bitdepth = 32)
+	{
+		open(filename, width, height, bitdepth);
+	}
+
+	~PbfWriter()
+	{
+		close();
+	}
+
+	int open(const std::string& filename, uint16_t width, uint16_t height, uint8_t bitdepth = 32)
+	{
+		close();
+
+		PixelBuffer::PBHeader header;
+		header.width = width;
+		header.height = height;
+		header.bitdepth = bitdepth;
+		if (!PixelBuffer::validHeader(header)) {
+			std::cout << "Invalid bitdepth, not writing: " << filename << std::endl;
+			return 0;
+		}
+
+		m_file.open(filename, std::fstream::out|std::fstream::binary|std::fstream::trunc);
+		if (!m_file.is_open()) {
+			std::cout << "Unable to write to file: " << filename << std::endl;
+			return 0;
+		}
+
+		m_header = header;
+		m_file.write((char*)&m_header, sizeof(m_header));
+		return 1;
+	}
+
+	// Returns 1 if all rows of the image were written.
+	int close()
+	{
+		if (!m_file.is_open()) { return 0; }
+		m_file.close();
+		int complete = (m_row == m_header.height);
+		m_header = PixelBuffer::PBHeader();
+		m_row = 0;
+		return complete;
+	}
+
+	bool isOpen() const { return m_file.is_open(); }
+	const PixelBuffer::PBHeader& header() const { return m_header; }
+	uint16_t width() const { return m_header.width; }
+	uint16_t height() const { return m_header.height; }
+	uint8_t bitdepth() const { return m_header.bitdepth; }
+
+	// the next row writeRows() will write
+	size_t row() const { return m_row; }
+
+	// Write up to rows rows from src (rows * width() pixels).
+	// Returns the number of rows written.
+	size_t writeRows(const RGBAColor* src, size_t rows)
+	{
+		if (!isOpen()) { return 0; }
+		rows = std::min<size_t>(rows, m_header.height - m_row);
+		if (rows == 0) { return 0; }
+
+		const size_t numpixels = rows * m_header.width;
+		const size_t bytes = rows * PixelBuffer::payloadSize(m_header.width, 1, m_header.bitdepth);
+		if (m_header.bitdepth == 32) {
+			m_file.write((const char*)src, bytes);
+		} else {
+			m_scratch.resize(bytes);
+			PixelBuffer::encodePixels(src, m_scratch.data(), numpixels, m_header.bitdepth);
+			m_file.write((const char*)m_scratch.data(), bytes);
+		}
+		if (!m_file) { return 0; }
+
+		m_row += rows;
+		return rows;
+	}
+
+	// Write the rows of a view (of width() pixels wide), a row at a time
+	// if they are not contiguous (or premultiplied, converted to straight alpha).
+	// Returns the number of rows written.
+	size_t writeRows(const ConstPixelView& view)
+	{
+		if (view.width() != m_header.width) { return 0; }
+		if (view.contiguous() && !view.premultiplied()) { return writeRows(view.data(), view.height()); }
+		std::vector<RGBAColor> straight;
+		if (view.premultiplied()) { straight.resize(view.width()); }
+		size_t rows = 0;
+		for (size_t y = 0; y < view.height(); y++) {
+			const RGBAColor* src = view.row(y);
+			if (view.premultiplied()) {
+				std::transform(src, src + view.width(), straight.begin(), [](const RGBAColor& c) { return rt::unpremultiply(c); });
+				src = straight.data();
+			}
+			if (writeRows(src, 1) != 1) { break; }
+			rows++;
+		}
+		return rows;
+	}
+};
+
+} // namespace rt
+
+#endif // PBFSTREAM_H
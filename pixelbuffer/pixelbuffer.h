@@ -11,10 +11,15 @@
 #include <fstream>
 #include <sstream>
 #include <vector>
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
+#include <memory>
 
 #include <pixelbuffer/color.h>
+#include <pixelbuffer/lz.h>
 #include <pixelbuffer/math/vec2.h>
+#include <pixelbuffer/pixelview.h>
 #include <pixelbuffer/util.h>
 
 namespace rt {
@@ -24,9 +29,48 @@ inline vec2i wrap (const vec2i& pos, int cols, int rows);
 inline vec2i clamp(const vec2i& pos, int cols, int rows);
 // =========================================================
 
-class PixelBuffer
+// 32 bit pbf pixeldata is stored exactly like a list of RGBAColors
+static_assert(sizeof(RGBAColor) == 4, "RGBAColor must be 4 bytes");
+
+// flag in the high bit of the pbf header bitdepth: pixeldata is compressed
+const uint8_t PBF_COMPRESSED = 0x80;
+// flag in the pbf header bitdepth (with bitdepth 8): pixeldata is palette indices
+const uint8_t PBF_INDEXED = 0x40;
+
+// Reusable scratch memory for encoding/decoding. It grows to the largest size
+// asked for and is then reused, so a loop that keeps one ScratchBuffer around
+// does no heap allocation after the first frame. The counters show it.
+class ScratchBuffer
 {
 private:
+	std::vector<uint8_t> m_data;
+	size_t m_requests = 0;
+	size_t m_allocations = 0;
+
+public:
+	// room for size bytes, valid until the next get() (which keeps the contents)
+	uint8_t* get(size_t size)
+	{
+		m_requests++;
+		if (size > m_data.size()) {
+			m_allocations++;
+			m_data.resize(size);
+		}
+		return m_data.data();
+	}
+
+	void release() { std::vector<uint8_t>().swap(m_data); }
+
+	size_t capacity() const { return m_data.size(); }
+	// number of get() calls
+	size_t requests() const { return m_requests; }
+	// number of get() calls that had to grow the buffer
+	size_t allocations() const { return m_allocations; }
+};
+
+class PixelBuffer
+{
+public:
 	struct PBHeader {
 		uint8_t typep = 0x70;      // 1 byte: 0x70 = 'p'
 		uint8_t typeb = 0x62;      // 1 byte: 0x62 = 'b'
@@ -38,17 +82,217 @@ private:
 	// uint64_t header = 0x706208000400203A; // 8x4 pixels, bitdepth 32, Little Endian
 	// uint64_t header = 0x706200080004203A; // 8x4 pixels, bitdepth 32, Big Endian
 
+	// Compressed pbf: the header bitdepth has the PBF_COMPRESSED flag and is followed by
+	// a PBZHeader, a table of (chunks + 1) uint64_t file offsets and the chunks.
+	// Chunk i holds the lz compressed pixeldata of rows [i*bandrows, (i+1)*bandrows)
+	// and spans offsets[i] to offsets[i+1]. Chunks can be decompressed independently.
+	struct PBZHeader {
+		uint16_t bandrows = 64;    // 2 bytes: rows per chunk
+		uint16_t reserved = 0;     // 2 bytes
+		uint32_t chunks = 0;       // 4 bytes: number of chunks
+	};                             // sizeof(PBZHeader) = 8 bytes
+
+	// Indexed pbf: the header bitdepth is 8 with the PBF_INDEXED flag and is followed by
+	// a PBPHeader, the palette (colors RGBAColors) and one palette index per pixel
+	// (see palette.h). It is read into RGBAColors, as a 32 bit PixelBuffer.
+	struct PBPHeader {
+		uint16_t colors = 0;       // 2 bytes: 1-256 palette colors
+		uint16_t reserved = 0;     // 2 bytes
+	};                             // sizeof(PBPHeader) = 4 bytes
+
+private:
 	PBHeader m_header;
-	std::vector<RGBAColor> m_pixels;
+	// Pixels, shared between buffers only in copy-on-write mode (or when empty).
+	// Read through m_pixels, write through _pixels() or _reset().
+	std::shared_ptr<std::vector<RGBAColor>> m_pixels = _empty();
+	bool m_cow = false;
+	// pixels hold premultiplied alpha (see premultiply())
+	bool m_premultiplied = false;
 
 	inline bool _validBitdepth(uint8_t b) const {
-		return (
-			(b == 1 && m_header.width%8 == 0) ||
-			b == 8 ||
-			b == 16 ||
-			b == 24 ||
-			b == 32
-		);
+		return validBitdepth(b, m_header.width);
+	}
+
+	// the pixels of all empty buffers (never written to, see _pixels())
+	static const std::shared_ptr<std::vector<RGBAColor>>& _empty()
+	{
+		static const std::shared_ptr<std::vector<RGBAColor>> empty = std::make_shared<std::vector<RGBAColor>>();
+		return empty;
+	}
+
+	// the pixels, to write to: shared pixels are copied first
+	std::vector<RGBAColor>& _pixels()
+	{
+		if (m_pixels.use_count() != 1) {
+			m_pixels = std::make_shared<std::vector<RGBAColor>>(*m_pixels);
+		}
+		return *m_pixels;
+	}
+
+	// a straight alpha copy, to write
+	PixelBuffer _straight() const
+	{
+		PixelBuffer buffer = *this;
+		buffer.unpremultiply();
+		return buffer;
+	}
+
+	// numpixels pixels to overwrite: shared pixels are not copied
+	std::vector<RGBAColor>& _reset(size_t numpixels)
+	{
+		if (m_pixels.use_count() != 1) {
+			m_pixels = std::make_shared<std::vector<RGBAColor>>(numpixels);
+		} else {
+			m_pixels->resize(numpixels);
+		}
+		return *m_pixels;
+	}
+
+	void _copyPixels(const PixelBuffer& other)
+	{
+		if (m_cow || other.m_cow) {
+			m_pixels = other.m_pixels;
+			return;
+		}
+		const std::vector<RGBAColor>& src = *other.m_pixels;
+		if (m_pixels.use_count() == 1 && m_pixels->size() == src.size()) {
+			// same size: copy over our own pixels
+			if (!src.empty()) { std::memcpy((void*)m_pixels->data(), (const void*)src.data(), src.size() * sizeof(RGBAColor)); }
+		} else if (src.empty()) {
+			m_pixels = _empty();
+		} else {
+			m_pixels = std::make_shared<std::vector<RGBAColor>>(src);
+		}
+	}
+
+	// the palette and indices of an indexed pbf (m_header.bitdepth without the flag),
+	// an index that is not in the palette makes the file invalid
+	bool _readIndexed(const uint8_t* data, size_t size)
+	{
+		const size_t numpixels = (size_t) m_header.width * m_header.height;
+		PBPHeader pheader;
+		if (m_header.bitdepth != 8 || size < sizeof(PBHeader) + sizeof(PBPHeader)) { return false; }
+		std::memcpy(&pheader, data + sizeof(PBHeader), sizeof(PBPHeader));
+		const size_t start = sizeof(PBHeader) + sizeof(PBPHeader) + pheader.colors * sizeof(RGBAColor);
+		if (pheader.colors == 0 || pheader.colors > 256 || size < start + numpixels) { return false; }
+
+		const uint8_t* indices = data + start;
+		const uint16_t colors = pheader.colors;
+		if (std::any_of(indices, indices + numpixels, [colors](uint8_t index) { return index >= colors; })) { return false; }
+
+		RGBAColor palette[256];
+		std::memcpy((void*)palette, data + sizeof(PBHeader) + sizeof(PBPHeader), pheader.colors * sizeof(RGBAColor));
+		RGBAColor* pixels = _reset(numpixels).data();
+		for (size_t i = 0; i < numpixels; i++) {
+			pixels[i] = palette[indices[i]];
+		}
+		m_header.bitdepth = 32;
+		return true;
+	}
+
+	// decompress all chunks of a compressed pbf file (in memory) into the pixels
+	bool _decompress(const uint8_t* data, size_t size)
+	{
+		PBZHeader zheader;
+		if (!readChunkTable(data, size, m_header, zheader, nullptr)) { return false; }
+		std::vector<uint64_t> offsets(zheader.chunks + 1);
+		if (!readChunkTable(data, size, m_header, zheader, offsets.data()) || offsets[zheader.chunks] > size) {
+			return false;
+		}
+
+		const size_t rowbytes = payloadSize(m_header.width, 1, m_header.bitdepth);
+		std::vector<uint8_t> raw;
+		for (size_t c = 0; c < zheader.chunks; c++) {
+			const size_t y = c * zheader.bandrows;
+			const size_t rows = std::min<size_t>(zheader.bandrows, m_header.height - y);
+			const size_t rawsize = rows * rowbytes;
+			const uint8_t* chunk = data + offsets[c];
+			const size_t chunksize = offsets[c+1] - offsets[c];
+			RGBAColor* pixels = &_pixels()[y * m_header.width];
+			if (m_header.bitdepth == 32) {
+				if (lz_decompress(chunk, chunksize, (uint8_t*)pixels, rawsize) != rawsize) { return false; }
+			} else {
+				raw.resize(rawsize);
+				if (lz_decompress(chunk, chunksize, raw.data(), rawsize) != rawsize) { return false; }
+				decodePixels(raw.data(), pixels, rows * m_header.width, m_header.bitdepth);
+			}
+		}
+		return true;
+	}
+
+	// x, y of the spans floodFill() still has to look at: the first 256 on the
+	// call stack, the rest in a ScratchBuffer
+	class FillStack
+	{
+	private:
+		int m_local[2 * 256];
+		int* m_seeds = m_local;
+		size_t m_capacity = 256;
+		size_t m_count = 0;
+		ScratchBuffer& m_scratch;
+
+	public:
+		explicit FillStack(ScratchBuffer& scratch) : m_scratch(scratch) { }
+
+		bool empty() const { return m_count == 0; }
+
+		void push(int x, int y)
+		{
+			if (m_count == m_capacity) {
+				int* seeds = reinterpret_cast<int*>(m_scratch.get(m_capacity * 4 * sizeof(int)));
+				// a growing ScratchBuffer keeps its contents
+				if (m_seeds == m_local) { std::memcpy(seeds, m_local, sizeof(m_local)); }
+				m_seeds = seeds;
+				m_capacity *= 2;
+			}
+			m_seeds[2 * m_count] = x;
+			m_seeds[2 * m_count + 1] = y;
+			m_count++;
+		}
+
+		void pop(int& x, int& y)
+		{
+			m_count--;
+			x = m_seeds[2 * m_count];
+			y = m_seeds[2 * m_count + 1];
+		}
+	};
+
+	// Fill the span of check_color through x, y (not on the edge) and every span
+	// connected to it that is not on the edge either. Pixels on the edge next to
+	// a span are filled, but don't spread.
+	void _fillSpans(int x, int y, const RGBAColor& check_color, const RGBAColor& filled, FillStack& seeds)
+	{
+		const int width = m_header.width;
+		const int height = m_header.height;
+		RGBAColor* pixels = row(0);
+		seeds.push(x, y);
+		while (!seeds.empty()) {
+			seeds.pop(x, y);
+			RGBAColor* r = pixels + (size_t) y * width;
+			if (r[x] != check_color) { continue; }
+			int left = x;
+			int right = x;
+			while (left > 1 && r[left - 1] == check_color) { left--; }
+			while (right < width - 2 && r[right + 1] == check_color) { right++; }
+			for (int i = left; i <= right; i++) { r[i] = filled; }
+			if (left == 1 && r[0] == check_color) { r[0] = filled; }
+			if (right == width - 2 && r[width - 1] == check_color) { r[width - 1] = filled; }
+
+			// the rows above and below: a seed for every span, or filled on the edge
+			for (int ny = y - 1; ny <= y + 1; ny += 2) {
+				RGBAColor* n = pixels + (size_t) ny * width;
+				const bool edge = (ny == 0 || ny == height - 1);
+				for (int i = left; i <= right; i++) {
+					if (n[i] != check_color) { continue; }
+					if (edge) {
+						n[i] = filled;
+					} else if (i == left || n[i - 1] != check_color) {
+						seeds.push(i, ny);
+					}
+				}
+			}
+		}
 	}
 
 public:
@@ -64,10 +308,9 @@ public:
 		m_header.width = width;
 		m_header.height = height;
 		m_header.bitdepth = bitdepth;
-		const size_t numpixels = width * height;
-		m_pixels.reserve(numpixels);
-		for (size_t i = 0; i < numpixels; i++) {
-			m_pixels.emplace_back(color);
+		const size_t numpixels = (size_t) width * height;
+		if (numpixels > 0) {
+			m_pixels = std::make_shared<std::vector<RGBAColor>>(numpixels, color);
 		}
 	}
 
@@ -76,32 +319,143 @@ public:
 		read(filename);
 	}
 
-	PixelBuffer(const PixelBuffer& other)
+	// a copy of the pixels of a view
+	explicit PixelBuffer(const ConstPixelView& view, uint8_t bitdepth = 32)
 	{
-		m_header.width = other.m_header.width;
-		m_header.height = other.m_header.height;
-		m_header.bitdepth = other.m_header.bitdepth;
-		const size_t numpixels = m_header.width * m_header.height;
-		m_pixels.reserve(numpixels);
-		for (size_t i = 0; i < numpixels; i++) {
-			m_pixels.emplace_back(other.m_pixels[i]);
+		m_header.width = view.width();
+		m_header.height = view.height();
+		m_header.bitdepth = bitdepth;
+		m_premultiplied = view.premultiplied();
+		std::vector<RGBAColor>& pixels = _reset((size_t) view.width() * view.height());
+		for (size_t y = 0; y < view.height(); y++) {
+			std::copy(view.row(y), view.row(y) + view.width(), &pixels[y * view.width()]);
 		}
 	}
 
-	~PixelBuffer()
+	PixelBuffer(const PixelBuffer& other) :
+		m_header(other.m_header),
+		m_cow(other.m_cow),
+		m_premultiplied(other.m_premultiplied)
 	{
-		m_header.width = 0;
-		m_header.height = 0;
-		m_pixels.clear();
+		_copyPixels(other);
 	}
 
-	std::vector<RGBAColor>& pixels() { return m_pixels; }
-	const std::vector<RGBAColor>& pixels() const { return m_pixels; }
+	PixelBuffer(PixelBuffer&& other) noexcept :
+		m_header(other.m_header),
+		m_pixels(std::move(other.m_pixels)),
+		m_cow(other.m_cow),
+		m_premultiplied(other.m_premultiplied)
+	{
+		other.m_header.width = 0;
+		other.m_header.height = 0;
+		other.m_pixels = _empty();
+	}
+
+	PixelBuffer& operator=(const PixelBuffer& other)
+	{
+		if (this == &other) { return *this; }
+		m_header = other.m_header;
+		m_cow = other.m_cow;
+		m_premultiplied = other.m_premultiplied;
+		_copyPixels(other);
+		return *this;
+	}
+
+	PixelBuffer& operator=(PixelBuffer&& other) noexcept
+	{
+		if (this == &other) { return *this; }
+		m_header = other.m_header;
+		m_cow = other.m_cow;
+		m_premultiplied = other.m_premultiplied;
+		m_pixels = std::move(other.m_pixels);
+		other.m_header.width = 0;
+		other.m_header.height = 0;
+		other.m_pixels = _empty();
+		return *this;
+	}
+
+	// Copy-on-write: copies of a buffer in this mode share its pixels until one
+	// of them changes a pixel. Off by default: every copy gets its own pixels.
+	// (Changing a pixel, or asking for pixels() or operator[] on a non-const
+	// buffer, copies shared pixels. Don't keep those references across copies.)
+	void copyOnWrite(bool enable) { m_cow = enable; }
+	bool copyOnWrite() const { return m_cow; }
+
+	// a copy that shares the pixels of this buffer until either one changes
+	PixelBuffer snapshot() const
+	{
+		PixelBuffer buffer;
+		buffer.m_header = m_header;
+		buffer.m_pixels = m_pixels;
+		buffer.m_cow = m_cow;
+		buffer.m_premultiplied = m_premultiplied;
+		return buffer;
+	}
+
+	// true if the pixels are shared with another buffer
+	bool shared() const { return m_pixels.use_count() > 1 && m_pixels != _empty(); }
+
+	// Premultiplied alpha: the pixels hold r, g, b scaled by a, and blending is
+	// an integer multiply-add (rt::premultipliedBlend) instead of rt::alphaBlend.
+	// Colors passed to setPixel(), fill() and the drawing functions, and
+	// returned by getPixel(), are still straight alpha. pixels(), row(), at()
+	// and operator[] give the stored (premultiplied) pixels.
+	// Files are straight alpha: writing converts a copy, reading gives straight pixels.
+	bool premultiplied() const { return m_premultiplied; }
+
+	// convert the pixels to premultiplied alpha
+	void premultiply()
+	{
+		if (m_premultiplied) { return; }
+		if (!m_pixels->empty()) {
+			for (RGBAColor& pixel : _pixels()) { pixel = rt::premultiply(pixel); }
+		}
+		m_premultiplied = true;
+	}
+
+	// convert the pixels back to straight alpha
+	void unpremultiply()
+	{
+		if (!m_premultiplied) { return; }
+		if (!m_pixels->empty()) {
+			for (RGBAColor& pixel : _pixels()) { pixel = rt::unpremultiply(pixel); }
+		}
+		m_premultiplied = false;
+	}
+
+	std::vector<RGBAColor>& pixels() { return _pixels(); }
+	const std::vector<RGBAColor>& pixels() const { return *m_pixels; }
+
+	// all pixels or the pixels of a rectangle (clipped), drawn and filtered in place
+	// (an invalid buffer gives an empty view)
+	PixelView view()
+	{
+		if ((size_t) m_header.width * m_header.height != m_pixels->size()) { return PixelView(); }
+		return PixelView(_pixels().data(), m_header.width, m_header.height, m_header.width, m_premultiplied);
+	}
+	ConstPixelView view() const
+	{
+		if ((size_t) m_header.width * m_header.height != m_pixels->size()) { return ConstPixelView(); }
+		return ConstPixelView(m_pixels->data(), m_header.width, m_header.height, m_header.width, m_premultiplied);
+	}
+	PixelView view(int x, int y, int width, int height) { return view().sub(x, y, width, height); }
+	ConstPixelView view(int x, int y, int width, int height) const { return view().sub(x, y, width, height); }
+	// Unchecked access for hot loops: clip once, then work on whole rows.
+	// row(y) points to the width() pixels of row y, at(x, y) is the pixel at x, y.
+	// (On a non-const buffer they copy shared pixels, like pixels().)
+	RGBAColor* row(size_t y) { return &_pixels()[y * m_header.width]; }
+	const RGBAColor* row(size_t y) const { return &(*m_pixels)[y * m_header.width]; }
+	RGBAColor& at(size_t x, size_t y) { return _pixels()[y * m_header.width + x]; }
+	const RGBAColor& at(size_t x, size_t y) const { return (*m_pixels)[y * m_header.width + x]; }
+
+	// checked: an index out of range gives the first pixel
 	inline RGBAColor& operator[](size_t index) {
-		if (index < m_pixels.size()) { return m_pixels[index]; }
-		return m_pixels[0];
+		std::vector<RGBAColor>& pixels = _pixels();
+		if (index < pixels.size()) { return pixels[index]; }
+		return pixels[0];
 	}
 
+	const PBHeader& header() const { return m_header; }
 	uint16_t width() const { return m_header.width; }
 	uint16_t height() const { return m_header.height; }
 	uint8_t bitdepth() const { return m_header.bitdepth; }
@@ -118,7 +472,7 @@ public:
 			m_header.typeb == 0x62 &&
 			( _validBitdepth(m_header.bitdepth) ) &&
 			m_header.end == 0x3A &&
-			m_header.width * m_header.height == m_pixels.size();
+			m_header.width * m_header.height == m_pixels->size();
 	}
 
 	void printInfo() const
@@ -131,7 +485,7 @@ public:
 		std::cout << "width: " << width << " pixels" << std::endl;
 		std::cout << "height: " << height << " pixels" << std::endl;
 		std::cout << "bitdepth: " << (int) bitdepth << " b/pixel" << std::endl;
-		std::cout << "number of pixels: " << (int) m_pixels.size() << std::endl;
+		std::cout << "number of pixels: " << (int) m_pixels->size() << std::endl;
 		std::cout << "memsize of pbf: " << (width * height * (bitdepth/8.0f)) + sizeof(m_header) << " B" << std::endl;
 		std::cout << "memsize of pixels: " << (width * height * (bitdepth/8.0f)) << " B";
 		std::cout << " | " << (width * height * (bitdepth/8.0f)) / 1024.0f << " KiB";
@@ -148,70 +502,97 @@ public:
 			return 0;
 		}
 
-		// Read the file into a bytearray
-		const int size = file.tellg();
-		uint8_t* memblock = new uint8_t[size];
-		file.seekg(0, std::fstream::beg);
-		file.read((char*)memblock, size);
-		file.close();
-
 		// Build header
-		m_header = *(PBHeader*)&memblock[0];
+		const size_t size = file.tellg();
+		if (size < sizeof(PBHeader)) {
+			std::cout << "Invalid pbf file: " << filename << std::endl;
+			return 0;
+		}
+		file.seekg(0, std::fstream::beg);
+		file.read((char*)&m_header, sizeof(PBHeader));
+		m_premultiplied = false;
+
+		const bool compressed = m_header.bitdepth & PBF_COMPRESSED;
+		const bool indexed = m_header.bitdepth & PBF_INDEXED;
+		m_header.bitdepth &= ~(PBF_COMPRESSED | PBF_INDEXED);
+
+		const size_t numpixels = (size_t) m_header.width * m_header.height;
+		const size_t payload = payloadSize(m_header.width, m_header.height, m_header.bitdepth);
+		if (!validHeader(m_header) || (compressed && indexed) || (!compressed && size - sizeof(PBHeader) < payload)) {
+			std::cout << "Invalid pbf file: " << filename << std::endl;
+			m_header = PBHeader();
+			m_pixels = _empty();
+			return 0;
+		}
 
 		// Build list of pixels
-		size_t numpixels = m_header.width * m_header.height;
-		m_pixels.clear();
-		m_pixels.reserve(numpixels);
-		size_t start = sizeof(m_header);
-
-		if (m_header.bitdepth == 1) {
-			for (size_t i = 0; i < numpixels / 8; i++) {
-				uint8_t val = memblock[start+0];
-				std::vector<RGBAColor> vec = byte2vec(val);
-				for (size_t i = 0; i < vec.size(); i++) {
-					m_pixels.emplace_back(vec[i]);
-				}
-				vec.clear();
-				start++; // next byte
+		if (compressed || indexed) {
+			std::vector<uint8_t> memblock(size);
+			file.seekg(0, std::fstream::beg);
+			file.read((char*)memblock.data(), size);
+			file.close();
+			if (!read(memblock.data(), size)) {
+				std::cout << "Invalid pbf file: " << filename << std::endl;
+				return 0;
 			}
+		} else if (m_header.bitdepth == 32) {
+			// The payload has the same layout as our pixels: read it in place
+			file.read((char*)_reset(numpixels).data(), payload);
 		} else {
-			for (size_t i = 0; i < numpixels; i++) {
-				RGBAColor pixel;
-				if (m_header.bitdepth == 8 || m_header.bitdepth == 16) {
-					uint8_t val = memblock[start+0];
-					pixel.r = val;
-					pixel.g = val;
-					pixel.b = val;
-					pixel.a = 255;
-				}
-
-				if (m_header.bitdepth == 16) {
-					pixel.a = memblock[start+1];
-				}
-				else if (m_header.bitdepth == 24 || m_header.bitdepth == 32) {
-					pixel.r = memblock[start+0];
-					pixel.g = memblock[start+1];
-					pixel.b = memblock[start+2];
-					pixel.a = 255;
-				}
-
-				if (m_header.bitdepth == 32) {
-					pixel.a = memblock[start+3];
-				}
+			std::vector<uint8_t> memblock(payload);
+			file.read((char*)memblock.data(), payload);
+			decodePixels(memblock.data(), _reset(numpixels).data(), numpixels, m_header.bitdepth);
+		}
 
-				m_pixels.emplace_back(pixel);
+		return size;
+	}
 
-				start += m_header.bitdepth / 8;
+	// Read a pbf (compressed or not) from memory, returns 0 on invalid data
+	int read(const uint8_t* data, size_t size)
+	{
+		if (size < sizeof(PBHeader)) { return 0; }
+		std::memcpy(&m_header, data, sizeof(PBHeader));
+		m_premultiplied = false;
+
+		const bool compressed = m_header.bitdepth & PBF_COMPRESSED;
+		const bool indexed = m_header.bitdepth & PBF_INDEXED;
+		m_header.bitdepth &= ~(PBF_COMPRESSED | PBF_INDEXED);
+
+		const size_t numpixels = (size_t) m_header.width * m_header.height;
+		const size_t payload = payloadSize(m_header.width, m_header.height, m_header.bitdepth);
+		bool ok = validHeader(m_header) && !(compressed && indexed) && (compressed || size - sizeof(PBHeader) >= payload);
+		if (ok && indexed) {
+			ok = _readIndexed(data, size);
+		} else if (ok) {
+			std::vector<RGBAColor>& pixels = _reset(numpixels);
+			if (compressed) {
+				ok = _decompress(data, size);
+			} else {
+				decodePixels(data + sizeof(PBHeader), pixels.data(), numpixels, m_header.bitdepth);
 			}
 		}
-
-		delete[] memblock;
+		if (!ok) {
+			m_header = PBHeader();
+			m_pixels = _empty();
+			return 0;
+		}
 
 		return size;
 	}
 
 	int write(const std::string& filename) const
 	{
+		ScratchBuffer scratch;
+		return write(filename, scratch);
+	}
+
+	int write(const std::string& filename, ScratchBuffer& scratch) const
+	{
+		if (!valid()) {
+			std::cout << "Invalid pixelbuffer, not writing: " << filename << std::endl;
+			return 0;
+		}
+
 		// Try to write to a file
 		std::ofstream file(filename, std::fstream::out|std::fstream::binary|std::fstream::trunc);
 		if (!file.is_open()) {
@@ -219,55 +600,241 @@ public:
 			return 0;
 		}
 
+		int ok = write(file, scratch);
+		file.close();
+
+		return ok;
+	}
+
+	// Write header and pixeldata to a binary stream
+	int write(std::ostream& stream) const
+	{
+		ScratchBuffer scratch;
+		return write(stream, scratch);
+	}
+
+	// Write header and pixeldata to a binary stream, encoding in scratch
+	int write(std::ostream& stream, ScratchBuffer& scratch) const
+	{
+		if (!valid()) { return 0; }
+		if (m_premultiplied) { return _straight().write(stream, scratch); }
+
 		// Write header
-		file.write((char*)&m_header, sizeof(m_header));
+		stream.write((char*)&m_header, sizeof(m_header));
 
 		// Write pixeldata
-		// This would work if we only needed to write 4 bytes/pixel files:
-		// file.write((char*)&m_pixels[0], m_pixels.size()*m_header.bitdepth);
-
-		// But we also need to handle the bitdepth
-		if (m_header.bitdepth == 1) {
-			size_t start = 0;
-
-			char value = 0;
-			// width must be a multiple of 8 pixels
-			std::vector<RGBAColor> vec;
-			for (size_t i = 0; i < m_pixels.size(); i += 8) { // set of 8 pixels
-				for (size_t v = 0; v < 8; v++) {
-					vec.push_back(m_pixels[v+start]);
-				}
-				value = (char) vec2byte(vec);
-				file.write(&value, 1);
-				vec.clear();
-				start += 8;
-			}
+		if (m_header.bitdepth == 32) {
+			// 4 bytes/pixel files are our pixels as is
+			stream.write((const char*)m_pixels->data(), m_pixels->size() * sizeof(RGBAColor));
 		} else {
-			for (auto& pixel : m_pixels) {
-				if (m_header.bitdepth == 8 || m_header.bitdepth == 16) {
-					RGBAColor gray = rt::luminance(pixel);
-					char value = (char) gray.r;
-					file.write(&value, 1);
-				}
+			// encode bands of rows into a buffer of about 1 MiB and write each band at once
+			const size_t rowbytes = payloadSize(m_header.width, 1, m_header.bitdepth);
+			const size_t bandrows = std::max<size_t>(1, (1 << 20) / std::max<size_t>(1, rowbytes));
+			uint8_t* band = scratch.get(std::min<size_t>(bandrows, m_header.height) * rowbytes);
+			for (size_t y = 0; y < m_header.height; y += bandrows) {
+				const size_t rows = std::min<size_t>(bandrows, m_header.height - y);
+				encodePixels(&(*m_pixels)[y * m_header.width], band, rows * m_header.width, m_header.bitdepth);
+				stream.write((const char*)band, rows * rowbytes);
+			}
+		}
+
+		return stream.good() ? 1 : 0;
+	}
+
+	// Write the pixeldata lz compressed, in independent chunks of bandrows rows
+	int writeCompressed(const std::string& filename, uint16_t bandrows = 64) const
+	{
+		if (!valid() || bandrows == 0) {
+			std::cout << "Invalid pixelbuffer, not writing: " << filename << std::endl;
+			return 0;
+		}
+
+		// Try to write to a file
+		std::ofstream file(filename, std::fstream::out|std::fstream::binary|std::fstream::trunc);
+		if (!file.is_open()) {
+			std::cout << "Unable to write to file: " << filename << std::endl;
+			return 0;
+		}
+
+		int ok = writeCompressed(file, bandrows);
+		file.close();
+
+		return ok;
+	}
+
+	// Write a compressed pbf to a binary stream.
+	// Chunk offsets are relative to the start of the pbf, not the stream.
+	int writeCompressed(std::ostream& stream, uint16_t bandrows = 64) const
+	{
+		if (!valid() || bandrows == 0) { return 0; }
+		if (m_premultiplied) { return _straight().writeCompressed(stream, bandrows); }
+
+		PBHeader header = m_header;
+		header.bitdepth |= PBF_COMPRESSED;
+		PBZHeader zheader;
+		zheader.bandrows = bandrows;
+		zheader.chunks = (m_header.height + bandrows - 1) / bandrows;
+
+		// compress all chunks, keeping track of where they start
+		const size_t rowbytes = payloadSize(m_header.width, 1, m_header.bitdepth);
+		const size_t tablesize = (zheader.chunks + 1) * sizeof(uint64_t);
+		const size_t start = sizeof(PBHeader) + sizeof(PBZHeader) + tablesize;
+		std::vector<uint64_t> offsets(zheader.chunks + 1, start);
+		std::vector<uint8_t> chunks;
+		std::vector<uint8_t> raw;
+		for (size_t c = 0; c < zheader.chunks; c++) {
+			const size_t y = c * bandrows;
+			const size_t rows = std::min<size_t>(bandrows, m_header.height - y);
+			const RGBAColor* pixels = &(*m_pixels)[y * m_header.width];
+			if (m_header.bitdepth == 32) {
+				lz_compress((const uint8_t*)pixels, rows * rowbytes, chunks);
+			} else {
+				raw.resize(rows * rowbytes);
+				encodePixels(pixels, raw.data(), rows * m_header.width, m_header.bitdepth);
+				lz_compress(raw.data(), raw.size(), chunks);
+			}
+			offsets[c+1] = start + chunks.size();
+		}
 
-				if (m_header.bitdepth == 16) {
-					file.write((char*)&pixel.a, 1);
+		stream.write((const char*)&header, sizeof(header));
+		stream.write((const char*)&zheader, sizeof(zheader));
+		stream.write((const char*)offsets.data(), tablesize);
+		stream.write((const char*)chunks.data(), chunks.size());
+
+		return stream.good() ? 1 : 0;
+	}
+
+	static bool validBitdepth(uint8_t b, uint16_t width)
+	{
+		return (
+			(b == 1 && width%8 == 0) ||
+			b == 8 ||
+			b == 16 ||
+			b == 24 ||
+			b == 32
+		);
+	}
+
+	static bool validHeader(const PBHeader& header)
+	{
+		return header.typep == 0x70 &&
+			header.typeb == 0x62 &&
+			validBitdepth(header.bitdepth, header.width) &&
+			header.end == 0x3A;
+	}
+
+	// Read and check the PBZHeader and chunk offsets that follow the header of a compressed pbf.
+	// data/size may be the whole file or just its beginning, offsets (if not nullptr) needs
+	// room for zheader.chunks + 1 values.
+	static bool readChunkTable(const uint8_t* data, size_t size, const PBHeader& header, PBZHeader& zheader, uint64_t* offsets)
+	{
+		if (size < sizeof(PBHeader) + sizeof(PBZHeader)) { return false; }
+		std::memcpy(&zheader, data + sizeof(PBHeader), sizeof(PBZHeader));
+		if (zheader.bandrows == 0 || zheader.chunks != (header.height + zheader.bandrows - 1u) / zheader.bandrows) {
+			return false;
+		}
+		if (offsets == nullptr) { return true; }
+
+		const size_t tablesize = (zheader.chunks + 1) * sizeof(uint64_t);
+		if (size - sizeof(PBHeader) - sizeof(PBZHeader) < tablesize) { return false; }
+		std::memcpy(offsets, data + sizeof(PBHeader) + sizeof(PBZHeader), tablesize);
+		for (size_t c = 0; c < zheader.chunks; c++) {
+			if (offsets[c] > offsets[c+1]) { return false; }
+		}
+		return offsets[0] >= sizeof(PBHeader) + sizeof(PBZHeader) + tablesize;
+	}
+
+	// number of bytes of pixeldata following the header in a pbf file
+	static size_t payloadSize(uint16_t width, uint16_t height, uint8_t bitdepth)
+	{
+		return (size_t) width * height * bitdepth / 8;
+	}
+
+	// decode numpixels pixels from pbf pixeldata (1, 8, 16, 24 or 32 bits per pixel)
+	static void decodePixels(const uint8_t* src, RGBAColor* dst, size_t numpixels, uint8_t bitdepth)
+	{
+		switch (bitdepth) {
+			case 1:
+				for (size_t i = 0; i < numpixels; i++) {
+					// most significant bit first
+					if ((src[i/8] >> (7 - i%8)) & 1) {
+						dst[i] = RGBAColor(255, 255, 255, 255);
+					} else {
+						dst[i] = RGBAColor(0, 0, 0, 255);
+					}
 				}
-				else if (m_header.bitdepth == 24 || m_header.bitdepth == 32) {
-					file.write((char*)&pixel.r, 1);
-					file.write((char*)&pixel.g, 1);
-					file.write((char*)&pixel.b, 1);
+				break;
+			case 8:
+				for (size_t i = 0; i < numpixels; i++) {
+					dst[i] = RGBAColor(src[i], 255);
 				}
-
-				if (m_header.bitdepth == 32) {
-					file.write((char*)&pixel.a, 1);
+				break;
+			case 16:
+				for (size_t i = 0; i < numpixels; i++) {
+					dst[i] = RGBAColor(src[i*2+0], src[i*2+1]);
 				}
-			}
+				break;
+			case 24:
+				for (size_t i = 0; i < numpixels; i++) {
+					dst[i] = RGBAColor(src[i*3+0], src[i*3+1], src[i*3+2], 255);
+				}
+				break;
+			case 32:
+				std::memcpy((void*)dst, src, numpixels * sizeof(RGBAColor));
+				break;
 		}
+	}
 
-		file.close();
+	// encode numpixels pixels as pbf pixeldata (1, 8, 16, 24 or 32 bits per pixel)
+	static void encodePixels(const RGBAColor* src, uint8_t* dst, size_t numpixels, uint8_t bitdepth)
+	{
+		switch (bitdepth) {
+			case 1:
+				// sets of 8 pixels, most significant bit first
+				for (size_t i = 0; i < numpixels / 8; i++) {
+					uint8_t value = 0;
+					for (size_t v = 0; v < 8; v++) {
+						const RGBAColor& c = src[i*8+v];
+						int avg = (c.r + c.g + c.b) / 3;
+						if (avg >= 128 && c.a >= 128) { value |= (1 << (7-v)); } // white
+					}
+					dst[i] = value;
+				}
+				break;
+			case 8:
+				for (size_t i = 0; i < numpixels; i++) {
+					dst[i] = rt::luminance(src[i]).r;
+				}
+				break;
+			case 16:
+				for (size_t i = 0; i < numpixels; i++) {
+					dst[i*2+0] = rt::luminance(src[i]).r;
+					dst[i*2+1] = src[i].a;
+				}
+				break;
+			case 24:
+				for (size_t i = 0; i < numpixels; i++) {
+					dst[i*3+0] = src[i].r;
+					dst[i*3+1] = src[i].g;
+					dst[i*3+2] = src[i].b;
+				}
+				break;
+			case 32:
+				std::memcpy(dst, (const void*)src, numpixels * sizeof(RGBAColor));
+				break;
+		}
+	}
 
-		return 1;
+	// decode a single pixel from pbf pixeldata
+	static RGBAColor decodePixel(const uint8_t* src, size_t index, uint8_t bitdepth)
+	{
+		if (bitdepth == 1) {
+			if ((src[index/8] >> (7 - index%8)) & 1) { return RGBAColor(255, 255, 255, 255); }
+			return RGBAColor(0, 0, 0, 255);
+		}
+		RGBAColor pixel;
+		decodePixels(&src[index * (bitdepth/8)], &pixel, 1, bitdepth);
+		return pixel;
 	}
 
 	static std::vector<RGBAColor> byte2vec(uint8_t value) {
@@ -319,74 +886,104 @@ public:
 		}
 
 		// Read the file into a bytearray
-		const int size = file.tellg();
-		char* memblock = new char[size];
+		const size_t size = file.tellg();
+		const uint8_t headersize = 18;
+		if (size < headersize) { return 0; }
+		std::vector<uint8_t> memblock(size);
 		file.seekg(0, std::fstream::beg);
-		file.read(memblock, size);
+		file.read((char*)memblock.data(), size);
 		file.close();
 
 		// Read TGA header
-		const uint8_t headersize = 18;
+		const uint8_t idlength = memblock[0];
+		const uint8_t colormaptype = memblock[1];
 		const uint8_t datatype = memblock[2];
-		// const uint16_t x_org   = (memblock[8] & 0xFF) + (memblock[9] << 8);
-		// const uint16_t y_org   = (memblock[10] & 0xFF) + (memblock[11] << 8);
-		const uint16_t width   = (memblock[12] & 0xFF) + (memblock[13] << 8);
-		const uint16_t height  = (memblock[14] & 0xFF) + (memblock[15] << 8);
+		const uint16_t cm_first = memblock[3] + (memblock[4] << 8);
+		const uint16_t cm_length = memblock[5] + (memblock[6] << 8);
+		const uint8_t cm_bitdepth = memblock[7];
+		// const uint16_t x_org   = memblock[8] + (memblock[9] << 8);
+		// const uint16_t y_org   = memblock[10] + (memblock[11] << 8);
+		const uint16_t width   = memblock[12] + (memblock[13] << 8);
+		const uint16_t height  = memblock[14] + (memblock[15] << 8);
 		const uint8_t bitdepth = memblock[16];
 		// screen origin bit
 		// 0 = Origin in lower left-hand corner
 		// 1 = Origin in upper left-hand corner
 		const bool origin_bit = (memblock[17] >> 5) & 1;
 
-		if (datatype > 3) { delete[] memblock; return 0; } // compressed image
-
-		// std::cout << "datatype " << (int) datatype << std::endl;
-		// std::cout << "x_org    " << (int) x_org << std::endl;
-		// std::cout << "y_org    " << (int) y_org << std::endl;
-		// std::cout << "width    " << (int) width << std::endl;
-		// std::cout << "height   " << (int) height << std::endl;
-		// std::cout << "bitdepth " << (int) bitdepth << std::endl;
+		// 1/9 = color-mapped, 2/10 = true-color, 3/11 = grayscale, 9/10/11 run length encoded
+		const bool rle = datatype > 8;
+		const uint8_t type = datatype & 0x07;
+		const bool supported =
+			(type == 1 && bitdepth == 8 && (cm_bitdepth == 24 || cm_bitdepth == 32)) ||
+			(type == 2 && (bitdepth == 24 || bitdepth == 32)) ||
+			(type == 3 && bitdepth == 8);
+		if (!supported || (datatype != type && datatype != type + 8)) { return 0; }
+
+		size_t start = headersize + idlength;
+
+		// Read the color map
+		std::vector<RGBAColor> colormap;
+		if (colormaptype == 1) {
+			const size_t cm_bytes = (cm_bitdepth + 7) / 8;
+			if (start + cm_length * cm_bytes > size) { return 0; }
+			colormap.resize(cm_first + cm_length, RGBAColor(0, 0, 0, 255));
+			for (size_t i = 0; i < cm_length; i++) {
+				const uint8_t* entry = &memblock[start + i * cm_bytes];
+				uint8_t alpha = (cm_bitdepth == 32) ? entry[3] : 255;
+				colormap[cm_first + i] = RGBAColor(entry[2], entry[1], entry[0], alpha); // BGR(A)
+			}
+			start += cm_length * cm_bytes;
+		}
+		if (type == 1 && colormap.size() < 256) { colormap.resize(256, RGBAColor(0, 0, 0, 255)); }
 
 		// Create and build the pixelbuffer
 		m_header.width = width;
 		m_header.height = height;
-		m_header.bitdepth = bitdepth;
+		m_header.bitdepth = (type == 1) ? cm_bitdepth : bitdepth;
+		m_premultiplied = false;
 
-		const size_t numpixels = width * height;
-		m_pixels.clear();
-		m_pixels.reserve(numpixels);
-		for (size_t i = 0; i < numpixels; i++) {
-			m_pixels.emplace_back(RGBAColor(0, 0, 0, 255));
-		}
+		const size_t numpixels = (size_t) width * height;
+		std::vector<RGBAColor>& pixels = _reset(numpixels);
+		std::fill(pixels.begin(), pixels.end(), RGBAColor(0, 0, 0, 255));
+
+		const size_t bpp = bitdepth / 8;
+		auto readColor = [&](const uint8_t* p) -> RGBAColor {
+			if (type == 1) { return colormap[p[0]]; }
+			if (bitdepth == 8) { return RGBAColor(p[0], 255); }
+			if (bitdepth == 24) { return RGBAColor(p[2], p[1], p[0], 255); } // BGR
+			return RGBAColor(p[2], p[1], p[0], p[3]); // BGRA
+		};
 
 		// Place the pixels
-		size_t start = headersize;
-		for (size_t i = 0; i < numpixels; i++) {
-			RGBAColor color;
-			if (bitdepth == 8) {
-				color.r = memblock[start+0];
-				color.g = memblock[start+0];
-				color.b = memblock[start+0];
-				color.a = 255;
-			}
-			if (bitdepth == 24) { // BGR
-				color.r = memblock[start+2];
-				color.g = memblock[start+1];
-				color.b = memblock[start+0];
-				color.a = 255;
+		size_t i = 0;
+		while (i < numpixels) {
+			size_t count = 1;
+			bool repeat = false;
+			if (rle) {
+				if (start >= size) { break; }
+				const uint8_t packet = memblock[start++];
+				count = std::min<size_t>((packet & 0x7F) + 1, numpixels - i);
+				repeat = packet & 0x80;
 			}
-			if (bitdepth == 32) { // BGRA
-				color.r = memblock[start+2];
-				color.g = memblock[start+1];
-				color.b = memblock[start+0];
-				color.a = memblock[start+3];
+			if (repeat) {
+				// run-length packet: 1 color, count times
+				if (start + bpp > size) { break; }
+				RGBAColor color = readColor(&memblock[start]);
+				start += bpp;
+				std::fill_n(&pixels[i], count, color);
+			} else {
+				// raw packet: count colors
+				if (!rle) { count = numpixels - i; }
+				if (start + count * bpp > size) { break; }
+				for (size_t c = 0; c < count; c++) {
+					pixels[i + c] = readColor(&memblock[start]);
+					start += bpp;
+				}
 			}
-			m_pixels[i] = color;
-			start += bitdepth / 8;
+			i += count;
 		}
 
-		delete[] memblock;
-
 		// origin top-left
 		if (!origin_bit) {
 			flipRows();
@@ -396,8 +993,11 @@ public:
 	}
 
 	// http://paulbourke.net/dataformats/tga/
-	int writeTGA(const std::string&  filename)
+	// rle = true writes a run length encoded image (datatype 10)
+	int writeTGA(const std::string& filename, bool rle = false) const
 	{
+		if (m_premultiplied) { return _straight().writeTGA(filename, rle); }
+
 		// Try to write to a file
 		std::ofstream file(filename, std::fstream::out|std::fstream::binary|std::fstream::trunc);
 
@@ -410,10 +1010,12 @@ public:
 		int bd = bitdepth();
 		if (bd == 1 || bd == 8) { bd = 24; }
 		if (bd == 16) { bd = 32; }
+		const bool gray = (bitdepth() == 8 || bitdepth() == 16);
+		const size_t bpp = bd / 8;
 
 		// The image header
 		unsigned char tgaheader[ 18 ] = { 0 };
-		tgaheader[ 2 ] = 2; // true color (grayscale saved as rgb for now)
+		tgaheader[ 2 ] = rle ? 10 : 2; // true color (grayscale saved as rgb for now)
 		// tgaheader[ 10 ] = height() & 0xFF; // y_org low byte
 		// tgaheader[ 11 ] = (height() >> 8) & 0xFF; // y_org high byte
 		tgaheader[ 12 ] = width() & 0xFF;
@@ -426,27 +1028,49 @@ public:
 		// Write header
 		file.write((char*)&tgaheader, sizeof(tgaheader));
 
+		// Convert each row to BGR(A) and write it at once
+		// (rle packets never cross rows, as the tga 2.0 spec requires)
+		std::vector<uint32_t> colors(width());
+		std::vector<uint8_t> row;
+		row.reserve(width() * (bpp + 1));
 		for (int y = 0; y < height(); y++) {
+			const RGBAColor* pixels = &(*m_pixels)[(size_t) y * width()];
 			for (int x = 0; x < width(); x++) {
-				size_t index = rt::index(x, y, width());
-				RGBAColor pixel = m_pixels[index];
-
-				if (bd == 24 || bd == 32) {
-					RGBAColor gray = rt::luminance(m_pixels[index]);
-					if (bitdepth() == 8 || bitdepth() == 16) {
-						file.write((char*)&gray.b, 1);
-						file.write((char*)&gray.g, 1);
-						file.write((char*)&gray.r, 1);
-					} else {
-						file.write((char*)&pixel.b, 1);
-						file.write((char*)&pixel.g, 1);
-						file.write((char*)&pixel.r, 1);
-					}
-					if (bitdepth() == 16 || bitdepth() == 32) {
-						file.write((char*)&pixel.a, 1);
+				RGBAColor pixel = gray ? rt::luminance(pixels[x]) : pixels[x];
+				uint8_t alpha = (bpp == 4) ? pixels[x].a : 0;
+				colors[x] = pixel.b | (pixel.g << 8) | (pixel.r << 16) | ((uint32_t) alpha << 24);
+			}
+
+			row.clear();
+			auto put = [&](uint32_t color) {
+				for (size_t b = 0; b < bpp; b++) { row.push_back((color >> (b * 8)) & 0xFF); }
+			};
+
+			if (!rle) {
+				for (int x = 0; x < width(); x++) { put(colors[x]); }
+			} else {
+				size_t x = 0;
+				const size_t w = width();
+				while (x < w) {
+					// length of the run of equal colors starting at x (max 128)
+					size_t run = 1;
+					while (x + run < w && run < 128 && colors[x + run] == colors[x]) { run++; }
+					if (run > 1) {
+						row.push_back(0x80 | (run - 1));
+						put(colors[x]);
+						x += run;
+						continue;
 					}
+					// raw packet up to the start of the next run (max 128)
+					size_t raw = 1;
+					while (x + raw < w && raw < 128 &&
+						!(x + raw + 1 < w && colors[x + raw] == colors[x + raw + 1])) { raw++; }
+					row.push_back(raw - 1);
+					for (size_t r = 0; r < raw; r++) { put(colors[x + r]); }
+					x += raw;
 				}
 			}
+			file.write((const char*)row.data(), row.size());
 		}
 
 		file.close();
@@ -454,52 +1078,72 @@ public:
 		return 1;
 	}
 
+	// swap the rows in place (top to bottom)
 	void flipRows()
 	{
-		PixelBuffer* duplicate = new PixelBuffer(*this);
-		fill(TRANSPARENT);
-
-		uint16_t rows = height();
-		uint16_t cols = width();
-
-		for (size_t y = 0; y < rows; y++) {
-			for (size_t x = 0; x < cols; x++) {
-				RGBAColor color = duplicate->getPixel(x, rows-y-1);
-				setPixel(x, y, color);
-			}
+		if (!valid()) { return; }
+		const size_t rows = height();
+		const size_t cols = width();
+		std::vector<RGBAColor>& pixels = _pixels();
+
+		for (size_t y = 0; y < rows / 2; y++) {
+			RGBAColor* top = &pixels[y * cols];
+			RGBAColor* bottom = &pixels[(rows - y - 1) * cols];
+			std::swap_ranges(top, top + cols, bottom);
 		}
-		delete duplicate;
 	}
 
 	PixelBuffer copy(uint16_t x, uint16_t y, uint16_t width, uint16_t height) const
 	{
-		PixelBuffer buffer = PixelBuffer(width, height, bitdepth());
+		PixelBuffer buffer;
+		copy(x, y, width, height, buffer);
+		return buffer;
+	}
 
-		size_t maxheight = height + y;
-		size_t maxwidth = width + x;
-		for (size_t ny = y; ny < maxheight; ny++) {
-			for (size_t nx = x; nx < maxwidth; nx++) {
-				RGBAColor pixel = getPixel(nx, ny);
-				buffer.setPixel(nx-x, ny-y, pixel);
-			}
+	// copy into out, reusing its memory when it is large enough
+	// (out may be this buffer: crop in place)
+	void copy(uint16_t x, uint16_t y, uint16_t width, uint16_t height, PixelBuffer& out) const
+	{
+		if (&out == this) {
+			PixelBuffer cropped;
+			copy(x, y, width, height, cropped);
+			out = std::move(cropped);
+			return;
 		}
+		out.m_header = PBHeader();
+		out.m_header.width = width;
+		out.m_header.height = height;
+		out.m_header.bitdepth = bitdepth();
+		out.m_premultiplied = m_premultiplied;
+		std::vector<RGBAColor>& pixels = out._reset((size_t) width * height);
+
+		// the part outside of this buffer is transparent
+		ConstPixelView source = view(x, y, width, height);
+		if (source.width() < width || source.height() < height) {
+			std::fill(pixels.begin(), pixels.end(), TRANSPARENT);
+		}
+		for (size_t r = 0; r < source.height(); r++) {
+			std::copy(source.row(r), source.row(r) + source.width(), &pixels[r * width]);
+		}
+	}
 
-		return buffer;
+	int paste(const PixelBuffer& brush, short pos_x, short pos_y, AlphaSummary alpha = ALPHA_UNKNOWN)
+	{
+		return paste(brush.view(), pos_x, pos_y, alpha);
 	}
 
-	int paste(const PixelBuffer& brush, short pos_x, short pos_y)
+	// paste (a part of) another buffer, blending colors that are not opaque
+	// The brush is clipped once, then pasted a row at a time. Pass
+	// brush.alphaSummary() (computed once) to copy opaque sprites with memcpy
+	// and skip empty ones without looking at their pixels again.
+	int paste(const ConstPixelView& brush, int pos_x, int pos_y, AlphaSummary alpha = ALPHA_UNKNOWN)
 	{
-		size_t height = brush.height();
-		size_t width = brush.width();
-		for (size_t y = 0; y < height; y++) {
-			for (size_t x = 0; x < width; x++) {
-				RGBAColor color = brush.getPixel(x, y);
-				// setPixel handles alpha if we set blend true
-				setPixel(x+pos_x, y+pos_y, color, true);
-			}
-		}
+		return view().paste(brush, pos_x, pos_y, alpha);
+	}
 
-		return 1;
+	AlphaSummary alphaSummary() const
+	{
+		return view().alphaSummary();
 	}
 
 	int setPixel(int x, int y, RGBAColor color, bool blend = false)
@@ -510,14 +1154,18 @@ public:
 		}
 
 		size_t index = (y * m_header.width) + x;
-		if (index >= m_pixels.size()) { // invalid pixels!
+		if (index >= m_pixels->size()) { // invalid pixels!
 			return 0;
 		}
 
-		if (color.a < 255 && blend) {
-			color = rt::alphaBlend(color, getPixel(x, y));
+		RGBAColor& pixel = _pixels()[index];
+		if (m_premultiplied) {
+			color = rt::premultiply(color);
+			if (color.a < 255 && blend) { color = rt::premultipliedBlend(color, pixel); }
+		} else if (color.a < 255 && blend) {
+			color = rt::alphaBlend(color, pixel);
 		}
-		m_pixels[index] = color;
+		pixel = color;
 
 		return 1;
 	}
@@ -530,177 +1178,102 @@ public:
 		}
 
 		size_t index = (y * m_header.width) + x;
-		if (index >= m_pixels.size()) { // invalid pixels!
+		if (index >= m_pixels->size()) { // invalid pixels!
 			return { 0, 0, 0, 0 };
 		}
 
-		return m_pixels[index];
+		return m_premultiplied ? rt::unpremultiply((*m_pixels)[index]) : (*m_pixels)[index];
 	}
 
 	void drawLine(int x0, int y0, int x1, int y1, RGBAColor color)
 	{
-		bool steep = false;
-		if (std::abs(x0-x1) < std::abs(y0-y1)) {
-			std::swap(x0, y0);
-			std::swap(x1, y1);
-			steep = true;
-		}
-		if (x0 > x1) {
-			std::swap(x0, x1);
-			std::swap(y0, y1);
-		}
-		int dx = x1-x0;
-		int dy = y1-y0;
-		int derror2 = std::abs(dy)*2;
-		int error2 = 0;
-		int y = y0;
-
-		for (int x = x0; x <= x1; x++) {
-			if (steep) {
-				setPixel(y, x, color, true);
-			} else {
-				setPixel(x, y, color, true);
-			}
-			error2 += derror2;
-
-			if (error2 > dx) {
-				y += (y1 > y0 ? 1 : -1);
-				error2 -= dx*2;
-			}
-		}
+		view().drawLine(x0, y0, x1, y1, color);
 	}
 
 	void drawSquare(int x, int y, int width, int height, RGBAColor color)
 	{
-		drawLine(x,       y,        x+width, y,        color);
-		drawLine(x+width, y,        x+width, y+height, color);
-		drawLine(x,       y+height, x+width, y+height, color);
-		drawLine(x,       y,        x,       y+height, color);
+		view().drawSquare(x, y, width, height, color);
 	}
 
 	void drawSquareFilled(int x, int y, int width, int height, RGBAColor color)
 	{
-		PixelBuffer pb = PixelBuffer(width, height, m_header.bitdepth);
-		pb.fill(color);
-		paste(pb, x, y);
+		view().drawSquareFilled(x, y, width, height, color);
 	}
 
 	void fill(RGBAColor color)
 	{
-		size_t numpixels = m_header.width * m_header.height;
-		for (size_t i = 0; i < numpixels; i++) {
-			m_pixels[i] = color;
-		}
+		view().fill(color);
 	}
 
 	void drawCircle(int circlex, int circley, int radius, RGBAColor color)
 	{
-		int x = radius;
-		int y = 0;
-		int err = 0;
-
-		std::vector<vec2i> positions;
-
-		while (x >= y) {
-			positions.push_back( {  x,  y } );
-			positions.push_back( {  y,  x } );
-			positions.push_back( { -y,  x } );
-			positions.push_back( { -x,  y } );
-			positions.push_back( { -x, -y } );
-			positions.push_back( { -y, -x } );
-			positions.push_back( {  y, -x } );
-			positions.push_back( {  x, -y } );
-
-			if (err <= 0) {
-				y += 1;
-				err += 2*y + 1;
-			}
-			if (err > 0) {
-				x -= 1;
-				err -= 2*x + 1;
-			}
-		}
-
-		for (auto local : positions) {
-			setPixel(local.x + circlex, local.y + circley, color, true);
-		}
+		view().drawCircle(circlex, circley, radius, color);
 	}
 
 	void drawCircleFilled(int circlex, int circley, int radius, RGBAColor color)
 	{
-		// drawCircle(circlex, circley, radius, color);
-		int size = radius*2;
-		PixelBuffer pb = PixelBuffer(size, size, m_header.bitdepth);
-		pb.drawCircle(size/2, size/2, radius, color);
-		pb.floodFill(size/2, size/2, color);
-		paste(pb, circlex-radius, circley-radius);
+		view().drawCircleFilled(circlex, circley, radius, color);
 	}
 
 	// sharpness 1 = fully blurred
 	// sharpness ..50+ = less blurred
 	void blur(int sharpness = 1)
 	{
-		size_t rows = m_header.height;
-		size_t cols = m_header.width;
-
-		for (size_t y = 0; y < rows; y++) {
-			for (size_t x = 0; x < cols; x++) {
-				// check surrounding colors and average values
-				int totalr = 0; // total red
-				int totalg = 0; // total green
-				int totalb = 0; // total blue
-				int totala = 0; // total alpha
-				for (int r = -1; r < 2; r++) {
-					for (int c = -1; c < 2; c++) {
-						vec2i n = clamp(vec2i(x+c, y+r), cols, rows);
-						RGBAColor color = getPixel(n.x, n.y);
-						if (r==0 && c==0) {
-							totalr += color.r * sharpness;
-							totalg += color.g * sharpness;
-							totalb += color.b * sharpness;
-							totala += color.a * sharpness;
-						} else {
-							totalr += color.r;
-							totalg += color.g;
-							totalb += color.b;
-							totala += color.a;
-						}
-					}
-				}
-				uint8_t r = totalr / (8 + sharpness);
-				uint8_t g = totalg / (8 + sharpness);
-				uint8_t b = totalb / (8 + sharpness);
-				uint8_t a = totala / (8 + sharpness);
-				RGBAColor avg = { r, g, b, a };
-				setPixel(x, y, avg, true);
-			}
-		}
+		view().blur(sharpness);
 	}
 
 	void contrast_8() {
-		// find min + max
-		uint8_t min = 255;
-		uint8_t max = 0;
-		for (size_t i = 0; i < m_pixels.size(); i++) {
-			if (m_pixels[i].r < min) min = m_pixels[i].r;
-			if (m_pixels[i].r > max) max = m_pixels[i].r;
-		}
-
-		// map values
-		for (size_t i = 0; i < m_pixels.size(); i++) {
-			uint8_t readvalue = m_pixels[i].r;
-			uint8_t writevalue = rt::map(readvalue, min, max, 0, 255);
-			m_pixels[i] = {writevalue, writevalue, writevalue, 255};
-		}
+		view().contrast_8();
 	}
 
 	void posterize_8(uint8_t levels) {
-		for (size_t i = 0; i < m_pixels.size(); i++) {
-			uint8_t readvalue = m_pixels[i].r;
-			uint8_t writevalue = rt::map(readvalue, 0, 255, 0, levels);
-			writevalue = rt::map(writevalue, 0, levels, 0, 255);
-			m_pixels[i] = {writevalue, writevalue, writevalue, 255};
+		view().posterize_8(levels);
+	}
+
+	// apply a LUT (a point operation on each channel) to all pixels
+	void apply(const LUT& lut)
+	{
+		view().apply(lut);
+	}
+
+	void contrast()
+	{
+		view().contrast();
+	}
+
+	void posterize(uint8_t levels)
+	{
+		view().posterize(levels);
+	}
+
+	// rotate the hue of every pixel, like rt::rotate() (integer, no floats)
+	void rotateHue(float step)
+	{
+		view().rotateHue(step);
+	}
+
+	// all pixels as (straight alpha) HSVAColors, see rt::toHSVA()
+	void toHSVA(std::vector<HSVAColor>& hsva) const
+	{
+		if (m_premultiplied) { return _straight().toHSVA(hsva); }
+		hsva.resize(m_pixels->size());
+		rt::toHSVA(m_pixels->data(), hsva.data(), hsva.size());
+	}
+
+	// set all pixels from HSVAColors, see rt::fromHSVA()
+	int fromHSVA(const std::vector<HSVAColor>& hsva)
+	{
+		if (hsva.size() != m_pixels->size()) {
+			std::cout << "HSVA size doesn't match the pixelbuffer: " << hsva.size() << std::endl;
+			return 0;
 		}
+		std::vector<RGBAColor>& pixels = _reset(hsva.size());
+		rt::fromHSVA(hsva.data(), pixels.data(), pixels.size());
+		if (m_premultiplied) {
+			m_premultiplied = false;
+			premultiply();
+		}
+		return 1;
 	}
 
 	void floodFill(vec2i pos, RGBAColor fill_color)
@@ -708,23 +1281,63 @@ public:
 		floodFill(pos.x, pos.y, fill_color);
 	}
 
+	// Fill the area of check_color (the color at x, y by default) around x, y.
+	// Only pixels that are not on the edge spread the fill to their neighbours.
+	// Span by span, with a stack of spans instead of recursion. Large or ragged
+	// areas need more than the 256 spans on the call stack: these go in a
+	// temporary ScratchBuffer, or in scratch (no allocations once it has grown).
 	// Warning: hardcoded crazy color in 2 places
 	void floodFill(int x, int y, RGBAColor fill_color, RGBAColor check_color = {242, 13, 248, 1})
 	{
-		int height = m_header.height;
-		int width = m_header.width;
-
-		if (check_color == RGBAColor(242, 13, 248, 1)) { check_color = getPixel(x, y); }
-		std::vector<vec2i> neighbours = { {0,-1}, {1,0}, {0,1}, {-1,0} };
+		ScratchBuffer scratch;
+		floodFill(x, y, fill_color, check_color, scratch);
+	}
 
-		if ((x > 0 && x < width-1) && (y > 0 && y < height-1)) {
-			for (size_t i = 0; i < neighbours.size(); i++) {
-				vec2i npos = vec2i(x, y) + neighbours[i];
-				RGBAColor back_color = getPixel(npos.x, npos.y);
-				if (back_color == check_color) {
-					setPixel(npos.x, npos.y, fill_color, true);
-					floodFill(npos.x, npos.y, fill_color, check_color);
-				}
+	void floodFill(int x, int y, RGBAColor fill_color, RGBAColor check_color, ScratchBuffer& scratch)
+	{
+		const int height = m_header.height;
+		const int width = m_header.width;
+		// a pixel on the edge doesn't spread
+		if (!valid() || x <= 0 || x >= width-1 || y <= 0 || y >= height-1) { return; }
+
+		// compare and fill stored (maybe premultiplied) colors
+		if (check_color == RGBAColor(242, 13, 248, 1)) {
+			check_color = at(x, y);
+		} else if (m_premultiplied) {
+			check_color = rt::premultiply(check_color);
+		}
+		RGBAColor filled = fill_color;
+		if (m_premultiplied) {
+			filled = rt::premultiply(fill_color);
+			if (filled.a < 255) { filled = rt::premultipliedBlend(filled, check_color); }
+		} else if (fill_color.a < 255) {
+			filled = rt::alphaBlend(fill_color, check_color);
+		}
+		// a filled pixel that still has check_color would be filled forever
+		if (filled == check_color) { return; }
+
+		// x, y itself is only filled from a neighbour that spreads
+		const int neighbours[4][2] = { {0,-1}, {1,0}, {0,1}, {-1,0} };
+		bool spreads = false;
+		for (size_t i = 0; i < 4; i++) {
+			const int nx = x + neighbours[i][0];
+			const int ny = y + neighbours[i][1];
+			const bool edge = (nx == 0 || nx == width-1 || ny == 0 || ny == height-1);
+			if (!edge && at(nx, ny) == check_color) { spreads = true; }
+		}
+		FillStack seeds(scratch);
+		if (spreads && at(x, y) == check_color) {
+			_fillSpans(x, y, check_color, filled, seeds);
+			return;
+		}
+		for (size_t i = 0; i < 4; i++) {
+			const int nx = x + neighbours[i][0];
+			const int ny = y + neighbours[i][1];
+			if (at(nx, ny) != check_color) { continue; }
+			if (nx == 0 || nx == width-1 || ny == 0 || ny == height-1) {
+				at(nx, ny) = filled;
+			} else {
+				_fillSpans(nx, ny, check_color, filled, seeds);
 			}
 		}
 	}
@@ -0,0 +1,489 @@
+/**
+ * @file pixelview.h
+ * @brief Non-owning view on (a part of) RGBA pixels: rt::PixelView, rt::ConstPixelView
+ * @see https://github.com/rktrlng/pixelbuffer
+ */
+
+#ifndef PIXELVIEW_H
+#define PIXELVIEW_H
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+
+#include <pixelbuffer/color.h>
+#include <pixelbuffer/blend.h>
+#include <pixelbuffer/hsv.h>
+#include <pixelbuffer/lut.h>
+#include <pixelbuffer/util.h>
+
+namespace rt {
+
+// A view is a pointer to the first pixel, a width, a height and a stride (the
+// distance in pixels from one row to the next). It doesn't own the pixels:
+// a view of a PixelBuffer (PixelBuffer::view()) or of a part of it (sub())
+// draws, pastes and filters in place. It is only valid as long as the pixels are.
+// PixelView_t<const RGBAColor> (ConstPixelView) can only read.
+// A premultiplied() view holds premultiplied alpha pixels (see
+// PixelBuffer::premultiply()): colors passed to the drawing functions and
+// returned by getPixel() are straight alpha, and are converted on the way.
+template <class T>
+class PixelView_t
+{
+private:
+	T* m_data = nullptr;
+	uint16_t m_width = 0;
+	uint16_t m_height = 0;
+	size_t m_stride = 0;
+	bool m_premultiplied = false;
+
+	// a (straight alpha) color as stored in this view
+	RGBAColor _store(RGBAColor color) const { return m_premultiplied ? rt::premultiply(color) : color; }
+
+	// blend a stored color over a stored color
+	RGBAColor _blend(const RGBAColor& top, const RGBAColor& bottom) const
+	{
+		return m_premultiplied ? rt::premultipliedBlend(top, bottom) : rt::alphaBlend(top, bottom);
+	}
+
+	// set pixels [x0, x1] of row y (clipped), blending colors that are not opaque
+	void _span(int x0, int x1, int y, RGBAColor color)
+	{
+		if (y < 0 || y >= m_height) { return; }
+		x0 = std::max(x0, 0);
+		x1 = std::min(x1, m_width - 1);
+		if (x0 > x1) { return; }
+		T* r = row(y);
+		color = _store(color);
+		if (color.a == 255) {
+			std::fill(r + x0, r + x1 + 1, color);
+			return;
+		}
+		if (!m_premultiplied) {
+			rt::blendSpan(r + x0, color, x1 - x0 + 1);
+			return;
+		}
+		for (int x = x0; x <= x1; x++) {
+			r[x] = _blend(color, r[x]);
+		}
+	}
+
+public:
+	PixelView_t() { }
+
+	PixelView_t(T* data, uint16_t width, uint16_t height, size_t stride, bool premultiplied = false) :
+		m_data(data),
+		m_width(width),
+		m_height(height),
+		m_stride(stride),
+		m_premultiplied(premultiplied)
+	{
+		if (m_data == nullptr) { m_width = 0; m_height = 0; }
+	}
+
+	// a PixelView is also a ConstPixelView
+	template <class U>
+	PixelView_t(const PixelView_t<U>& other) :
+		PixelView_t(other.data(), other.width(), other.height(), other.stride(), other.premultiplied())
+	{ }
+
+	T* data() const { return m_data; }
+	uint16_t width() const { return m_width; }
+	uint16_t height() const { return m_height; }
+	size_t stride() const { return m_stride; }
+	bool premultiplied() const { return m_premultiplied; }
+	bool empty() const { return m_width == 0 || m_height == 0; }
+	// the rows follow each other without a gap
+	bool contiguous() const { return m_stride == m_width; }
+
+	// Fast path for loops that clip once and then run over whole rows:
+	// row(y) points to the first of the width() pixels of row y, at(x, y) is
+	// the pixel at x, y. Neither checks bounds.
+	T* row(size_t y) const { return m_data + y * m_stride; }
+	T& at(size_t x, size_t y) const { return m_data[y * m_stride + x]; }
+
+	// ALPHA_OPAQUE, ALPHA_TRANSPARENT or ALPHA_MIXED: look once, paste often
+	AlphaSummary alphaSummary() const
+	{
+		if (contiguous()) { return rt::alphaSummary(m_data, (size_t) m_width * m_height); }
+		AlphaSummary summary = ALPHA_TRANSPARENT;
+		for (size_t y = 0; y < m_height; y++) {
+			const AlphaSummary r = rt::alphaSummary(row(y), m_width);
+			if (r == ALPHA_MIXED || (y > 0 && r != summary)) { return ALPHA_MIXED; }
+			summary = r;
+		}
+		return summary;
+	}
+
+	// Forward iterator over all pixels of the view, row by row. It skips the
+	// gap between the rows, and never points past the end of the last row.
+	class iterator
+	{
+	private:
+		T* m_pixel = nullptr;
+		T* m_rowend = nullptr;
+		size_t m_width = 0;
+		size_t m_gap = 0;  // stride - width
+		size_t m_rows = 0; // rows after this one
+
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef T value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef T* pointer;
+		typedef T& reference;
+
+		iterator() { }
+		iterator(T* pixel, size_t width, size_t gap, size_t rows) :
+			m_pixel(pixel), m_rowend(pixel + width), m_width(width), m_gap(gap), m_rows(rows)
+		{ }
+
+		T& operator*() const { return *m_pixel; }
+		T* operator->() const { return m_pixel; }
+
+		iterator& operator++()
+		{
+			if (++m_pixel == m_rowend && m_rows > 0) {
+				m_pixel += m_gap;
+				m_rowend = m_pixel + m_width;
+				m_rows--;
+			}
+			return *this;
+		}
+		iterator operator++(int) { iterator it = *this; ++(*this); return it; }
+
+		bool operator==(const iterator& other) const { return m_pixel == other.m_pixel; }
+		bool operator!=(const iterator& other) const { return m_pixel != other.m_pixel; }
+	};
+
+	iterator begin() const
+	{
+		if (empty()) { return iterator(); }
+		return iterator(m_data, m_width, m_stride - m_width, m_height - 1);
+	}
+	iterator end() const
+	{
+		if (empty()) { return iterator(); }
+		return iterator(row(m_height - 1) + m_width, 0, m_stride - m_width, 0);
+	}
+
+	bool contains(int x, int y) const { return x >= 0 && x < m_width && y >= 0 && y < m_height; }
+
+	// the part of this view at x, y (clipped to this view)
+	PixelView_t sub(int x, int y, int width, int height) const
+	{
+		const int x0 = std::max(0, x);
+		const int y0 = std::max(0, y);
+		const int x1 = std::min<int>(m_width, x + std::max(0, width));
+		const int y1 = std::min<int>(m_height, y + std::max(0, height));
+		if (x0 >= x1 || y0 >= y1) { return PixelView_t(); }
+		return PixelView_t(&at(x0, y0), x1 - x0, y1 - y0, m_stride, m_premultiplied);
+	}
+
+	RGBAColor getPixel(int x, int y) const
+	{
+		if (!contains(x, y)) { return { 0, 0, 0, 0 }; }
+		return m_premultiplied ? rt::unpremultiply(at(x, y)) : at(x, y);
+	}
+
+	// =========================================================
+	// drawing (PixelView only)
+	// =========================================================
+
+	int setPixel(int x, int y, RGBAColor color, bool blend = false)
+	{
+		if (!contains(x, y)) { return 0; }
+		T& pixel = at(x, y);
+		color = _store(color);
+		if (color.a < 255 && blend) {
+			color = _blend(color, pixel);
+		}
+		pixel = color;
+		return 1;
+	}
+
+	void fill(RGBAColor color)
+	{
+		color = _store(color);
+		for (size_t y = 0; y < m_height; y++) {
+			std::fill(row(y), row(y) + m_width, color);
+		}
+	}
+
+	void drawLine(int x0, int y0, int x1, int y1, RGBAColor color)
+	{
+		bool steep = false;
+		if (std::abs(x0-x1) < std::abs(y0-y1)) {
+			std::swap(x0, y0);
+			std::swap(x1, y1);
+			steep = true;
+		}
+		if (x0 > x1) {
+			std::swap(x0, x1);
+			std::swap(y0, y1);
+		}
+		int dx = x1-x0;
+		int dy = y1-y0;
+		int derror2 = std::abs(dy)*2;
+		int error2 = 0;
+		int y = y0;
+		int run = x0; // a flat line is drawn as spans of pixels on the same row
+
+		for (int x = x0; x <= x1; x++) {
+			if (steep) {
+				setPixel(y, x, color, true);
+			}
+			error2 += derror2;
+
+			if (!steep && (error2 > dx || x == x1)) {
+				_span(run, x, y, color);
+				run = x + 1;
+			}
+			if (error2 > dx) {
+				y += (y1 > y0 ? 1 : -1);
+				error2 -= dx*2;
+			}
+		}
+	}
+
+	void drawSquare(int x, int y, int width, int height, RGBAColor color)
+	{
+		drawLine(x,       y,        x+width, y,        color);
+		drawLine(x+width, y,        x+width, y+height, color);
+		drawLine(x,       y+height, x+width, y+height, color);
+		drawLine(x,       y,        x,       y+height, color);
+	}
+
+	void drawSquareFilled(int x, int y, int width, int height, RGBAColor color)
+	{
+		for (int r = 0; r < height; r++) {
+			_span(x, x + width - 1, y + r, color);
+		}
+	}
+
+	void drawCircle(int circlex, int circley, int radius, RGBAColor color)
+	{
+		int x = radius;
+		int y = 0;
+		int err = 0;
+
+		while (x >= y) {
+			setPixel(circlex + x, circley + y, color, true);
+			setPixel(circlex + y, circley + x, color, true);
+			setPixel(circlex - y, circley + x, color, true);
+			setPixel(circlex - x, circley + y, color, true);
+			setPixel(circlex - x, circley - y, color, true);
+			setPixel(circlex - y, circley - x, color, true);
+			setPixel(circlex + y, circley - x, color, true);
+			setPixel(circlex + x, circley - y, color, true);
+
+			if (err <= 0) {
+				y += 1;
+				err += 2*y + 1;
+			}
+			if (err > 0) {
+				x -= 1;
+				err -= 2*x + 1;
+			}
+		}
+	}
+
+	// one span per row: every row is drawn (and blended) once
+	void drawCircleFilled(int circlex, int circley, int radius, RGBAColor color)
+	{
+		if (radius < 0) { return; }
+		int dx = radius;
+		for (int dy = 0; dy <= radius; dy++) {
+			while (dx * dx + dy * dy > radius * radius + radius) { dx--; }
+			_span(circlex - dx, circlex + dx, circley + dy, color);
+			if (dy > 0) { _span(circlex - dx, circlex + dx, circley - dy, color); }
+		}
+	}
+
+	// paste brush at pos_x, pos_y, blending colors that are not opaque
+	// (converting between straight and premultiplied alpha if needed)
+	// alpha: brush.alphaSummary(), if known. Opaque brushes are copied row by
+	// row, transparent brushes are skipped.
+	int paste(const PixelView_t<const RGBAColor>& brush, int pos_x, int pos_y, AlphaSummary alpha = ALPHA_UNKNOWN)
+	{
+		const bool convert = brush.premultiplied() != m_premultiplied;
+		const int x0 = std::max(0, pos_x);
+		const int y0 = std::max(0, pos_y);
+		const int x1 = std::min<int>(m_width, pos_x + brush.width());
+		const int y1 = std::min<int>(m_height, pos_y + brush.height());
+		if (x0 >= x1 || alpha == ALPHA_TRANSPARENT) { return 1; }
+		if (alpha == ALPHA_OPAQUE) {
+			// opaque colors are the same in straight and premultiplied alpha
+			for (int y = y0; y < y1; y++) {
+				std::memcpy((void*)(row(y) + x0), (const void*)(brush.row(y - pos_y) + (x0 - pos_x)), (x1 - x0) * sizeof(RGBAColor));
+			}
+			return 1;
+		}
+		for (int y = y0; y < y1; y++) {
+			const RGBAColor* src = brush.row(y - pos_y);
+			T* dst = row(y);
+			if (!convert && !m_premultiplied) {
+				rt::blendSpan(dst + x0, src + (x0 - pos_x), x1 - x0);
+				continue;
+			}
+			for (int x = x0; x < x1; x++) {
+				RGBAColor color = src[x - pos_x];
+				if (convert) { color = m_premultiplied ? rt::premultiply(color) : rt::unpremultiply(color); }
+				dst[x] = (color.a < 255) ? _blend(color, dst[x]) : color;
+			}
+		}
+		return 1;
+	}
+
+	// =========================================================
+	// filters (PixelView only)
+	// =========================================================
+
+	// sharpness 1 = fully blurred
+	// sharpness ..50+ = less blurred
+	void blur(int sharpness = 1)
+	{
+		const int rows = m_height;
+		const int cols = m_width;
+
+		for (int y = 0; y < rows; y++) {
+			// edge rows and columns are repeated
+			const T* above = row(std::max(y-1, 0));
+			T* current = row(y);
+			const T* below = row(std::min(y+1, rows-1));
+			for (int x = 0; x < cols; x++) {
+				const int left = std::max(x-1, 0);
+				const int right = std::min(x+1, cols-1);
+				// check surrounding colors and average values
+				int totalr = 0; // total red
+				int totalg = 0; // total green
+				int totalb = 0; // total blue
+				int totala = 0; // total alpha
+				const T* neighbours[3] = { above, current, below };
+				for (int r = 0; r < 3; r++) {
+					const T* n = neighbours[r];
+					const int weight = (r == 1) ? sharpness : 1;
+					totalr += n[left].r + n[x].r * weight + n[right].r;
+					totalg += n[left].g + n[x].g * weight + n[right].g;
+					totalb += n[left].b + n[x].b * weight + n[right].b;
+					totala += n[left].a + n[x].a * weight + n[right].a;
+				}
+				uint8_t r = totalr / (8 + sharpness);
+				uint8_t g = totalg / (8 + sharpness);
+				uint8_t b = totalb / (8 + sharpness);
+				uint8_t a = totala / (8 + sharpness);
+				RGBAColor avg = { r, g, b, a };
+				current[x] = (a < 255) ? _blend(avg, current[x]) : avg;
+			}
+		}
+	}
+
+	void contrast_8()
+	{
+		// find min + max
+		uint8_t min = 255;
+		uint8_t max = 0;
+		for (size_t y = 0; y < m_height; y++) {
+			const T* r = row(y);
+			for (size_t x = 0; x < m_width; x++) {
+				if (r[x].r < min) min = r[x].r;
+				if (r[x].r > max) max = r[x].r;
+			}
+		}
+
+		// map values
+		_grayFromRed(LUT::stretch(min, max).table(LUT::R));
+	}
+
+	void posterize_8(uint8_t levels)
+	{
+		_grayFromRed(LUT::posterize(levels).table(LUT::R));
+	}
+
+	// apply a LUT to all pixels (in straight alpha)
+	void apply(const LUT& lut)
+	{
+		for (size_t y = 0; y < m_height; y++) {
+			T* r = row(y);
+			if (!m_premultiplied) {
+				lut.apply(r, m_width);
+				continue;
+			}
+			for (size_t x = 0; x < m_width; x++) {
+				r[x] = rt::premultiply(lut(rt::unpremultiply(r[x])));
+			}
+		}
+	}
+
+	// stretch each of R, G and B to 0-255 (contrast_8 on every channel)
+	// a channel with a single value is left as it is
+	void contrast()
+	{
+		uint8_t min[3] = { 255, 255, 255 };
+		uint8_t max[3] = { 0, 0, 0 };
+		for (size_t y = 0; y < m_height; y++) {
+			const T* r = row(y);
+			for (size_t x = 0; x < m_width; x++) {
+				const RGBAColor color = m_premultiplied ? rt::unpremultiply(r[x]) : r[x];
+				min[0] = std::min(min[0], color.r); max[0] = std::max(max[0], color.r);
+				min[1] = std::min(min[1], color.g); max[1] = std::max(max[1], color.g);
+				min[2] = std::min(min[2], color.b); max[2] = std::max(max[2], color.b);
+			}
+		}
+		LUT lut;
+		const LUT::Channel channels[3] = { LUT::R, LUT::G, LUT::B };
+		for (int c = 0; c < 3; c++) {
+			if (max[c] <= min[c]) { continue; }
+			std::memcpy(lut.table(channels[c]), LUT::stretch(min[c], max[c]).table(channels[c]), 256);
+		}
+		apply(lut);
+	}
+
+	// levels + 1 values for each of R, G and B (posterize_8 on every channel)
+	void posterize(uint8_t levels)
+	{
+		apply(LUT::posterize(levels));
+	}
+
+	// rotate the hue of all pixels (see rt::rotateHue()), a row at a time
+	// Hue doesn't change when r, g and b are scaled by alpha, so premultiplied
+	// pixels are rotated as they are.
+	void rotateHue(float step)
+	{
+		for (size_t y = 0; y < m_height; y++) {
+			rt::rotateHue(row(y), m_width, step);
+		}
+	}
+
+private:
+	// r = g = b = table[r], a = 255
+	void _grayFromRed(const uint8_t* table)
+	{
+		for (size_t y = 0; y < m_height; y++) {
+			T* r = row(y);
+			for (size_t x = 0; x < m_width; x++) {
+				const uint8_t value = table[r[x].r];
+				r[x] = {value, value, value, 255};
+			}
+		}
+	}
+};
+
+typedef PixelView_t<RGBAColor> PixelView;
+typedef PixelView_t<const RGBAColor> ConstPixelView;
+
+// blend src over dst (a view of the destination rectangle), top left aligned
+// and clipped to the smaller of the two. Straight alpha rows go through
+// rt::blendSpan().
+inline int blend(const ConstPixelView& src, PixelView dst, AlphaSummary alpha = ALPHA_UNKNOWN)
+{
+	return dst.paste(src, 0, 0, alpha);
+}
+
+} // namespace rt
+
+#endif // PIXELVIEW_H
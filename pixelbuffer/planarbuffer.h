@@ -0,0 +1,328 @@
+/**
+ * @file planarbuffer.h
+ * @brief R, G, B and A planes with 64 byte aligned rows: rt::PlanarBuffer
+ * @see https://github.com/rktrlng/pixelbuffer
+ */
+
+#ifndef PLANARBUFFER_H
+#define PLANARBUFFER_H
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+	#include <emmintrin.h>
+	#define PLANARBUFFER_SSE2
+#endif
+
+#include <pixelbuffer/color.h>
+#include <pixelbuffer/pixelbuffer.h>
+
+namespace rt {
+
+// Structure of arrays: each channel is a plane of its own. Every row of every
+// plane starts at a 64 byte boundary and is padded to stride() bytes, so
+// filters are plain loops over uint8_t rows that the compiler can vectorize.
+class PlanarBuffer
+{
+public:
+	enum Channel { R = 0, G = 1, B = 2, A = 3 };
+	static const size_t ALIGNMENT = 64;
+
+private:
+	uint16_t m_width = 0;
+	uint16_t m_height = 0;
+	size_t m_stride = 0;
+	size_t m_planesize = 0;
+	std::vector<uint8_t> m_storage;
+	uint8_t* m_base = nullptr; // first aligned byte in m_storage
+
+	void _init(uint16_t width, uint16_t height)
+	{
+		m_width = width;
+		m_height = height;
+		m_stride = (width + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+		m_planesize = m_stride * height;
+		m_storage.assign(m_planesize * 4 + ALIGNMENT, 0);
+		const uintptr_t address = (uintptr_t) m_storage.data();
+		m_base = m_storage.data() + (ALIGNMENT - address % ALIGNMENT) % ALIGNMENT;
+	}
+
+	// floor(n / d) for the n and d used by the filters: (n + 0.5) / d is at
+	// least 0.5/d away from a whole number, well above the float error.
+	static inline uint8_t _div(uint32_t n, float inv) { return (uint8_t) ((n + 0.5f) * inv); }
+
+public:
+	PlanarBuffer() { }
+
+	PlanarBuffer(uint16_t width, uint16_t height, RGBAColor color = TRANSPARENT)
+	{
+		_init(width, height);
+		fill(color);
+	}
+
+	explicit PlanarBuffer(const PixelBuffer& pb)
+	{
+		fromPixelBuffer(pb);
+	}
+
+	PlanarBuffer(const PlanarBuffer& other)
+	{
+		*this = other;
+	}
+
+	PlanarBuffer& operator=(const PlanarBuffer& other)
+	{
+		if (this == &other) { return *this; }
+		_init(other.m_width, other.m_height);
+		if (m_planesize > 0) { std::memcpy(m_base, other.m_base, m_planesize * 4); }
+		return *this;
+	}
+
+	// moving the storage keeps its address, and so the alignment
+	PlanarBuffer(PlanarBuffer&& other)
+	{
+		*this = std::move(other);
+	}
+
+	PlanarBuffer& operator=(PlanarBuffer&& other)
+	{
+		if (this == &other) { return *this; }
+		m_width = other.m_width;
+		m_height = other.m_height;
+		m_stride = other.m_stride;
+		m_planesize = other.m_planesize;
+		m_storage = std::move(other.m_storage);
+		m_base = other.m_base;
+		other.m_width = 0;
+		other.m_height = 0;
+		other.m_stride = 0;
+		other.m_planesize = 0;
+		other.m_storage.clear();
+		other.m_base = nullptr;
+		return *this;
+	}
+
+	uint16_t width() const { return m_width; }
+	uint16_t height() const { return m_height; }
+	// distance in bytes between the rows of a plane (a multiple of 64)
+	size_t stride() const { return m_stride; }
+
+	uint8_t* plane(int channel) { return m_base + channel * m_planesize; }
+	const uint8_t* plane(int channel) const { return m_base + channel * m_planesize; }
+	uint8_t* row(int channel, size_t y) { return plane(channel) + y * m_stride; }
+	const uint8_t* row(int channel, size_t y) const { return plane(channel) + y * m_stride; }
+
+	bool valid() const { return m_base != nullptr && m_width > 0 && m_height > 0; }
+
+	int setPixel(int x, int y, RGBAColor color)
+	{
+		if ( (x < 0) || (x >= m_width) || (y < 0) || (y >= m_height) ) {
+			return 0;
+		}
+		for (int c = 0; c < 4; c++) { row(c, y)[x] = color[c]; }
+		return 1;
+	}
+
+	RGBAColor getPixel(int x, int y) const
+	{
+		if ( (x < 0) || (x >= m_width) || (y < 0) || (y >= m_height) ) {
+			return { 0, 0, 0, 0 };
+		}
+		return RGBAColor(row(R, y)[x], row(G, y)[x], row(B, y)[x], row(A, y)[x]);
+	}
+
+	void fill(RGBAColor color)
+	{
+		for (int c = 0; c < 4; c++) {
+			std::memset(plane(c), color[c], m_planesize);
+		}
+	}
+
+	// =========================================================
+	// conversion
+	// =========================================================
+
+	// split the RGBA pixels of pb into planes (in straight alpha)
+	int fromPixelBuffer(const PixelBuffer& pb)
+	{
+		if (pb.premultiplied()) {
+			PixelBuffer straight = pb;
+			straight.unpremultiply();
+			return fromPixelBuffer(straight);
+		}
+		_init(pb.width(), pb.height());
+		for (size_t y = 0; y < m_height; y++) {
+			deinterleave(&pb.pixels()[y * m_width], row(R, y), row(G, y), row(B, y), row(A, y), m_width);
+		}
+		return 1;
+	}
+
+	// combine the planes into RGBA pixels (the bitdepth of pb is kept when it has the same size)
+	void toPixelBuffer(PixelBuffer& pb) const
+	{
+		if (pb.width() != m_width || pb.height() != m_height || pb.premultiplied()) {
+			pb = PixelBuffer(m_width, m_height, 32);
+		}
+		for (size_t y = 0; y < m_height; y++) {
+			interleave(row(R, y), row(G, y), row(B, y), row(A, y), &pb.pixels()[y * m_width], m_width);
+		}
+	}
+
+	PixelBuffer toPixelBuffer() const
+	{
+		PixelBuffer pb(m_width, m_height, 32);
+		toPixelBuffer(pb);
+		return pb;
+	}
+
+	static void deinterleave(const RGBAColor* src, uint8_t* r, uint8_t* g, uint8_t* b, uint8_t* a, size_t numpixels)
+	{
+		size_t i = 0;
+#ifdef PLANARBUFFER_SSE2
+		// 16 pixels at a time: mask out each byte of the 32 bit pixels and pack them down to bytes
+		const __m128i mask = _mm_set1_epi32(0xFF);
+		for (; i + 16 <= numpixels; i += 16) {
+			__m128i v[4];
+			for (int k = 0; k < 4; k++) { v[k] = _mm_loadu_si128((const __m128i*)&src[i + k * 4]); }
+			uint8_t* dst[4] = { r, g, b, a };
+			for (int c = 0; c < 4; c++) {
+				__m128i lo = _mm_packs_epi32(_mm_and_si128(v[0], mask), _mm_and_si128(v[1], mask));
+				__m128i hi = _mm_packs_epi32(_mm_and_si128(v[2], mask), _mm_and_si128(v[3], mask));
+				_mm_storeu_si128((__m128i*)&dst[c][i], _mm_packus_epi16(lo, hi));
+				for (int k = 0; k < 4; k++) { v[k] = _mm_srli_epi32(v[k], 8); }
+			}
+		}
+#endif
+		for (; i < numpixels; i++) {
+			r[i] = src[i].r;
+			g[i] = src[i].g;
+			b[i] = src[i].b;
+			a[i] = src[i].a;
+		}
+	}
+
+	static void interleave(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* a, RGBAColor* dst, size_t numpixels)
+	{
+		size_t i = 0;
+#ifdef PLANARBUFFER_SSE2
+		// 16 pixels at a time: rg and ba byte pairs, then rgba
+		for (; i + 16 <= numpixels; i += 16) {
+			__m128i vr = _mm_loadu_si128((const __m128i*)&r[i]);
+			__m128i vg = _mm_loadu_si128((const __m128i*)&g[i]);
+			__m128i vb = _mm_loadu_si128((const __m128i*)&b[i]);
+			__m128i va = _mm_loadu_si128((const __m128i*)&a[i]);
+			__m128i rg_lo = _mm_unpacklo_epi8(vr, vg);
+			__m128i rg_hi = _mm_unpackhi_epi8(vr, vg);
+			__m128i ba_lo = _mm_unpacklo_epi8(vb, va);
+			__m128i ba_hi = _mm_unpackhi_epi8(vb, va);
+			_mm_storeu_si128((__m128i*)&dst[i +  0], _mm_unpacklo_epi16(rg_lo, ba_lo));
+			_mm_storeu_si128((__m128i*)&dst[i +  4], _mm_unpackhi_epi16(rg_lo, ba_lo));
+			_mm_storeu_si128((__m128i*)&dst[i +  8], _mm_unpacklo_epi16(rg_hi, ba_hi));
+			_mm_storeu_si128((__m128i*)&dst[i + 12], _mm_unpackhi_epi16(rg_hi, ba_hi));
+		}
+#endif
+		for (; i < numpixels; i++) {
+			dst[i] = RGBAColor(r[i], g[i], b[i], a[i]);
+		}
+	}
+
+	// =========================================================
+	// filters
+	// =========================================================
+
+	// 3x3 box blur of every plane, the center weighs sharpness
+	// sharpness 1 = fully blurred
+	// sharpness ..50+ = less blurred
+	// Unlike PixelBuffer::blur, all pixels are blurred from the original image.
+	void blur(int sharpness = 1)
+	{
+		if (!valid() || sharpness < 0) { return; }
+		const float inv = 1.0f / (8 + sharpness);
+		const int w = m_width;
+		std::vector<uint16_t> sums(w + 2);
+		std::vector<uint8_t> source(m_stride * 3); // this, previous and next row of the original
+
+		for (int c = 0; c < 4; c++) {
+			uint8_t* previous = &source[0];
+			uint8_t* current = &source[m_stride];
+			uint8_t* next = &source[m_stride * 2];
+			std::memcpy(previous, row(c, 0), w);
+			std::memcpy(current, row(c, 0), w);
+
+			for (int y = 0; y < m_height; y++) {
+				std::memcpy(next, row(c, std::min(y + 1, m_height - 1)), w);
+
+				// vertical sums, with the edge columns repeated
+				for (int x = 0; x < w; x++) {
+					sums[x + 1] = previous[x] + current[x] + next[x];
+				}
+				sums[0] = sums[1];
+				sums[w + 1] = sums[w];
+
+				uint8_t* dst = row(c, y);
+				for (int x = 0; x < w; x++) {
+					uint32_t total = sums[x] + sums[x + 1] + sums[x + 2] + current[x] * (sharpness - 1);
+					dst[x] = _div(total, inv);
+				}
+
+				std::swap(previous, current);
+				std::swap(current, next);
+			}
+		}
+	}
+
+	// stretch the red plane to 0-255 and write it as opaque gray (like PixelBuffer::contrast_8)
+	void contrast_8()
+	{
+		if (!valid()) { return; }
+		uint8_t min = 255;
+		uint8_t max = 0;
+		for (size_t y = 0; y < m_height; y++) {
+			const uint8_t* r = row(R, y);
+			for (size_t x = 0; x < m_width; x++) {
+				min = std::min(min, r[x]);
+				max = std::max(max, r[x]);
+			}
+		}
+
+		const float inv = (max > min) ? 1.0f / (max - min) : 0.0f;
+		for (size_t y = 0; y < m_height; y++) {
+			uint8_t* r = row(R, y);
+			for (size_t x = 0; x < m_width; x++) {
+				r[x] = _div((r[x] - min) * 255u, inv);
+			}
+		}
+		_grayFromRed();
+	}
+
+	// reduce the red plane to levels + 1 values and write it as opaque gray (like PixelBuffer::posterize_8)
+	void posterize_8(uint8_t levels)
+	{
+		if (!valid() || levels == 0) { return; }
+		const float inv255 = 1.0f / 255;
+		const float invlevels = 1.0f / levels;
+		for (size_t y = 0; y < m_height; y++) {
+			uint8_t* r = row(R, y);
+			for (size_t x = 0; x < m_width; x++) {
+				uint8_t level = _div(r[x] * (uint32_t) levels, inv255);
+				r[x] = _div(level * 255u, invlevels);
+			}
+		}
+		_grayFromRed();
+	}
+
+private:
+	void _grayFromRed()
+	{
+		std::memcpy(plane(G), plane(R), m_planesize);
+		std::memcpy(plane(B), plane(R), m_planesize);
+		std::memset(plane(A), 255, m_planesize);
+	}
+};
+
+} // namespace rt
+
+#endif // PLANARBUFFER_H
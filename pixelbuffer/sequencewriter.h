@@ -0,0 +1,113 @@
+/**
+ * @file sequencewriter.h
+ * @brief Write numbered pbf frames on a background thread: rt::SequenceWriter
+ * @see https://github.com/rktrlng/pixelbuffer
+ */
+
+#ifndef SEQUENCEWRITER_H
+#define SEQUENCEWRITER_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+#include <pixelbuffer/pixelbuffer.h>
+#include <pixelbuffer/workqueue.h>
+
+namespace rt {
+
+// Frames are copied into one of a fixed number of slots and written to
+// prefix0000.pbf, prefix0001.pbf, ... (see PixelBuffer::createFilename) by a
+// background thread. When all slots are waiting for the disk, write() blocks
+// until one is free, so a render loop can never run away from the disk.
+class SequenceWriter
+{
+private:
+	struct Job {
+		PixelBuffer* frame;
+		std::string filename;
+	};
+
+	std::string m_prefix;
+	uint32_t m_counter;
+	uint8_t m_leading0;
+	bool m_compressed;
+
+	std::vector<PixelBuffer> m_slots;
+	BoundedQueue<PixelBuffer*> m_free;
+	BoundedQueue<Job> m_jobs;
+	std::atomic<size_t> m_written{0};
+	std::atomic<size_t> m_failed{0};
+	std::thread m_thread;
+	bool m_closed = false;
+	ScratchBuffer m_scratch; // only used by the background thread
+
+	void _run()
+	{
+		Job job;
+		while (m_jobs.pop(job)) {
+			int ok = m_compressed ? job.frame->writeCompressed(job.filename) : job.frame->write(job.filename, m_scratch);
+			if (ok) { m_written++; } else { m_failed++; }
+			m_free.push(job.frame);
+		}
+	}
+
+public:
+	// slots: number of frames that can be in flight (2 = double buffered)
+	SequenceWriter(const std::string& prefix, uint32_t counter = 0, size_t slots = 2, uint8_t leading0 = 4, bool compressed = false) :
+		m_prefix(prefix),
+		m_counter(counter),
+		m_leading0(leading0),
+		m_compressed(compressed),
+		m_slots(slots > 0 ? slots : 1),
+		m_free(m_slots.size()),
+		m_jobs(m_slots.size())
+	{
+		for (auto& slot : m_slots) {
+			m_free.push(&slot);
+		}
+		m_thread = std::thread(&SequenceWriter::_run, this);
+	}
+
+	~SequenceWriter()
+	{
+		close();
+	}
+
+	SequenceWriter(const SequenceWriter& other) = delete;
+	SequenceWriter& operator=(const SequenceWriter& other) = delete;
+
+	// Queue a copy of the frame for writing and return its filename.
+	// Blocks while all slots are in use.
+	std::string write(const PixelBuffer& frame)
+	{
+		if (m_closed) { return ""; }
+
+		PixelBuffer* slot = nullptr;
+		m_free.pop(slot);
+		*slot = frame; // reuses the memory of the slot
+
+		std::string filename = frame.createFilename(m_prefix, m_counter++, m_leading0);
+		m_jobs.push( { slot, filename } );
+		return filename;
+	}
+
+	// Write all queued frames and stop the background thread.
+	void close()
+	{
+		if (m_closed) { return; }
+		m_closed = true;
+		m_jobs.close();
+		m_thread.join();
+		m_free.close();
+	}
+
+	uint32_t counter() const { return m_counter; }
+	size_t written() const { return m_written; }
+	size_t failed() const { return m_failed; }
+};
+
+} // namespace rt
+
+#endif // SEQUENCEWRITER_H
@@ -0,0 +1,512 @@
+/**
+ * @file sparsecanvas.h
+ * @brief Very large canvas of lazily allocated 256x256 tiles: rt::SparseCanvas
+ * @see https://github.com/rktrlng/pixelbuffer
+ */
+
+#ifndef SPARSECANVAS_H
+#define SPARSECANVAS_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include <pixelbuffer/color.h>
+#include <pixelbuffer/blend.h>
+#include <pixelbuffer/pixelbuffer.h>
+#include <pixelbuffer/pbfcontainer.h>
+
+namespace rt {
+
+// A canvas of up to 2^31 x 2^31 pixels, with 32 bit coordinates. Tiles of
+// 256x256 pixels are allocated on the first write that changes them (drawing
+// the background color or pasting transparent pixels allocates nothing); a
+// tile that was never written to is the background color. Memory use is proportional to
+// the area that was drawn on, not to the size of the canvas.
+//
+// A canvas is written as a pba container (see pbfcontainer.h):
+//   frame 0: PBHeader (end = 0x74 't') + PBTHeader + tiles x { uint32_t tx, uint32_t ty }
+//   frame 1..tiles: the tiles, in the same order, as (compressed) pbf
+//   (clipped at the right and bottom edge of the canvas)
+
+const uint8_t PBF_TILEMAP = 0x74; // PBHeader end marker of a tile map: 0x74 = 't'
+
+struct PBTHeader {
+	uint32_t width = 0;        // 4 bytes: canvas width
+	uint32_t height = 0;       // 4 bytes: canvas height
+	uint16_t tilesize = 256;   // 2 bytes: tile width and height
+	uint16_t reserved = 0;     // 2 bytes
+	uint32_t tiles = 0;        // 4 bytes: number of tiles in the file
+	uint32_t background = 0;   // 4 bytes: RGBA color of the tiles that are not in the file
+	uint32_t reserved2 = 0;    // 4 bytes
+};                             // sizeof(PBTHeader) = 24 bytes
+
+class SparseCanvas
+{
+public:
+	static const int TILE_SHIFT = 8;
+	static const int TILE = 1 << TILE_SHIFT;          // tile width and height
+	static const int TILE_MASK = TILE - 1;
+	static const size_t TILE_PIXELS = TILE * TILE;
+
+private:
+	uint32_t m_width = 0;
+	uint32_t m_height = 0;
+	RGBAColor m_background = TRANSPARENT;
+	std::unordered_map<uint64_t, std::vector<RGBAColor>> m_tiles;
+	// the tile that was used last (tiles are never moved in memory until clear())
+	uint64_t m_lastkey = UINT64_MAX;
+	RGBAColor* m_lasttile = nullptr;
+
+	static uint64_t _key(uint32_t tx, uint32_t ty) { return ((uint64_t) ty << 32) | tx; }
+
+	// the pixels of tile tx, ty, or nullptr if it has not been allocated
+	RGBAColor* _find(uint32_t tx, uint32_t ty)
+	{
+		const uint64_t key = _key(tx, ty);
+		if (key == m_lastkey) { return m_lasttile; }
+		auto it = m_tiles.find(key);
+		if (it == m_tiles.end()) { return nullptr; }
+		m_lastkey = key;
+		m_lasttile = it->second.data();
+		return m_lasttile;
+	}
+
+	// the pixels of tile tx, ty, allocated (as background) if needed
+	RGBAColor* _allocate(uint32_t tx, uint32_t ty)
+	{
+		RGBAColor* tile = _find(tx, ty);
+		if (tile != nullptr) { return tile; }
+		std::vector<RGBAColor>& pixels = m_tiles[_key(tx, ty)];
+		pixels.assign(TILE_PIXELS, m_background);
+		m_lastkey = _key(tx, ty);
+		m_lasttile = pixels.data();
+		return m_lasttile;
+	}
+
+	// set pixels [x0, x1] of row y (clipped), blending colors that are not opaque
+	void _span(int64_t x0, int64_t x1, int64_t y, RGBAColor color)
+	{
+		if (y < 0 || y >= m_height) { return; }
+		x0 = std::max<int64_t>(x0, 0);
+		x1 = std::min<int64_t>(x1, (int64_t) m_width - 1);
+		// the color of the pixels of a tile that was never written to
+		const RGBAColor onbackground = (color.a < 255) ? rt::alphaBlend(color, m_background) : color;
+		const uint32_t ty = y >> TILE_SHIFT;
+		const size_t offset = (y & TILE_MASK) * TILE;
+
+		while (x0 <= x1) {
+			const uint32_t tx = x0 >> TILE_SHIFT;
+			const int64_t end = std::min<int64_t>(x1, ((int64_t) tx << TILE_SHIFT) + TILE_MASK);
+			RGBAColor* tile = _find(tx, ty);
+			if (tile == nullptr && onbackground == m_background) { x0 = end + 1; continue; }
+			if (tile == nullptr) { tile = _allocate(tx, ty); }
+			RGBAColor* row = tile + offset;
+			if (color.a == 255) {
+				std::fill(row + (x0 & TILE_MASK), row + (end & TILE_MASK) + 1, color);
+			} else {
+				rt::blendSpan(row + (x0 & TILE_MASK), color, end - x0 + 1);
+			}
+			x0 = end + 1;
+		}
+	}
+
+	// setPixel with 64 bit coordinates, for drawing beyond the 32 bit range
+	int _plot(int64_t x, int64_t y, RGBAColor color, bool blend)
+	{
+		if (!contains(x, y)) { return 0; }
+		if (blend) {
+			_span(x, x, y, color);
+			return 1;
+		}
+		RGBAColor* tile = _find(x >> TILE_SHIFT, y >> TILE_SHIFT);
+		if (tile == nullptr) {
+			if (color == m_background) { return 1; }
+			tile = _allocate(x >> TILE_SHIFT, y >> TILE_SHIFT);
+		}
+		tile[(y & TILE_MASK) * TILE + (x & TILE_MASK)] = color;
+		return 1;
+	}
+
+public:
+	SparseCanvas() { }
+
+	SparseCanvas(uint32_t width, uint32_t height, RGBAColor background = TRANSPARENT)
+	{
+		create(width, height, background);
+	}
+
+	SparseCanvas(const std::string& filename)
+	{
+		read(filename);
+	}
+
+	// copies get their own tiles
+	SparseCanvas(const SparseCanvas& other) :
+		m_width(other.m_width),
+		m_height(other.m_height),
+		m_background(other.m_background),
+		m_tiles(other.m_tiles)
+	{ }
+
+	SparseCanvas& operator=(const SparseCanvas& other)
+	{
+		if (this == &other) { return *this; }
+		m_width = other.m_width;
+		m_height = other.m_height;
+		m_background = other.m_background;
+		m_tiles = other.m_tiles;
+		m_lastkey = UINT64_MAX;
+		m_lasttile = nullptr;
+		return *this;
+	}
+
+	// width and height up to 2^31 (drawing uses 32 bit signed coordinates)
+	void create(uint32_t width, uint32_t height, RGBAColor background = TRANSPARENT)
+	{
+		m_width = std::min<uint32_t>(width, INT32_MAX);
+		m_height = std::min<uint32_t>(height, INT32_MAX);
+		m_background = background;
+		clear();
+	}
+
+	// free all tiles: the whole canvas is background again
+	void clear()
+	{
+		m_tiles.clear();
+		m_lastkey = UINT64_MAX;
+		m_lasttile = nullptr;
+	}
+
+	uint32_t width() const { return m_width; }
+	uint32_t height() const { return m_height; }
+	RGBAColor background() const { return m_background; }
+	uint32_t tilesX() const { return (uint32_t) (((uint64_t) m_width + TILE - 1) / TILE); }
+	uint32_t tilesY() const { return (uint32_t) (((uint64_t) m_height + TILE - 1) / TILE); }
+
+	// number of allocated tiles
+	size_t tiles() const { return m_tiles.size(); }
+	// bytes of pixels in allocated tiles
+	size_t memoryUsage() const { return m_tiles.size() * TILE_PIXELS * sizeof(RGBAColor); }
+
+	// the positions (tx, ty) of all allocated tiles, sorted by row
+	std::vector<std::pair<uint32_t, uint32_t>> tileList() const
+	{
+		std::vector<uint64_t> keys;
+		keys.reserve(m_tiles.size());
+		for (const auto& tile : m_tiles) { keys.push_back(tile.first); }
+		std::sort(keys.begin(), keys.end());
+		std::vector<std::pair<uint32_t, uint32_t>> list;
+		list.reserve(keys.size());
+		for (uint64_t key : keys) { list.push_back(std::make_pair((uint32_t) key, (uint32_t) (key >> 32))); }
+		return list;
+	}
+
+	// the TILE x TILE pixels of tile tx, ty (row major), nullptr if it's all background
+	const RGBAColor* tile(uint32_t tx, uint32_t ty) const
+	{
+		auto it = m_tiles.find(_key(tx, ty));
+		return (it == m_tiles.end()) ? nullptr : it->second.data();
+	}
+
+	// tile tx, ty (allocated if needed), clipped to the canvas, to draw on in place
+	PixelView tileView(uint32_t tx, uint32_t ty)
+	{
+		if (tx >= tilesX() || ty >= tilesY()) { return PixelView(); }
+		const uint32_t w = std::min<uint64_t>(TILE, m_width - ((uint64_t) tx << TILE_SHIFT));
+		const uint32_t h = std::min<uint64_t>(TILE, m_height - ((uint64_t) ty << TILE_SHIFT));
+		return PixelView(_allocate(tx, ty), w, h, TILE);
+	}
+
+	bool contains(int64_t x, int64_t y) const { return x >= 0 && x < m_width && y >= 0 && y < m_height; }
+
+	int setPixel(int32_t x, int32_t y, RGBAColor color, bool blend = false)
+	{
+		return _plot(x, y, color, blend);
+	}
+
+	RGBAColor getPixel(int32_t x, int32_t y) const
+	{
+		if (!contains(x, y)) { return { 0, 0, 0, 0 }; }
+		const RGBAColor* pixels = tile(x >> TILE_SHIFT, y >> TILE_SHIFT);
+		if (pixels == nullptr) { return m_background; }
+		return pixels[(y & TILE_MASK) * TILE + (x & TILE_MASK)];
+	}
+
+	// =========================================================
+	// drawing
+	// =========================================================
+
+	void drawLine(int32_t x0, int32_t y0, int32_t x1, int32_t y1, RGBAColor color)
+	{
+		// 64 bit error terms: the distances can be up to 2^32
+		int64_t ax0 = x0, ay0 = y0, ax1 = x1, ay1 = y1;
+		bool steep = false;
+		if (std::abs(ax0-ax1) < std::abs(ay0-ay1)) {
+			std::swap(ax0, ay0);
+			std::swap(ax1, ay1);
+			steep = true;
+		}
+		if (ax0 > ax1) {
+			std::swap(ax0, ax1);
+			std::swap(ay0, ay1);
+		}
+		int64_t dx = ax1-ax0;
+		int64_t dy = ay1-ay0;
+		int64_t derror2 = std::abs(dy)*2;
+		int64_t error2 = 0;
+		int64_t y = ay0;
+
+		for (int64_t x = ax0; x <= ax1; x++) {
+			if (steep) {
+				_plot(y, x, color, true);
+			} else {
+				_plot(x, y, color, true);
+			}
+			error2 += derror2;
+
+			if (error2 > dx) {
+				y += (ay1 > ay0 ? 1 : -1);
+				error2 -= dx*2;
+			}
+		}
+	}
+
+	void drawSquare(int32_t x, int32_t y, int32_t width, int32_t height, RGBAColor color)
+	{
+		drawLine(x,       y,        x+width, y,        color);
+		drawLine(x+width, y,        x+width, y+height, color);
+		drawLine(x,       y+height, x+width, y+height, color);
+		drawLine(x,       y,        x,       y+height, color);
+	}
+
+	void drawSquareFilled(int32_t x, int32_t y, int32_t width, int32_t height, RGBAColor color)
+	{
+		const int64_t y0 = std::max<int64_t>(y, 0);
+		const int64_t y1 = std::min<int64_t>((int64_t) y + height, m_height);
+		for (int64_t r = y0; r < y1; r++) {
+			_span(x, (int64_t) x + width - 1, r, color);
+		}
+	}
+
+	void drawCircle(int32_t circlex, int32_t circley, int32_t radius, RGBAColor color)
+	{
+		int64_t x = radius;
+		int64_t y = 0;
+		int64_t err = 0;
+
+		while (x >= y) {
+			_plot(circlex + x, circley + y, color, true);
+			_plot(circlex + y, circley + x, color, true);
+			_plot(circlex - y, circley + x, color, true);
+			_plot(circlex - x, circley + y, color, true);
+			_plot(circlex - x, circley - y, color, true);
+			_plot(circlex - y, circley - x, color, true);
+			_plot(circlex + y, circley - x, color, true);
+			_plot(circlex + x, circley - y, color, true);
+
+			if (err <= 0) {
+				y += 1;
+				err += 2*y + 1;
+			}
+			if (err > 0) {
+				x -= 1;
+				err -= 2*x + 1;
+			}
+		}
+	}
+
+	// one span per row (like PixelBuffer::drawCircleFilled)
+	void drawCircleFilled(int32_t circlex, int32_t circley, int32_t radius, RGBAColor color)
+	{
+		if (radius < 0) { return; }
+		const int64_t r = radius;
+		int64_t dx = r;
+		for (int64_t dy = 0; dy <= r; dy++) {
+			while (dx * dx + dy * dy > r * r + r) { dx--; }
+			_span(circlex - dx, circlex + dx, circley + dy, color);
+			if (dy > 0) { _span(circlex - dx, circlex + dx, circley - dy, color); }
+		}
+	}
+
+	// paste brush at pos_x, pos_y, blending colors that are not opaque
+	// (a premultiplied brush is converted to straight alpha, like the canvas)
+	int paste(const ConstPixelView& brush, int32_t pos_x, int32_t pos_y)
+	{
+		const int64_t x0 = std::max<int64_t>(0, pos_x);
+		const int64_t y0 = std::max<int64_t>(0, pos_y);
+		const int64_t x1 = std::min<int64_t>(m_width, (int64_t) pos_x + brush.width());
+		const int64_t y1 = std::min<int64_t>(m_height, (int64_t) pos_y + brush.height());
+		if (x0 >= x1 || y0 >= y1) { return 1; }
+		std::vector<RGBAColor> straight(brush.premultiplied() ? x1 - x0 : 0);
+
+		for (int64_t y = y0; y < y1; y++) {
+			// the brush pixels from x0 to x1
+			const RGBAColor* src = brush.row(y - pos_y) + (x0 - pos_x);
+			if (brush.premultiplied()) {
+				std::transform(src, src + (x1 - x0), straight.begin(), [](const RGBAColor& c) { return rt::unpremultiply(c); });
+				src = straight.data();
+			}
+			const size_t offset = (y & TILE_MASK) * TILE;
+			int64_t x = x0;
+			while (x < x1) {
+				const int64_t end = std::min<int64_t>(x1, ((x >> TILE_SHIFT) + 1) << TILE_SHIFT);
+				RGBAColor* tile = _find(x >> TILE_SHIFT, y >> TILE_SHIFT);
+				// a transparent span leaves a tile that was never written to as it is
+				if (tile == nullptr && rt::alphaSummary(src + (x - x0), end - x) == ALPHA_TRANSPARENT) { x = end; continue; }
+				if (tile == nullptr) { tile = _allocate(x >> TILE_SHIFT, y >> TILE_SHIFT); }
+				rt::blendSpan(tile + offset + (x & TILE_MASK), src + (x - x0), end - x);
+				x = end;
+			}
+		}
+		return 1;
+	}
+
+	int paste(const PixelBuffer& brush, int32_t pos_x, int32_t pos_y)
+	{
+		return paste(brush.view(), pos_x, pos_y);
+	}
+
+	// =========================================================
+	// export
+	// =========================================================
+
+	// copy a part of the canvas into out (the part outside of the canvas is transparent)
+	void copy(int32_t x, int32_t y, uint16_t width, uint16_t height, PixelBuffer& out) const
+	{
+		out = PixelBuffer(width, height, 32, TRANSPARENT);
+		PixelView dst = out.view();
+		for (int r = 0; r < height; r++) {
+			const int64_t py = (int64_t) y + r;
+			if (py < 0 || py >= m_height) { continue; }
+			const int64_t x0 = std::max<int64_t>(x, 0);
+			const int64_t x1 = std::min<int64_t>((int64_t) x + width, m_width);
+			int64_t px = x0;
+			while (px < x1) {
+				const int64_t end = std::min<int64_t>(x1, ((px >> TILE_SHIFT) + 1) << TILE_SHIFT);
+				const RGBAColor* pixels = tile(px >> TILE_SHIFT, py >> TILE_SHIFT);
+				RGBAColor* out_row = dst.row(r) + (px - x);
+				if (pixels == nullptr) {
+					std::fill(out_row, out_row + (end - px), m_background);
+				} else {
+					const RGBAColor* src = pixels + (py & TILE_MASK) * TILE + (px & TILE_MASK);
+					std::copy(src, src + (end - px), out_row);
+				}
+				px = end;
+			}
+		}
+	}
+
+	PixelBuffer copy(int32_t x, int32_t y, uint16_t width, uint16_t height) const
+	{
+		PixelBuffer buffer;
+		copy(x, y, width, height, buffer);
+		return buffer;
+	}
+
+	/**
+	 * @brief write the allocated tiles to a pba container
+	 * @param filename the file to write
+	 * @param compressed lz compress the tiles
+	 * @return 1 on success, 0 on failure
+	 */
+	int write(const std::string& filename, bool compressed = true) const
+	{
+		if (m_width == 0 || m_height == 0) {
+			std::cout << "Invalid canvas, not writing: " << filename << std::endl;
+			return 0;
+		}
+		const std::vector<std::pair<uint32_t, uint32_t>> list = tileList();
+
+		PixelBuffer::PBHeader header;
+		header.width = TILE;
+		header.height = TILE;
+		header.bitdepth = 32;
+		header.end = PBF_TILEMAP;
+		PBTHeader theader;
+		theader.width = m_width;
+		theader.height = m_height;
+		theader.tilesize = TILE;
+		theader.tiles = list.size();
+		theader.background = m_background.asInt();
+
+		std::vector<uint8_t> map;
+		map.insert(map.end(), (const uint8_t*)&header, (const uint8_t*)&header + sizeof(header));
+		map.insert(map.end(), (const uint8_t*)&theader, (const uint8_t*)&theader + sizeof(theader));
+		for (const auto& t : list) {
+			const uint32_t position[2] = { t.first, t.second };
+			map.insert(map.end(), (const uint8_t*)position, (const uint8_t*)(position + 2));
+		}
+
+		PbfContainerWriter writer(filename);
+		if (!writer.isOpen() || !writer.appendRaw(map.data(), map.size())) { return 0; }
+		PixelBuffer tilebuffer;
+		for (const auto& t : list) {
+			const uint16_t w = std::min<uint64_t>(TILE, m_width - ((uint64_t) t.first << TILE_SHIFT));
+			const uint16_t h = std::min<uint64_t>(TILE, m_height - ((uint64_t) t.second << TILE_SHIFT));
+			tilebuffer = PixelBuffer(ConstPixelView(tile(t.first, t.second), w, h, TILE));
+			if (!writer.append(tilebuffer, compressed)) { return 0; }
+		}
+		return writer.close();
+	}
+
+	/**
+	 * @brief read a canvas written by write()
+	 * @param filename the file to read
+	 * @return 1 on success, 0 on failure
+	 */
+	int read(const std::string& filename)
+	{
+		PbfContainerReader reader(filename);
+		size_t size = 0;
+		const uint8_t* data = reader.frameData(0, size);
+
+		PixelBuffer::PBHeader header;
+		PBTHeader theader;
+		bool ok = data != nullptr && size >= sizeof(header) + sizeof(theader);
+		if (ok) {
+			std::memcpy(&header, data, sizeof(header));
+			std::memcpy(&theader, data + sizeof(header), sizeof(theader));
+			ok = header.end == PBF_TILEMAP && theader.tilesize == TILE &&
+				(size - sizeof(header) - sizeof(theader)) / (2 * sizeof(uint32_t)) == theader.tiles &&
+				reader.frames() == (size_t) theader.tiles + 1;
+		}
+		if (!ok) {
+			std::cout << "Invalid canvas file: " << filename << std::endl;
+			return 0;
+		}
+
+		create(theader.width, theader.height, RGBAColor::fromInt(theader.background));
+		const uint8_t* positions = data + sizeof(header) + sizeof(theader);
+		PixelBuffer tilebuffer;
+		for (uint32_t i = 0; i < theader.tiles; i++) {
+			uint32_t position[2];
+			std::memcpy(position, positions + i * sizeof(position), sizeof(position));
+			if (!reader.frame(i + 1, tilebuffer) || position[0] >= tilesX() || position[1] >= tilesY()) {
+				std::cout << "Invalid canvas file: " << filename << std::endl;
+				clear();
+				return 0;
+			}
+			PixelView dst = tileView(position[0], position[1]);
+			ConstPixelView src = static_cast<const PixelBuffer&>(tilebuffer).view();
+			if (src.width() != dst.width() || src.height() != dst.height()) {
+				std::cout << "Invalid canvas file: " << filename << std::endl;
+				clear();
+				return 0;
+			}
+			for (size_t y = 0; y < src.height(); y++) {
+				std::copy(src.row(y), src.row(y) + src.width(), dst.row(y));
+			}
+		}
+		return 1;
+	}
+};
+
+} // namespace rt
+
+#endif // SPARSECANVAS_H
@@ -0,0 +1,333 @@
+/**
+ * @file tiledbuffer.h
+ * @brief RGBA pixels stored in 64x64 tiles: rt::TiledBuffer
+ * @see https://github.com/rktrlng/pixelbuffer
+ */
+
+#ifndef TILEDBUFFER_H
+#define TILEDBUFFER_H
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+#include <pixelbuffer/color.h>
+#include <pixelbuffer/pixelbuffer.h>
+
+namespace rt {
+
+// The pixels are stored tile by tile, 64x64 pixels (16 KiB) per tile, and row
+// major within a tile. A pixel and its neighbours above and below are (almost
+// always) in the same tile, so column access stays in a few pages of cache
+// instead of striding by width through the whole image. A 3x3 filter already
+// streams through three rows of a row major image, it gains nothing from tiles
+// (see tests/tiledbench.cpp).
+// Tiles on the right and bottom edge are padded. Files are read and written
+// through a (row major) PixelBuffer.
+class TiledBuffer
+{
+public:
+	static const int TILE_SHIFT = 6;
+	static const int TILE = 1 << TILE_SHIFT;          // tile width and height
+	static const int TILE_MASK = TILE - 1;
+	static const size_t TILE_PIXELS = TILE * TILE;
+
+private:
+	uint16_t m_width = 0;
+	uint16_t m_height = 0;
+	uint8_t m_bitdepth = 32;
+	size_t m_tilesx = 0;
+	size_t m_tilesy = 0;
+	std::vector<RGBAColor> m_pixels;
+
+	void _init(uint16_t width, uint16_t height, uint8_t bitdepth)
+	{
+		m_width = width;
+		m_height = height;
+		m_bitdepth = bitdepth;
+		m_tilesx = (width + TILE - 1) / TILE;
+		m_tilesy = (height + TILE - 1) / TILE;
+		m_pixels.assign(m_tilesx * m_tilesy * TILE_PIXELS, TRANSPARENT);
+	}
+
+	// index of x, y in m_pixels, no bounds check
+	size_t _index(size_t x, size_t y) const
+	{
+		return (((y >> TILE_SHIFT) * m_tilesx + (x >> TILE_SHIFT)) << (2 * TILE_SHIFT)) |
+			((y & TILE_MASK) << TILE_SHIFT) | (x & TILE_MASK);
+	}
+
+public:
+	TiledBuffer() { }
+
+	TiledBuffer(uint16_t width, uint16_t height, uint8_t bitdepth = 32, RGBAColor color = TRANSPARENT)
+	{
+		_init(width, height, bitdepth);
+		fill(color);
+	}
+
+	explicit TiledBuffer(const PixelBuffer& pb)
+	{
+		fromPixelBuffer(pb);
+	}
+
+	TiledBuffer(const std::string& filename)
+	{
+		read(filename);
+	}
+
+	uint16_t width() const { return m_width; }
+	uint16_t height() const { return m_height; }
+	uint8_t bitdepth() const { return m_bitdepth; }
+	size_t tilesX() const { return m_tilesx; }
+	size_t tilesY() const { return m_tilesy; }
+
+	// the TILE x TILE pixels of tile tx, ty (row major)
+	RGBAColor* tile(size_t tx, size_t ty) { return &m_pixels[(ty * m_tilesx + tx) * TILE_PIXELS]; }
+	const RGBAColor* tile(size_t tx, size_t ty) const { return &m_pixels[(ty * m_tilesx + tx) * TILE_PIXELS]; }
+
+	bool valid() const { return m_width > 0 && m_height > 0 && m_pixels.size() == m_tilesx * m_tilesy * TILE_PIXELS; }
+
+	int setPixel(int x, int y, RGBAColor color, bool blend = false)
+	{
+		if ( (x < 0) || (x >= m_width) || (y < 0) || (y >= m_height) ) {
+			return 0;
+		}
+		RGBAColor& pixel = m_pixels[_index(x, y)];
+		if (color.a < 255 && blend) {
+			color = rt::alphaBlend(color, pixel);
+		}
+		pixel = color;
+		return 1;
+	}
+
+	RGBAColor getPixel(int x, int y) const
+	{
+		if ( (x < 0) || (x >= m_width) || (y < 0) || (y >= m_height) ) {
+			return { 0, 0, 0, 0 };
+		}
+		return m_pixels[_index(x, y)];
+	}
+
+	void fill(RGBAColor color)
+	{
+		std::fill(m_pixels.begin(), m_pixels.end(), color);
+	}
+
+	// =========================================================
+	// conversion
+	// =========================================================
+
+	int fromPixelBuffer(const PixelBuffer& pb)
+	{
+		if (!pb.valid()) { return 0; }
+		if (pb.premultiplied()) {
+			PixelBuffer straight = pb;
+			straight.unpremultiply();
+			return fromPixelBuffer(straight);
+		}
+		_init(pb.width(), pb.height(), pb.bitdepth());
+		const RGBAColor* src = pb.pixels().data();
+		for (size_t y = 0; y < m_height; y++) {
+			for (size_t x = 0; x < m_width; x += TILE) {
+				const size_t n = std::min<size_t>(TILE, m_width - x);
+				std::copy(src + y * m_width + x, src + y * m_width + x + n, &m_pixels[_index(x, y)]);
+			}
+		}
+		return 1;
+	}
+
+	void toPixelBuffer(PixelBuffer& pb) const
+	{
+		if (pb.width() != m_width || pb.height() != m_height || !pb.valid() || pb.premultiplied()) {
+			pb = PixelBuffer(m_width, m_height, m_bitdepth);
+		}
+		pb.bitdepth(m_bitdepth);
+		RGBAColor* dst = pb.pixels().data();
+		for (size_t y = 0; y < m_height; y++) {
+			for (size_t x = 0; x < m_width; x += TILE) {
+				const size_t n = std::min<size_t>(TILE, m_width - x);
+				const RGBAColor* src = &m_pixels[_index(x, y)];
+				std::copy(src, src + n, dst + y * m_width + x);
+			}
+		}
+	}
+
+	PixelBuffer toPixelBuffer() const
+	{
+		PixelBuffer pb(m_width, m_height, m_bitdepth);
+		toPixelBuffer(pb);
+		return pb;
+	}
+
+	int read(const std::string& filename)
+	{
+		PixelBuffer pb;
+		if (!pb.read(filename)) { return 0; }
+		return fromPixelBuffer(pb);
+	}
+
+	int write(const std::string& filename) const
+	{
+		if (!valid()) {
+			std::cout << "Invalid tiledbuffer, not writing: " << filename << std::endl;
+			return 0;
+		}
+		return toPixelBuffer().write(filename);
+	}
+
+	// =========================================================
+	// drawing
+	// =========================================================
+
+	void drawLine(int x0, int y0, int x1, int y1, RGBAColor color)
+	{
+		bool steep = false;
+		if (std::abs(x0-x1) < std::abs(y0-y1)) {
+			std::swap(x0, y0);
+			std::swap(x1, y1);
+			steep = true;
+		}
+		if (x0 > x1) {
+			std::swap(x0, x1);
+			std::swap(y0, y1);
+		}
+		int dx = x1-x0;
+		int dy = y1-y0;
+		int derror2 = std::abs(dy)*2;
+		int error2 = 0;
+		int y = y0;
+
+		for (int x = x0; x <= x1; x++) {
+			if (steep) {
+				setPixel(y, x, color, true);
+			} else {
+				setPixel(x, y, color, true);
+			}
+			error2 += derror2;
+
+			if (error2 > dx) {
+				y += (y1 > y0 ? 1 : -1);
+				error2 -= dx*2;
+			}
+		}
+	}
+
+	void drawSquare(int x, int y, int width, int height, RGBAColor color)
+	{
+		drawLine(x,       y,        x+width, y,        color);
+		drawLine(x+width, y,        x+width, y+height, color);
+		drawLine(x,       y+height, x+width, y+height, color);
+		drawLine(x,       y,        x,       y+height, color);
+	}
+
+	void drawSquareFilled(int x, int y, int width, int height, RGBAColor color)
+	{
+		const int x0 = std::max(x, 0);
+		const int y0 = std::max(y, 0);
+		const int x1 = std::min(x + width, (int) m_width);
+		const int y1 = std::min(y + height, (int) m_height);
+		for (int py = y0; py < y1; py++) {
+			for (int px = x0; px < x1; px++) {
+				setPixel(px, py, color, true);
+			}
+		}
+	}
+
+	// the top and bottom rows swap places
+	void flipRows()
+	{
+		// a column of tiles at a time, so both tiles of a swap stay in cache
+		for (size_t x = 0; x < m_width; x += TILE) {
+			const size_t n = std::min<size_t>(TILE, m_width - x);
+			for (size_t y = 0; y < m_height / 2; y++) {
+				RGBAColor* a = &m_pixels[_index(x, y)];
+				std::swap_ranges(a, a + n, &m_pixels[_index(x, m_height - 1 - y)]);
+			}
+		}
+	}
+
+	// =========================================================
+	// filters
+	// =========================================================
+
+	// 3x3 box blur, the center weighs sharpness, edge pixels are repeated
+	// sharpness 1 = fully blurred
+	// sharpness ..50+ = less blurred
+	// Unlike PixelBuffer::blur, all pixels are blurred from the original image
+	// (like PlanarBuffer::blur). Tile by tile: only the pixels on the border of
+	// a tile look into the neighbouring tiles.
+	void blur(int sharpness = 1)
+	{
+		if (!valid() || sharpness < 0) { return; }
+		std::vector<RGBAColor> result(m_pixels.size());
+		const int divisor = 8 + sharpness;
+
+		for (size_t ty = 0; ty < m_tilesy; ty++) {
+			for (size_t tx = 0; tx < m_tilesx; tx++) {
+				const int x0 = tx * TILE;
+				const int y0 = ty * TILE;
+				const int tw = std::min(TILE, m_width - x0);
+				const int th = std::min(TILE, m_height - y0);
+				const RGBAColor* src = tile(tx, ty);
+				RGBAColor* dst = &result[(ty * m_tilesx + tx) * TILE_PIXELS];
+
+				// inside the tile
+				for (int y = 1; y < th - 1; y++) {
+					const RGBAColor* above = src + (y - 1) * TILE;
+					const RGBAColor* row = src + y * TILE;
+					const RGBAColor* below = src + (y + 1) * TILE;
+					for (int x = 1; x < tw - 1; x++) {
+						const RGBAColor* u = above + x;
+						const RGBAColor* m = row + x;
+						const RGBAColor* d = below + x;
+						const int r = u[-1].r + u[0].r + u[1].r + m[-1].r + m[0].r * sharpness + m[1].r + d[-1].r + d[0].r + d[1].r;
+						const int g = u[-1].g + u[0].g + u[1].g + m[-1].g + m[0].g * sharpness + m[1].g + d[-1].g + d[0].g + d[1].g;
+						const int b = u[-1].b + u[0].b + u[1].b + m[-1].b + m[0].b * sharpness + m[1].b + d[-1].b + d[0].b + d[1].b;
+						const int a = u[-1].a + u[0].a + u[1].a + m[-1].a + m[0].a * sharpness + m[1].a + d[-1].a + d[0].a + d[1].a;
+						dst[y * TILE + x] = RGBAColor(r / divisor, g / divisor, b / divisor, a / divisor);
+					}
+				}
+
+				// the border of the tile
+				for (int y = 0; y < th; y++) {
+					const int step = (y == 0 || y == th - 1) ? 1 : std::max(1, tw - 1);
+					for (int x = 0; x < tw; x += step) {
+						dst[y * TILE + x] = _blurred(x0 + x, y0 + y, sharpness);
+					}
+				}
+			}
+		}
+		m_pixels.swap(result);
+	}
+
+private:
+	// 3x3 box blur of a single pixel, with the edge pixels repeated
+	RGBAColor _blurred(int x, int y, int sharpness) const
+	{
+		int totalr = 0;
+		int totalg = 0;
+		int totalb = 0;
+		int totala = 0;
+		for (int r = -1; r < 2; r++) {
+			for (int c = -1; c < 2; c++) {
+				const int nx = std::min(std::max(x + c, 0), m_width - 1);
+				const int ny = std::min(std::max(y + r, 0), m_height - 1);
+				const RGBAColor& color = m_pixels[_index(nx, ny)];
+				const int weight = (r == 0 && c == 0) ? sharpness : 1;
+				totalr += color.r * weight;
+				totalg += color.g * weight;
+				totalb += color.b * weight;
+				totala += color.a * weight;
+			}
+		}
+		const int divisor = 8 + sharpness;
+		return RGBAColor(totalr / divisor, totalg / divisor, totalb / divisor, totala / divisor);
+	}
+};
+
+} // namespace rt
+
+#endif // TILEDBUFFER_H
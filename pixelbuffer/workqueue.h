@@ -0,0 +1,77 @@
+/**
+ * @file workqueue.h
+ * @brief Thread safe, bounded FIFO queue: rt::BoundedQueue<T>
+ * @see https://github.com/rktrlng/pixelbuffer
+ */
+
+#ifndef WORKQUEUE_H
+#define WORKQUEUE_H
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+namespace rt {
+
+// push() blocks while the queue is full, pop() blocks while it is empty.
+// After close(), push() fails and pop() drains the remaining items.
+template <class T>
+class BoundedQueue
+{
+private:
+	std::deque<T> m_items;
+	size_t m_capacity;
+	bool m_closed = false;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_notfull;
+	std::condition_variable m_notempty;
+
+public:
+	explicit BoundedQueue(size_t capacity) : m_capacity(capacity > 0 ? capacity : 1) { }
+
+	BoundedQueue(const BoundedQueue& other) = delete;
+	BoundedQueue& operator=(const BoundedQueue& other) = delete;
+
+	bool push(T item)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_notfull.wait(lock, [this] { return m_closed || m_items.size() < m_capacity; });
+		if (m_closed) { return false; }
+		m_items.push_back(std::move(item));
+		lock.unlock();
+		m_notempty.notify_one();
+		return true;
+	}
+
+	bool pop(T& item)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_notempty.wait(lock, [this] { return m_closed || !m_items.empty(); });
+		if (m_items.empty()) { return false; } // closed and drained
+		item = std::move(m_items.front());
+		m_items.pop_front();
+		lock.unlock();
+		m_notfull.notify_one();
+		return true;
+	}
+
+	void close()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_closed = true;
+		m_notfull.notify_all();
+		m_notempty.notify_all();
+	}
+
+	size_t size() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_items.size();
+	}
+
+	size_t capacity() const { return m_capacity; }
+};
+
+} // namespace rt
+
+#endif // WORKQUEUE_H
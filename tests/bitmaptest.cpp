@@ -0,0 +1,140 @@
+#include <iostream>
+#include <cassert>
+
+#include <pixelbuffer/bitmap.h>
+#include <pixelbuffer/util.h>
+
+int test_bits()
+{
+	rt::Bitmap bm(100, 3);
+	assert(bm.valid() && bm.wordsPerRow() == 2);
+	assert(bm.count() == 0);
+
+	// most significant bit first
+	bm.setPixel(0, 0, true);
+	bm.setPixel(65, 1, true);
+	assert(bm.row(0)[0] == 0x8000000000000000ull);
+	assert(bm.row(1)[1] == 0x4000000000000000ull);
+	assert(bm.getPixel(65, 1) && !bm.getPixel(64, 1));
+	assert(bm.setPixel(100, 0, true) == 0 && !bm.getPixel(100, 0));
+	bm.setPixel(0, 0, false);
+	assert(bm.count() == 1);
+
+	// the padding bits stay 0
+	bm.fill(true);
+	assert(bm.count() == 300 && bm.count(2) == 100);
+	bm.invert();
+	assert(bm.count() == 0);
+	assert((~bm).count() == 300);
+
+	return 1;
+}
+
+int test_word_operations()
+{
+	rt::Bitmap a(128, 64);
+	rt::Bitmap b(128, 64);
+	a.fill(true);
+	for (int y = 0; y < 64; y++) {
+		for (int x = 0; x < 128; x += 2) { b.setPixel(x, y, true); }
+	}
+	assert((a & b) == b);
+	assert((a | b) == a);
+	assert((a ^ b).count() == 64 * 64);
+	assert(((a ^ b) | b) == a);
+	rt::Bitmap c = a;
+	c.andNot(b);
+	assert(c == (a ^ b));
+
+	// different sizes: unchanged
+	rt::Bitmap other(8, 8);
+	c &= other;
+	assert(c == (a ^ b));
+
+	// shifts, across word boundaries
+	rt::Bitmap s(150, 10);
+	s.setPixel(0, 0, true);
+	s.setPixel(60, 5, true);
+	s.setPixel(149, 9, true);
+	s.shift(70, 0);
+	assert(s.getPixel(70, 0) && s.getPixel(130, 5) && s.count() == 2);
+	s.shift(-130, 0);
+	assert(s.getPixel(0, 5) && s.count() == 1);
+	s.shift(3, 2);
+	assert(s.getPixel(3, 7) && s.count() == 1);
+	s.shift(0, -7);
+	assert(s.getPixel(3, 0) && s.count() == 1);
+	s.shift(0, 10);
+	assert(s.count() == 0);
+
+	return 1;
+}
+
+int test_conversion()
+{
+	rt::PixelBuffer pb(96, 40, 32, BLACK);
+	pb.drawCircleFilled(48, 20, 15, WHITE);
+	pb.setPixel(1, 1, rt::RGBAColor(255, 255, 255, 100)); // transparent is 0
+	rt::Bitmap bm(pb);
+	assert(bm.getPixel(48, 20) && !bm.getPixel(0, 0) && !bm.getPixel(1, 1));
+
+	// premultiplied pixels are compared in straight alpha
+	rt::PixelBuffer premultiplied(8, 8, 32, rt::RGBAColor(200, 200, 200, 160));
+	premultiplied.premultiply();
+	assert(rt::Bitmap(premultiplied).getPixel(3, 3));
+
+	// the same bits as a 1 bit pbf
+	rt::BitBuffer bits = bm.toBitBuffer();
+	std::vector<uint8_t> payload(rt::PixelBuffer::payloadSize(96, 40, 1));
+	pb.bitdepth(1);
+	rt::PixelBuffer::encodePixels(pb.pixels().data(), payload.data(), 96 * 40, 1);
+	assert(std::equal(payload.begin(), payload.end(), bits.data()));
+
+	rt::PixelBuffer back = bm.toPixelBuffer();
+	assert(back.bitdepth() == 1);
+	assert(back.getPixel(48, 20) == WHITE && back.getPixel(0, 0) == BLACK && back.getPixel(1, 1) == BLACK);
+	rt::PixelBuffer decoded(96, 40, 32);
+	rt::PixelBuffer::decodePixels(payload.data(), decoded.pixels().data(), 96 * 40, 1);
+	assert(back.pixels() == decoded.pixels());
+
+	return 1;
+}
+
+int test_read_write()
+{
+	rt::Bitmap bm(200, 50);
+	for (int i = 0; i < 50; i++) { bm.setPixel(i * 4, i, true); }
+	assert(bm.write("bitmap.pbf") == 1);
+
+	// a 1 bit pbf
+	rt::PixelBuffer pb("bitmap.pbf");
+	assert(pb.bitdepth() == 1 && pb.getPixel(196, 49) == WHITE && pb.getPixel(195, 49) == BLACK);
+
+	rt::Bitmap loaded("bitmap.pbf");
+	assert(loaded == bm);
+	assert(bm.writeCompressed("bitmapz.pbf") == 1);
+	assert(loaded.read("bitmapz.pbf") && loaded == bm);
+
+	// other bitdepths through a PixelBuffer
+	pb.bitdepth(24);
+	pb.write("bitmap24.pbf");
+	assert(loaded.read("bitmap24.pbf") && loaded == bm);
+
+	// 1 bit pbf files have a width of a multiple of 8
+	rt::Bitmap odd(13, 2);
+	assert(odd.write("bitmapodd.pbf") == 0);
+
+	return 1;
+}
+
+int main(void)
+{
+	rt::run_unit_test("test_bits", test_bits);
+	rt::run_unit_test("test_word_operations", test_word_operations);
+	rt::run_unit_test("test_conversion", test_conversion);
+	rt::run_unit_test("test_read_write", test_read_write);
+
+	std::cout << "## finished ##" << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,213 @@
+#include <iostream>
+#include <cassert>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+
+#include <pixelbuffer/blend.h>
+#include <pixelbuffer/pixelbuffer.h>
+#include <pixelbuffer/util.h>
+
+// the float formula alphaBlend used to be
+rt::RGBAColor float_blend(const rt::RGBAColor& top, const rt::RGBAColor& bottom)
+{
+	float a0 = top.a / 255.0f;
+	float a1 = bottom.a / 255.0f;
+	float a01 = (1 - a0) * a1 + a0;
+	if (a01 == 0.0f) { return bottom; }
+	float r = ((1 - a0) * a1 * bottom.r + a0 * top.r) / a01;
+	float g = ((1 - a0) * a1 * bottom.g + a0 * top.g) / a01;
+	float b = ((1 - a0) * a1 * bottom.b + a0 * top.b) / a01;
+	return rt::RGBAColor(std::lround(r), std::lround(g), std::lround(b), std::lround(a01 * 255));
+}
+
+rt::RGBAColor random_color(int alpha)
+{
+	return rt::RGBAColor(rand() % 256, rand() % 256, rand() % 256, alpha < 0 ? rand() % 256 : alpha);
+}
+
+int blend_alpha()
+{
+	// rounded integer math, within 1 of the float formula
+	for (int i = 0; i < 200000; i++) {
+		const rt::RGBAColor top = random_color(-1);
+		const rt::RGBAColor bottom = random_color(i % 2 ? 255 : -1);
+		const rt::RGBAColor a = rt::alphaBlend(top, bottom);
+		const rt::RGBAColor b = float_blend(top, bottom);
+		assert(std::abs(a.r - b.r) <= 1);
+		assert(std::abs(a.g - b.g) <= 1);
+		assert(std::abs(a.b - b.b) <= 1);
+		assert(std::abs(a.a - b.a) <= 1);
+	}
+
+	// all 256 x 256 values of a channel over an opaque color are exact
+	for (uint32_t c = 0; c < 256; c++) {
+		for (uint32_t a = 0; a < 256; a++) {
+			const rt::RGBAColor top = rt::RGBAColor(c, c, c, a);
+			const rt::RGBAColor bottom = rt::RGBAColor(255 - c, 0, 255, 255);
+			const rt::RGBAColor blended = rt::alphaBlend(top, bottom);
+			assert(blended.r == (c * a + (255 - c) * (255 - a) + 127) / 255);
+			assert(blended.g == (c * a + 127) / 255);
+			assert(blended.a == 255);
+		}
+	}
+
+	assert(rt::alphaBlend(RED, BLUE) == RED);
+	assert(rt::alphaBlend(rt::RGBAColor(1, 2, 3, 0), BLUE) == BLUE);
+	assert(rt::alphaBlend(rt::RGBAColor(255, 0, 0, 128), rt::RGBAColor(0, 0, 0, 0)) == rt::RGBAColor(255, 0, 0, 128));
+
+	return 1;
+}
+
+int blend_span()
+{
+	// every length, every mix of opaque, transparent and partial pixels
+	for (size_t count = 0; count < 70; count++) {
+		for (int mix = 0; mix < 6; mix++) {
+			std::vector<rt::RGBAColor> src(count);
+			std::vector<rt::RGBAColor> dst(count);
+			for (size_t i = 0; i < count; i++) {
+				const int alpha[] = { 255, 0, -1, -1, 255, 0 };
+				src[i] = random_color(mix < 3 ? alpha[mix] : alpha[rand() % 6]);
+				dst[i] = random_color(mix % 2 ? 255 : -1);
+			}
+			std::vector<rt::RGBAColor> expected = dst;
+			for (size_t i = 0; i < count; i++) {
+				expected[i] = rt::alphaBlend(src[i], dst[i]);
+			}
+			rt::blendSpan(dst.data(), src.data(), count);
+			assert(dst == expected);
+		}
+	}
+
+	// a single color
+	for (size_t count = 0; count < 70; count++) {
+		const rt::RGBAColor color = random_color(count % 3 ? -1 : (count % 2) * 255);
+		std::vector<rt::RGBAColor> dst(count);
+		for (size_t i = 0; i < count; i++) {
+			dst[i] = random_color(i % 5 ? 255 : -1);
+		}
+		std::vector<rt::RGBAColor> expected = dst;
+		for (size_t i = 0; i < count; i++) {
+			expected[i] = rt::alphaBlend(color, dst[i]);
+		}
+		rt::blendSpan(dst.data(), color, count);
+		assert(dst == expected);
+	}
+
+	return 1;
+}
+
+int blend_view()
+{
+	rt::PixelBuffer brush(37, 21, 32, rt::RGBAColor(255, 0, 0, 100));
+	brush.drawSquareFilled(5, 5, 10, 10, GREEN);
+	brush.setPixel(20, 10, rt::RGBAColor(0, 0, 0, 0));
+
+	rt::PixelBuffer canvas(64, 64, 32, BLUE);
+	canvas.setPixel(12, 12, rt::RGBAColor(10, 20, 30, 40));
+	rt::PixelBuffer expected = canvas;
+	for (int y = 0; y < brush.height(); y++) {
+		for (int x = 0; x < brush.width(); x++) {
+			expected.setPixel(10 + x, 10 + y, brush.getPixel(x, y), true);
+		}
+	}
+
+	// the destination rectangle of rt::blend is a view
+	assert(rt::blend(brush.view(), canvas.view(10, 10, 40, 40)));
+	assert(canvas.pixels() == expected.pixels());
+
+	// clipped by the destination
+	rt::PixelBuffer small(8, 8, 32, BLUE);
+	rt::blend(brush.view(), small.view(4, 4, 4, 4));
+	assert(small.getPixel(4, 4) == rt::alphaBlend(rt::RGBAColor(255, 0, 0, 100), BLUE));
+	assert(small.getPixel(3, 3) == BLUE);
+
+	return 1;
+}
+
+int blend_lines()
+{
+	// flat lines are drawn in spans, the pixels are the same
+	const rt::RGBAColor color = rt::RGBAColor(200, 100, 50, 120);
+	for (int i = 0; i < 500; i++) {
+		const int x0 = rand() % 80 - 8;
+		const int y0 = rand() % 80 - 8;
+		const int x1 = rand() % 80 - 8;
+		const int y1 = rand() % 80 - 8;
+		rt::PixelBuffer pb(64, 64, 32, GRAY);
+		pb.drawLine(x0, y0, x1, y1, color);
+
+		rt::PixelBuffer expected(64, 64, 32, GRAY);
+		int ax = x0, ay = y0, bx = x1, by = y1;
+		const bool steep = std::abs(ax - bx) < std::abs(ay - by);
+		if (steep) { std::swap(ax, ay); std::swap(bx, by); }
+		if (ax > bx) { std::swap(ax, bx); std::swap(ay, by); }
+		int error2 = 0;
+		int y = ay;
+		for (int x = ax; x <= bx; x++) {
+			if (steep) { expected.setPixel(y, x, color, true); }
+			else { expected.setPixel(x, y, color, true); }
+			error2 += std::abs(by - ay) * 2;
+			if (error2 > bx - ax) {
+				y += (by > ay ? 1 : -1);
+				error2 -= (bx - ax) * 2;
+			}
+		}
+		assert(pb.pixels() == expected.pixels());
+	}
+
+	return 1;
+}
+
+int blend_summary()
+{
+	rt::PixelBuffer opaque(40, 30, 32, RED);
+	rt::PixelBuffer empty(40, 30, 32, rt::RGBAColor(1, 2, 3, 0));
+	rt::PixelBuffer mixed(40, 30, 32, RED);
+	mixed.setPixel(39, 29, rt::RGBAColor(0, 0, 0, 254));
+	assert(opaque.alphaSummary() == rt::ALPHA_OPAQUE);
+	assert(empty.alphaSummary() == rt::ALPHA_TRANSPARENT);
+	assert(mixed.alphaSummary() == rt::ALPHA_MIXED);
+	// sub views look at their own pixels only
+	assert(mixed.view(0, 0, 39, 30).alphaSummary() == rt::ALPHA_OPAQUE);
+	assert(mixed.view(30, 20, 10, 10).alphaSummary() == rt::ALPHA_MIXED);
+	rt::PixelBuffer rows(8, 8, 32, RED);
+	rows.view(0, 4, 8, 4).fill(rt::RGBAColor(0, 0, 0, 0));
+	assert(rows.view(0, 0, 7, 8).alphaSummary() == rt::ALPHA_MIXED);
+	assert(rows.view(0, 4, 7, 4).alphaSummary() == rt::ALPHA_TRANSPARENT);
+
+	// with or without the summary, paste gives the same pixels
+	const rt::PixelBuffer* brushes[] = { &opaque, &empty, &mixed };
+	for (const rt::PixelBuffer* brush : brushes) {
+		for (int pos = -50; pos < 80; pos += 13) {
+			rt::PixelBuffer a(64, 48, 32, rt::RGBAColor(0, 0, 255, 128));
+			rt::PixelBuffer b = a;
+			a.paste(*brush, pos, pos / 2);
+			b.paste(*brush, pos, pos / 2, brush->alphaSummary());
+			assert(a.pixels() == b.pixels());
+		}
+	}
+
+	// premultiplied destinations, opaque brushes are the same
+	rt::PixelBuffer pm(64, 48, 32, rt::RGBAColor(0, 0, 255, 128));
+	pm.premultiply();
+	pm.paste(opaque, 10, 10, rt::ALPHA_OPAQUE);
+	assert(pm.getPixel(10, 10) == RED);
+
+	return 1;
+}
+
+int main(void)
+{
+	srand(42);
+	rt::run_unit_test("blend_alpha", blend_alpha);
+	rt::run_unit_test("blend_span", blend_span);
+	rt::run_unit_test("blend_view", blend_view);
+	rt::run_unit_test("blend_lines", blend_lines);
+	rt::run_unit_test("blend_summary", blend_summary);
+
+	std::cout << "## finished ##" << std::endl;
+
+	return 0;
+}
@@ -99,6 +99,43 @@ int color_rotate()
 	return 1;
 }
 
+int color_premultiplied()
+{
+	// a * b / 255, rounded
+	for (uint32_t a = 0; a < 256; a++) {
+		for (uint32_t b = 0; b < 256; b++) {
+			assert(rt::mul255(a, b) == (a * b + 127) / 255);
+		}
+	}
+
+	rt::RGBAColor half = rt::RGBAColor(200, 100, 50, 128);
+	rt::RGBAColor pm = rt::premultiply(half);
+	assert(pm == rt::RGBAColor(100, 50, 25, 128));
+	assert(rt::unpremultiply(pm) == rt::RGBAColor(199, 100, 50, 128));
+	assert(rt::premultiply(rt::RGBAColor(1, 2, 3, 0)) == rt::RGBAColor(0, 0, 0, 0));
+	assert(rt::unpremultiply(rt::RGBAColor(0, 0, 0, 0)) == rt::RGBAColor(0, 0, 0, 0));
+	assert(rt::unpremultiply(rt::RGBAColor(1, 2, 3, 255)) == rt::RGBAColor(1, 2, 3, 255));
+
+	// premultiplied "over" agrees with alphaBlend (within rounding: at low alpha
+	// the premultiplied colors lose a few bits)
+	const rt::RGBAColor tops[] = { half, rt::RGBAColor(0, 255, 0, 10), rt::RGBAColor(255, 255, 255, 254) };
+	const rt::RGBAColor bottoms[] = { rt::RGBAColor(0, 0, 255, 255), rt::RGBAColor(10, 20, 30, 200), rt::RGBAColor(90, 80, 70, 60) };
+	for (const rt::RGBAColor& top : tops) {
+		for (const rt::RGBAColor& bottom : bottoms) {
+			rt::RGBAColor straight = rt::alphaBlend(top, bottom);
+			rt::RGBAColor blended = rt::unpremultiply(rt::premultipliedBlend(rt::premultiply(top), rt::premultiply(bottom)));
+			for (int c = 0; c < 4; c++) {
+				assert(std::abs(straight[c] - blended[c]) <= 4);
+			}
+		}
+	}
+
+	// over an opaque color stays opaque, a transparent top changes nothing
+	assert(rt::premultipliedBlend(pm, RED).a == 255);
+	assert(rt::premultipliedBlend(rt::RGBAColor(0, 0, 0, 0), pm) == pm);
+
+	return 1;
+}
 
 int main(void)
 {
@@ -106,6 +143,7 @@ int main(void)
 	rt::run_unit_test("color_eq", color_eq);
 	rt::run_unit_test("color_index", color_index);
 	rt::run_unit_test("color_rotate", color_rotate);
+	rt::run_unit_test("color_premultiplied", color_premultiplied);
 
 	std::cout << "## finished ##" << std::endl;
 
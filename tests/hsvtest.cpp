@@ -0,0 +1,118 @@
+#include <iostream>
+#include <cassert>
+#include <cstdlib>
+#include <vector>
+
+#include <pixelbuffer/hsv.h>
+#include <pixelbuffer/pixelbuffer.h>
+#include <pixelbuffer/util.h>
+
+int hsv_convert()
+{
+	// every r, g, b (with some alpha): the same as the scalar converters
+	std::vector<rt::RGBAColor> rgba(1 << 24);
+	for (size_t i = 0; i < rgba.size(); i++) {
+		rgba[i] = rt::RGBAColor(i & 0xFF, (i >> 8) & 0xFF, i >> 16, (i * 7) & 0xFF);
+	}
+	std::vector<rt::HSVAColor> hsva(rgba.size());
+	rt::toHSVA(rgba.data(), hsva.data(), rgba.size());
+	std::vector<rt::RGBAColor> back(rgba.size());
+	rt::fromHSVA(hsva.data(), back.data(), hsva.size());
+	for (size_t i = 0; i < rgba.size(); i++) {
+		assert(hsva[i] == rt::RGBA2HSVA(rgba[i]));
+		assert(back[i] == rt::HSVA2RGBA(hsva[i]));
+	}
+
+	// any hsva, and spans that don't fill a SIMD register
+	for (size_t count = 0; count < 11; count++) {
+		std::vector<rt::HSVAColor> in(count);
+		for (size_t i = 0; i < count; i++) {
+			in[i] = rt::HSVAColor(rt::rand_float(), (i % 3) ? rt::rand_float() : 0.0f, rt::rand_float(), rt::rand_float());
+		}
+		in.push_back(rt::HSVAColor(1.0f, 0.5f, 0.5f, 1.0f));
+		std::vector<rt::RGBAColor> out(in.size());
+		rt::fromHSVA(in.data(), out.data(), in.size());
+		for (size_t i = 0; i < in.size(); i++) {
+			assert(out[i] == rt::HSVA2RGBA(in[i]));
+		}
+	}
+
+	// a whole buffer, and back
+	rt::PixelBuffer pb(67, 33, 32, RED);
+	pb.drawCircleFilled(30, 16, 12, rt::RGBAColor(10, 200, 100, 128));
+	std::vector<rt::HSVAColor> colors;
+	pb.toHSVA(colors);
+	assert(colors.size() == 67 * 33);
+	assert(colors[0] == rt::RGBA2HSVA(RED));
+	rt::PixelBuffer copy(67, 33, 32, BLACK);
+	assert(copy.fromHSVA(colors));
+	for (size_t i = 0; i < colors.size(); i++) {
+		assert(copy.pixels()[i] == rt::HSVA2RGBA(colors[i]));
+	}
+	colors.pop_back();
+	assert(copy.fromHSVA(colors) == 0);
+
+	return 1;
+}
+
+int hsv_rotate()
+{
+	// pure colors rotate like rt::rotate
+	rt::RGBAColor rgb = RED;
+	rt::rotateHue(&rgb, 1, 0.25f);
+	assert(rgb == rt::RGBAColor(127, 255, 0, 255));
+	rgb = rt::RGBAColor(255, 0, 0, 127);
+	rt::rotateHue(&rgb, 1, 0.5f);
+	assert(rgb == rt::RGBAColor(0, 255, 255, 127));
+	rgb = RED;
+	rt::rotateHue(&rgb, 1, 1.0f);
+	assert(rgb == RED);
+	rt::rotateHue(&rgb, 1, -0.5f);
+	assert(rgb == CYAN);
+
+	// grays don't change, the others are close to rt::rotate
+	const float steps[] = { 0.006f, 0.1f, 0.25f, 0.333f, 0.5f, 0.75f, 0.999f, -0.3f, 2.6f };
+	for (float step : steps) {
+		std::vector<rt::RGBAColor> colors(100000);
+		for (size_t i = 0; i < colors.size(); i++) {
+			colors[i] = rt::RGBAColor(rand() % 256, rand() % 256, rand() % 256, rand() % 256);
+		}
+		colors[0] = GRAY;
+		std::vector<rt::RGBAColor> rotated = colors;
+		rt::rotateHue(rotated.data(), rotated.size(), step);
+		assert(rotated[0] == GRAY);
+		for (size_t i = 0; i < colors.size(); i++) {
+			const rt::RGBAColor expected = rt::rotate(colors[i], step - std::floor(step));
+			assert(std::abs(rotated[i].r - expected.r) <= 2);
+			assert(std::abs(rotated[i].g - expected.g) <= 2);
+			assert(std::abs(rotated[i].b - expected.b) <= 2);
+			assert(rotated[i].a == colors[i].a);
+			// a single pixel takes the scalar path
+			rt::RGBAColor single = colors[i];
+			rt::rotateHue(&single, 1, step);
+			assert(single == rotated[i]);
+		}
+	}
+
+	// a buffer, or a part of it
+	rt::PixelBuffer pb(40, 40, 32, RED);
+	pb.view(10, 10, 10, 10).rotateHue(0.5f);
+	assert(pb.getPixel(10, 10) == CYAN);
+	assert(pb.getPixel(9, 10) == RED);
+	pb.rotateHue(0.5f);
+	assert(pb.getPixel(10, 10) == RED);
+	assert(pb.getPixel(9, 10) == CYAN);
+
+	return 1;
+}
+
+int main(void)
+{
+	srand(42);
+	rt::run_unit_test("hsv_convert", hsv_convert);
+	rt::run_unit_test("hsv_rotate", hsv_rotate);
+
+	std::cout << "## finished ##" << std::endl;
+
+	return 0;
+}
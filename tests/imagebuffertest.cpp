@@ -0,0 +1,173 @@
+#include <iostream>
+#include <cassert>
+
+#include <pixelbuffer/imagebuffer.h>
+#include <pixelbuffer/util.h>
+
+int test_storage()
+{
+	rt::BitBuffer bits(64, 32);
+	rt::GrayBuffer gray(64, 32);
+	rt::GrayAlphaBuffer grayalpha(64, 32);
+	rt::RGBBuffer rgb(64, 32);
+	rt::RGBABuffer rgba(64, 32);
+
+	assert(bits.size() == 64 * 32 / 8);
+	assert(gray.size() == 64 * 32);
+	assert(grayalpha.size() == 64 * 32 * 2);
+	assert(rgb.size() == 64 * 32 * 3);
+	assert(rgba.size() == 64 * 32 * 4);
+	assert(bits.valid() && gray.valid() && grayalpha.valid() && rgb.valid() && rgba.valid());
+	assert(bits.bitdepth() == 1 && gray.bitdepth() == 8 && rgba.bitdepth() == 32);
+
+	// 1 bit rows of any width are padded to whole bytes (but can't be written)
+	rt::BitBuffer odd(13, 2, true);
+	assert(odd.rowbytes() == 2);
+	assert(odd.getPixel(12, 1) == true);
+	assert(!odd.valid());
+
+	gray.setPixel(3, 4, 200);
+	assert(gray.getPixel(3, 4) == 200);
+	assert(gray.data()[4 * 64 + 3] == 200);
+	assert(gray.setPixel(64, 0, 1) == 0);
+
+	bits.setPixel(9, 0, true);
+	assert(bits.data()[1] == 0x40);
+
+	return 1;
+}
+
+int test_draw_native()
+{
+	// drawing a gray image gives the same pixels as drawing the rgba image and converting it
+	rt::PixelBuffer pb(128, 96, 8, BLACK);
+	rt::GrayBuffer gray(128, 96, 0);
+
+	pb.drawSquareFilled(10, 10, 30, 20, WHITE);
+	gray.drawSquareFilled(10, 10, 30, 20, 255);
+	pb.drawLine(0, 95, 127, 0, GRAY);
+	gray.drawLine(0, 95, 127, 0, rt::Gray8::fromRGBA(GRAY));
+	pb.drawCircle(80, 50, 20, WHITE);
+	gray.drawCircle(80, 50, 20, 255);
+
+	rt::GrayBuffer converted(pb);
+	assert(converted.size() == gray.size());
+	assert(std::memcmp(converted.data(), gray.data(), gray.size()) == 0);
+
+	// premultiplied pixels are converted to straight alpha
+	rt::PixelBuffer premultiplied(8, 8, 32, rt::RGBAColor(200, 100, 50, 128));
+	premultiplied.premultiply();
+	assert(rt::RGBABuffer(premultiplied).getPixel(3, 3) == premultiplied.getPixel(3, 3));
+
+	// fill the inside of the circle, below the line
+	gray.floodFill(80, 50, 100);
+	assert(gray.getPixel(80, 50) == 100);
+	assert(gray.getPixel(80, 69) == 100);
+	assert(gray.getPixel(80, 70) == 255);
+	assert(gray.getPixel(80, 71) == 0);
+	assert(gray.getPixel(0, 0) == 0);
+
+	rt::GrayBuffer filled(128, 96, 0);
+	filled.drawCircleFilled(64, 48, 10, 9);
+	assert(filled.getPixel(64, 48) == 9);
+	assert(filled.getPixel(54, 48) == 9);
+	assert(filled.getPixel(53, 48) == 0);
+
+	// blending only changes formats with alpha
+	rt::RGBABuffer rgba(4, 4, BLACK);
+	rgba.drawSquareFilled(0, 0, 4, 4, rt::RGBAColor(255, 255, 255, 127));
+	assert(rgba.getPixel(1, 1).r > 100 && rgba.getPixel(1, 1).r < 150);
+
+	// flip + paste
+	rt::BitBuffer bits(16, 4, false);
+	bits.drawLine(0, 0, 15, 0, true);
+	bits.flipRows();
+	assert(bits.getPixel(5, 3) == true && bits.getPixel(5, 0) == false);
+	rt::BitBuffer brush(8, 2, true);
+	bits.paste(brush, 12, -1);
+	assert(bits.getPixel(12, 0) == true && bits.getPixel(11, 0) == false);
+
+	return 1;
+}
+
+int test_filters()
+{
+	rt::GrayBuffer gray(16, 1);
+	for (int x = 0; x < 16; x++) { gray.setPixel(x, 0, 64 + x * 4); }
+	gray.contrast_8();
+	assert(gray.getPixel(0, 0) == 0);
+	assert(gray.getPixel(15, 0) == 255);
+
+	gray.posterize_8(1);
+	for (int x = 0; x < 16; x++) {
+		assert(gray.getPixel(x, 0) == 0 || gray.getPixel(x, 0) == 255);
+	}
+
+	rt::RGBBuffer rgb(8, 8, rt::RGBColor(0, 0, 0));
+	rgb.setPixel(4, 4, rt::RGBColor(255, 255, 255));
+	rgb.blur();
+	assert(rgb.getPixel(4, 4).r > 0 && rgb.getPixel(4, 4).r < 255);
+	assert(rgb.getPixel(3, 3).r > 0);
+
+	return 1;
+}
+
+int test_files()
+{
+	rt::PixelBuffer pb(64, 48, 32);
+	for (int y = 0; y < pb.height(); y++) {
+		for (int x = 0; x < pb.width(); x++) {
+			pb.setPixel(x, y, rt::RGBAColor(x * 4, y * 5, x ^ y, 128 + x));
+		}
+	}
+
+	// same bytes as PixelBuffer::write for the bitdepth
+	const uint8_t bitdepths[] = { 1, 8, 16, 24, 32 };
+	for (uint8_t bitdepth : bitdepths) {
+		pb.bitdepth(bitdepth);
+		pb.write("imagebuffer_pb.pbf");
+		rt::PixelBuffer expected("imagebuffer_pb.pbf");
+
+		switch (bitdepth) {
+			case 1:  assert(rt::BitBuffer(pb).write("imagebuffer.pbf")); break;
+			case 8:  assert(rt::GrayBuffer(pb).write("imagebuffer.pbf")); break;
+			case 16: assert(rt::GrayAlphaBuffer(pb).write("imagebuffer.pbf")); break;
+			case 24: assert(rt::RGBBuffer(pb).write("imagebuffer.pbf")); break;
+			case 32: assert(rt::RGBABuffer(pb).write("imagebuffer.pbf")); break;
+		}
+		rt::PixelBuffer written("imagebuffer.pbf");
+		assert(written.bitdepth() == bitdepth);
+		assert(written.pixels() == expected.pixels());
+	}
+
+	// read in the native format, compressed, or converted from another bitdepth
+	pb.bitdepth(8);
+	pb.write("imagebuffer_pb.pbf");
+	rt::GrayBuffer gray("imagebuffer_pb.pbf");
+	assert(gray.valid());
+	assert(gray.toPixelBuffer().pixels() == rt::PixelBuffer("imagebuffer_pb.pbf").pixels());
+
+	gray.writeCompressed("imagebuffer_z.pbf", 7);
+	rt::GrayBuffer compressed("imagebuffer_z.pbf");
+	assert(std::memcmp(compressed.data(), gray.data(), gray.size()) == 0);
+
+	rt::RGBABuffer rgba("imagebuffer_pb.pbf");
+	assert(rgba.getPixel(5, 5) == rt::RGBAColor(gray.getPixel(5, 5), 255));
+
+	rt::GrayBuffer missing;
+	assert(missing.read("doesnotexist.pbf") == 0);
+
+	return 1;
+}
+
+int main(void)
+{
+	rt::run_unit_test("test_storage", test_storage);
+	rt::run_unit_test("test_draw_native", test_draw_native);
+	rt::run_unit_test("test_filters", test_filters);
+	rt::run_unit_test("test_files", test_files);
+
+	std::cout << "## finished ##" << std::endl;
+
+	return 0;
+}
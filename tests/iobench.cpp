@@ -0,0 +1,73 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+
+#include <pixelbuffer/parallel.h>
+#include <pixelbuffer/util.h>
+
+// Encode, decode, write and read a large frame with 1 to N threads.
+// usage: iobench [threads] [size]
+
+double seconds_since(std::chrono::time_point<std::chrono::high_resolution_clock> start)
+{
+	std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - start;
+	return duration.count();
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned maxthreads = std::max(4u, std::thread::hardware_concurrency());
+	if (argc > 1) { maxthreads = std::max(1, atoi(argv[1])); }
+	uint16_t size = 4096;
+	if (argc > 2) { size = std::max(8, std::min(65535, atoi(argv[2]) / 8 * 8)); }
+
+	rt::PixelBuffer pb(size, size, 32);
+	for (size_t i = 0; i < pb.pixels().size(); i++) {
+		pb.pixels()[i] = rt::RGBAColor(i, i >> 8, i >> 16, 255);
+	}
+	const double mb = pb.pixels().size() * sizeof(rt::RGBAColor) / 1024.0 / 1024.0;
+	std::cout << size << "x" << size << " pixels, " << mb << " MiB of RGBA" << std::endl;
+	std::cout << "hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+
+	const uint8_t bitdepths[] = { 1, 8, 24, 32 };
+	for (uint8_t bitdepth : bitdepths) {
+		pb.bitdepth(bitdepth);
+		std::vector<uint8_t> payload(rt::PixelBuffer::payloadSize(size, size, bitdepth));
+		std::vector<rt::RGBAColor> decoded(pb.pixels().size());
+		const size_t rowbytes = rt::PixelBuffer::payloadSize(size, 1, bitdepth);
+
+		std::cout << std::endl << "bitdepth " << (int) bitdepth << " (MiB/s of RGBA)" << std::endl;
+		std::cout << "threads    encode    decode     write      read" << std::endl;
+		for (unsigned threads = 1; threads <= maxthreads; threads *= 2) {
+			rt::ThreadPool pool(threads);
+
+			auto start = std::chrono::high_resolution_clock::now();
+			pool.runRanges(size, threads * 4, [&](size_t y0, size_t y1) {
+				rt::PixelBuffer::encodePixels(&pb.pixels()[y0 * size], &payload[y0 * rowbytes], (y1 - y0) * size, bitdepth);
+			});
+			double encode = seconds_since(start);
+
+			start = std::chrono::high_resolution_clock::now();
+			pool.runRanges(size, threads * 4, [&](size_t y0, size_t y1) {
+				rt::PixelBuffer::decodePixels(&payload[y0 * rowbytes], &decoded[y0 * size], (y1 - y0) * size, bitdepth);
+			});
+			double decode = seconds_since(start);
+
+			start = std::chrono::high_resolution_clock::now();
+			rt::writeParallel(pb, "iobench.pbf", pool);
+			double write = seconds_since(start);
+
+			rt::PixelBuffer read;
+			start = std::chrono::high_resolution_clock::now();
+			rt::readParallel(read, "iobench.pbf", pool);
+			double readtime = seconds_since(start);
+
+			std::cout << std::setw(7) << threads << std::fixed << std::setprecision(0);
+			std::cout << std::setw(10) << mb / encode << std::setw(10) << mb / decode;
+			std::cout << std::setw(10) << mb / write << std::setw(10) << mb / readtime << std::endl;
+		}
+	}
+
+	return 0;
+}
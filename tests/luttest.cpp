@@ -0,0 +1,168 @@
+#include <iostream>
+#include <cassert>
+#include <cstdlib>
+#include <vector>
+
+#include <pixelbuffer/lut.h>
+#include <pixelbuffer/pixelbuffer.h>
+#include <pixelbuffer/util.h>
+
+rt::PixelBuffer testimage(uint16_t width, uint16_t height)
+{
+	rt::PixelBuffer pb(width, height, 32);
+	for (auto& pixel : pb.pixels()) {
+		pixel = rt::RGBAColor(40 + rand() % 150, rand() % 256, 10 + rand() % 100, rand() % 256);
+	}
+	return pb;
+}
+
+int lut_tables()
+{
+	rt::LUT identity;
+	assert(identity.identity(rt::LUT::R) && identity.identity(rt::LUT::A));
+	assert(identity(rt::RGBAColor(1, 2, 3, 4)) == rt::RGBAColor(1, 2, 3, 4));
+
+	// the same as the color functions
+	const rt::LUT negative = rt::LUT::negative();
+	const rt::LUT quantize = rt::LUT::quantize(4);
+	const rt::LUT negative2 = rt::LUT::fromColor(rt::negative);
+	for (int i = 0; i < 10000; i++) {
+		const rt::RGBAColor color = rt::RGBAColor(rand() % 256, rand() % 256, rand() % 256, rand() % 256);
+		assert(negative(color) == rt::negative(color));
+		assert(negative2(color) == rt::negative(color));
+		assert(quantize(color) == rt::quantize(color, 4));
+	}
+
+	// a lambda, on alpha too
+	const rt::LUT half = rt::LUT::fromFunction([](uint8_t v) { return (uint8_t) (v / 2); }, true);
+	assert(half(rt::RGBAColor(200, 100, 50, 255)) == rt::RGBAColor(100, 50, 25, 127));
+	assert(!half.identity(rt::LUT::A));
+
+	// chained: one table
+	const rt::LUT both = negative.then(half);
+	assert(both(rt::RGBAColor(255, 0, 55, 255)) == rt::RGBAColor(0, 127, 100, 127));
+	assert(negative.then(negative).identity(rt::LUT::G));
+
+	// a channel of its own
+	rt::LUT red;
+	red.set(rt::LUT::R, [](uint8_t) { return (uint8_t) 255; });
+	assert(red(rt::RGBAColor(0, 10, 20, 30)) == rt::RGBAColor(255, 10, 20, 30));
+
+	assert(rt::LUT::stretch(50, 150)(rt::RGBAColor(50, 100, 150, 255)) == rt::RGBAColor(0, 127, 255, 255));
+	assert(rt::LUT::stretch(50, 150)(rt::RGBAColor(0, 255, 0, 0)) == rt::RGBAColor(0, 255, 0, 0));
+	assert(rt::LUT::stretch(9, 9)(rt::RGBAColor(9, 9, 9, 9)) == rt::RGBAColor(0, 0, 0, 9));
+	assert(rt::LUT::gamma(1.0f).identity(rt::LUT::B));
+	assert(rt::LUT::gamma(2.0f)(rt::RGBAColor(128, 255, 0)) == rt::RGBAColor(64, 255, 0));
+
+	return 1;
+}
+
+int lut_apply()
+{
+	rt::PixelBuffer pb = testimage(67, 41);
+	const rt::LUT luts[] = { rt::LUT::negative(), rt::LUT::fromFunction([](uint8_t v) { return (uint8_t) (v ^ 0x5A); }, true) };
+	for (const rt::LUT& lut : luts) {
+		// spans of any length
+		for (size_t count = 0; count < 20; count++) {
+			std::vector<rt::RGBAColor> pixels(pb.pixels().begin(), pb.pixels().begin() + count);
+			lut.apply(pixels.data(), pixels.size());
+			for (size_t i = 0; i < count; i++) {
+				assert(pixels[i] == lut(pb.pixels()[i]));
+			}
+		}
+
+		// a buffer, a view
+		rt::PixelBuffer copy = pb;
+		copy.apply(lut);
+		for (size_t i = 0; i < pb.pixels().size(); i++) {
+			assert(copy.pixels()[i] == lut(pb.pixels()[i]));
+		}
+		copy = pb;
+		copy.view(10, 10, 5, 5).apply(lut);
+		assert(copy.getPixel(10, 10) == lut(pb.getPixel(10, 10)));
+		assert(copy.getPixel(9, 10) == pb.getPixel(9, 10));
+	}
+
+	// premultiplied pixels are converted
+	rt::PixelBuffer opaque(8, 8, 32, rt::RGBAColor(10, 20, 30, 255));
+	opaque.premultiply();
+	opaque.apply(rt::LUT::negative());
+	assert(opaque.getPixel(3, 3) == rt::RGBAColor(245, 235, 225, 255));
+
+	return 1;
+}
+
+int lut_filters()
+{
+	rt::PixelBuffer pb = testimage(100, 40);
+
+	// contrast_8 and posterize_8 give the same pixels as before (rt::map per pixel)
+	rt::PixelBuffer contrast = pb;
+	contrast.contrast_8();
+	uint8_t min = 255;
+	uint8_t max = 0;
+	for (const auto& pixel : pb.pixels()) {
+		min = std::min(min, pixel.r);
+		max = std::max(max, pixel.r);
+	}
+	for (size_t i = 0; i < pb.pixels().size(); i++) {
+		const uint8_t value = rt::map(pb.pixels()[i].r, min, max, 0, 255);
+		assert(contrast.pixels()[i] == rt::RGBAColor(value, value, value, 255));
+	}
+	for (uint8_t levels = 1; levels < 12; levels++) {
+		rt::PixelBuffer posterized = pb;
+		posterized.posterize_8(levels);
+		for (size_t i = 0; i < pb.pixels().size(); i++) {
+			uint8_t value = rt::map(pb.pixels()[i].r, 0, 255, 0, levels);
+			value = rt::map(value, 0, levels, 0, 255);
+			assert(posterized.pixels()[i] == rt::RGBAColor(value, value, value, 255));
+		}
+	}
+
+	// on every channel, alpha stays
+	rt::PixelBuffer stretched = pb;
+	stretched.contrast();
+	uint8_t lo[3] = { 255, 255, 255 };
+	uint8_t hi[3] = { 0, 0, 0 };
+	for (const auto& pixel : stretched.pixels()) {
+		lo[0] = std::min(lo[0], pixel.r); hi[0] = std::max(hi[0], pixel.r);
+		lo[1] = std::min(lo[1], pixel.g); hi[1] = std::max(hi[1], pixel.g);
+		lo[2] = std::min(lo[2], pixel.b); hi[2] = std::max(hi[2], pixel.b);
+	}
+	for (int c = 0; c < 3; c++) {
+		assert(lo[c] == 0 && hi[c] == 255);
+	}
+	assert(stretched.getPixel(3, 3).a == pb.getPixel(3, 3).a);
+
+	// a channel with a single value stays as it is
+	rt::PixelBuffer gradient(256, 4, 32);
+	for (int x = 0; x < 256; x++) {
+		gradient.view(x, 0, 1, 4).fill(rt::RGBAColor(64 + x / 2, 200, 255, 255));
+	}
+	gradient.contrast();
+	assert(gradient.getPixel(0, 0) == rt::RGBAColor(0, 200, 255, 255));
+	assert(gradient.getPixel(255, 3) == rt::RGBAColor(255, 200, 255, 255));
+	rt::PixelBuffer flat(8, 8, 32, rt::RGBAColor(10, 20, 30, 40));
+	flat.contrast();
+	assert(flat.getPixel(4, 4) == rt::RGBAColor(10, 20, 30, 40));
+
+	rt::PixelBuffer posterized = pb;
+	posterized.posterize(1);
+	for (const auto& pixel : posterized.pixels()) {
+		assert(pixel.r % 255 == 0 && pixel.g % 255 == 0 && pixel.b % 255 == 0);
+	}
+
+	return 1;
+}
+
+int main(void)
+{
+	srand(42);
+	rt::run_unit_test("lut_tables", lut_tables);
+	rt::run_unit_test("lut_apply", lut_apply);
+	rt::run_unit_test("lut_filters", lut_filters);
+
+	std::cout << "## finished ##" << std::endl;
+
+	return 0;
+}
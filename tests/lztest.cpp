@@ -0,0 +1,80 @@
+#include <iostream>
+#include <cassert>
+#include <vector>
+
+#include <pixelbuffer/lz.h>
+#include <pixelbuffer/util.h>
+
+bool roundtrip(const std::vector<uint8_t>& data)
+{
+	std::vector<uint8_t> compressed;
+	size_t size = rt::lz_compress(data.data(), data.size(), compressed);
+	assert(size == compressed.size());
+
+	std::vector<uint8_t> decompressed(data.size());
+	size_t out = rt::lz_decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size());
+	return out == data.size() && decompressed == data;
+}
+
+int test_lz_roundtrip()
+{
+	// short inputs are all literals
+	for (size_t n = 1; n < 40; n++) {
+		std::vector<uint8_t> data(n);
+		for (size_t i = 0; i < n; i++) { data[i] = i * 7; }
+		assert(roundtrip(data));
+	}
+
+	// random (incompressible) data, long literal runs
+	std::vector<uint8_t> random(100000);
+	for (size_t i = 0; i < random.size(); i++) { random[i] = rand() % 256; }
+	assert(roundtrip(random));
+
+	// repeating patterns, overlapping and long matches
+	std::vector<uint8_t> pattern(100000);
+	for (size_t i = 0; i < pattern.size(); i++) { pattern[i] = (i % 3 == 0) ? 255 : 12; }
+	assert(roundtrip(pattern));
+
+	return 1;
+}
+
+int test_lz_ratio()
+{
+	std::vector<uint8_t> flat(1 << 20, 42);
+	std::vector<uint8_t> compressed;
+	rt::lz_compress(flat.data(), flat.size(), compressed);
+	assert(compressed.size() < flat.size() / 100);
+
+	return 1;
+}
+
+int test_lz_corrupt()
+{
+	std::vector<uint8_t> data(1000, 7);
+	std::vector<uint8_t> compressed;
+	rt::lz_compress(data.data(), data.size(), compressed);
+
+	std::vector<uint8_t> out(data.size());
+	// wrong expected size
+	assert(rt::lz_decompress(compressed.data(), compressed.size(), out.data(), out.size() - 1) == 0);
+	// truncated input
+	assert(rt::lz_decompress(compressed.data(), compressed.size() / 2, out.data(), out.size()) == 0);
+	// offset pointing before the start of the output
+	uint8_t bad[] = { 0x10, 'a', 0x05, 0x00 };
+	assert(rt::lz_decompress(bad, sizeof(bad), out.data(), out.size()) == 0);
+
+	return 1;
+}
+
+int main(void)
+{
+	srand(time(nullptr));
+
+	rt::run_unit_test("test_lz_roundtrip", test_lz_roundtrip);
+	rt::run_unit_test("test_lz_ratio", test_lz_ratio);
+	rt::run_unit_test("test_lz_corrupt", test_lz_corrupt);
+
+	std::cout << "## finished ##" << std::endl;
+
+	return 0;
+}
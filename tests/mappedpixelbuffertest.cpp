@@ -0,0 +1,85 @@
+#include <iostream>
+#include <cassert>
+
+#include <pixelbuffer/mappedpixelbuffer.h>
+#include <pixelbuffer/util.h>
+
+rt::PixelBuffer create_pattern(uint8_t bitdepth)
+{
+	rt::PixelBuffer pb(16, 8, bitdepth, BLACK);
+	pb.drawLine(0, 0, 15, 7, WHITE);
+	pb.setPixel(3, 5, rt::RGBAColor(12, 34, 56, 78));
+	return pb;
+}
+
+int test_map_32()
+{
+	rt::PixelBuffer pb = create_pattern(32);
+	pb.write("mapped32.pbf");
+
+	rt::MappedPixelBuffer mapped("mapped32.pbf");
+	assert(mapped.valid());
+	assert(mapped.width() == 16);
+	assert(mapped.height() == 8);
+	assert(mapped.bitdepth() == 32);
+	assert(mapped.pixels() != nullptr);
+
+	for (int y = 0; y < pb.height(); y++) {
+		for (int x = 0; x < pb.width(); x++) {
+			assert(mapped.getPixel(x, y) == pb.getPixel(x, y));
+			assert(mapped.pixels()[y * 16 + x] == pb.getPixel(x, y));
+		}
+	}
+	assert(mapped.getPixel(16, 0) == rt::RGBAColor(0, 0, 0, 0));
+
+	return 1;
+}
+
+int test_map_bitdepths()
+{
+	const uint8_t bitdepths[] = { 1, 8, 16, 24 };
+	for (uint8_t bitdepth : bitdepths) {
+		rt::PixelBuffer pb = create_pattern(bitdepth);
+		pb.write("mappedbd.pbf");
+
+		rt::PixelBuffer read("mappedbd.pbf");
+		rt::MappedPixelBuffer mapped("mappedbd.pbf");
+		assert(mapped.valid());
+		assert(mapped.pixels() == nullptr);
+		assert(mapped.bitdepth() == bitdepth);
+
+		rt::PixelBuffer decoded = mapped.toPixelBuffer();
+		std::vector<rt::RGBAColor> row(mapped.width());
+		for (int y = 0; y < pb.height(); y++) {
+			mapped.decodeRow(y, row.data());
+			for (int x = 0; x < pb.width(); x++) {
+				assert(mapped.getPixel(x, y) == read.getPixel(x, y));
+				assert(decoded.getPixel(x, y) == read.getPixel(x, y));
+				assert(row[x] == read.getPixel(x, y));
+			}
+		}
+	}
+
+	return 1;
+}
+
+int test_map_invalid()
+{
+	rt::MappedPixelBuffer mapped("doesnotexist.pbf");
+	assert(!mapped.valid());
+	assert(mapped.width() == 0);
+	assert(mapped.getPixel(0, 0) == rt::RGBAColor(0, 0, 0, 0));
+
+	return 1;
+}
+
+int main(void)
+{
+	rt::run_unit_test("test_map_32", test_map_32);
+	rt::run_unit_test("test_map_bitdepths", test_map_bitdepths);
+	rt::run_unit_test("test_map_invalid", test_map_invalid);
+
+	std::cout << "## finished ##" << std::endl;
+
+	return 0;
+}
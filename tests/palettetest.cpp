@@ -0,0 +1,182 @@
+#include <iostream>
+#include <cassert>
+#include <cstdlib>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+#include <pixelbuffer/palette.h>
+#include <pixelbuffer/pixelbuffer.h>
+#include <pixelbuffer/util.h>
+
+rt::PixelBuffer testimage(uint16_t width, uint16_t height)
+{
+	rt::PixelBuffer pb(width, height, 32);
+	for (auto& pixel : pb.pixels()) {
+		pixel = rt::RGBAColor(rand() % 256, rand() % 256, rand() % 256, 255);
+	}
+	return pb;
+}
+
+size_t filesize(const std::string& filename)
+{
+	std::ifstream file(filename, std::fstream::in|std::fstream::binary|std::fstream::ate);
+	return file.tellg();
+}
+
+int palette_mediancut()
+{
+	// an image with fewer than 256 colors is kept as it is
+	// (close colors share a cell of the inverse map)
+	rt::PixelBuffer few(64, 32, 32, rt::RGBAColor(10, 10, 10, 255));
+	few.drawSquareFilled(4, 4, 8, 8, rt::RGBAColor(12, 12, 12, 255));
+	few.drawSquareFilled(20, 4, 8, 8, rt::RGBAColor(13, 11, 10, 255));
+	few.drawCircleFilled(40, 16, 10, rt::RGBAColor(200, 50, 20, 128));
+	few.view(50, 0, 14, 32).fill(rt::RGBAColor(0, 0, 0, 0));
+	for (int i = 0; i < 100; i++) {
+		few.setPixel(i % 64, 31, rt::RGBAColor(i * 2, 255 - i, i, 255));
+	}
+	rt::Palette palette = rt::Palette::medianCut(few);
+	assert(palette.size() <= 256);
+	rt::PixelBuffer remapped = few;
+	palette.remap(remapped);
+	assert(remapped.pixels() == few.pixels());
+
+	// 1 color, and no more colors than asked for
+	assert(rt::Palette::medianCut(rt::PixelBuffer(8, 8, 32, RED)).size() == 1);
+	assert(rt::Palette::medianCut(rt::PixelBuffer(8, 8, 32, RED), 0).size() == 1);
+	rt::PixelBuffer many = testimage(128, 128);
+	assert(rt::Palette::medianCut(many).size() == 256);
+	assert(rt::Palette::medianCut(many, 16).size() == 16);
+
+	// the colors are close to the image
+	palette = rt::Palette::medianCut(many, 256);
+	double error = 0;
+	for (const auto& pixel : many.pixels()) {
+		const rt::RGBAColor& color = palette[palette.index(pixel)];
+		error += std::abs(color.r - pixel.r) + std::abs(color.g - pixel.g) + std::abs(color.b - pixel.b);
+	}
+	assert(error / (many.pixels().size() * 3) < 24);
+
+	return 1;
+}
+
+int palette_index()
+{
+	rt::Palette palette = rt::Palette::medianCut(testimage(64, 64), 64);
+	for (const auto& color : palette.colors()) {
+		assert(palette[palette.index(color)] == color);
+	}
+
+	// the center of each cell: the same as an exact search
+	for (int r = 4; r < 256; r += 8) {
+		for (int g = 4; g < 256; g += 8) {
+			for (int b = 4; b < 256; b += 8) {
+				const rt::RGBAColor color(r, g, b, 255);
+				assert(palette[palette.index(color)] == palette[palette.nearest(color)]);
+			}
+		}
+	}
+
+	// not opaque: exact, fully transparent: (0, 0, 0, 0)
+	std::vector<rt::RGBAColor> colors = { RED, rt::RGBAColor(255, 0, 0, 100), rt::RGBAColor(0, 0, 0, 0), WHITE };
+	rt::Palette small(colors);
+	assert(small.index(rt::RGBAColor(250, 0, 0, 110)) == 1);
+	assert(small.index(rt::RGBAColor(255, 255, 255, 0)) == 2);
+	assert(small.index(rt::RGBAColor(250, 250, 250, 255)) == 3);
+	assert(rt::Palette().nearest(RED) == 0);
+
+	return 1;
+}
+
+int palette_indexed()
+{
+	rt::PixelBuffer pb = testimage(100, 60);
+	pb.drawCircleFilled(50, 30, 20, rt::RGBAColor(0, 100, 200, 128));
+	rt::IndexedBuffer indexed(pb, 200);
+	assert(indexed.valid());
+	assert(indexed.width() == 100 && indexed.height() == 60);
+	assert(indexed.palette().size() == 200);
+	const rt::PixelBuffer decoded = indexed.toPixelBuffer();
+	for (int y = 0; y < 60; y++) {
+		for (int x = 0; x < 100; x++) {
+			assert(decoded.getPixel(x, y) == indexed.getPixel(x, y));
+		}
+	}
+	assert(indexed.getPixel(100, 0) == rt::RGBAColor(0, 0, 0, 0));
+
+	// write and read, as an IndexedBuffer and as a PixelBuffer
+	assert(indexed.write("indexed.pbf"));
+	assert(filesize("indexed.pbf") == 8 + 4 + 200 * 4 + 100 * 60);
+	rt::IndexedBuffer read("indexed.pbf");
+	assert(read.valid());
+	assert(read.indices() == indexed.indices());
+	assert(read.palette().colors() == indexed.palette().colors());
+	rt::PixelBuffer full("indexed.pbf");
+	assert(full.valid());
+	assert(full.bitdepth() == 32);
+	assert(full.pixels() == decoded.pixels());
+	rt::PixelBuffer frommemory;
+	std::ifstream file("indexed.pbf", std::fstream::in|std::fstream::binary);
+	std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	assert(frommemory.read(data.data(), data.size()));
+	assert(frommemory.pixels() == decoded.pixels());
+
+	// a quarter of a 32 bit pbf
+	pb.write("full.pbf");
+	assert(filesize("indexed.pbf") * 3 < filesize("full.pbf"));
+
+	// an image with few colors is lossless
+	rt::PixelBuffer few(50, 50, 32, BLUE);
+	few.drawCircleFilled(25, 25, 10, YELLOW);
+	rt::IndexedBuffer(few).write("indexed.pbf");
+	assert(rt::PixelBuffer("indexed.pbf").pixels() == few.pixels());
+
+	// premultiplied pixels are straight in the palette
+	rt::PixelBuffer premultiplied(8, 8, 32, rt::RGBAColor(200, 100, 50, 128));
+	premultiplied.premultiply();
+	assert(rt::IndexedBuffer(premultiplied).getPixel(1, 1) == rt::unpremultiply(premultiplied.pixels()[0]));
+
+	// invalid files
+	data.resize(data.size() - 1);
+	assert(frommemory.read(data.data(), data.size()) == 0);
+	std::ofstream truncated("truncated.pbf", std::fstream::out|std::fstream::binary|std::fstream::trunc);
+	truncated.write((const char*)data.data(), 10);
+	truncated.close();
+	assert(rt::IndexedBuffer("truncated.pbf").valid() == false);
+	assert(rt::IndexedBuffer("full.pbf").valid() == false);
+	assert(rt::IndexedBuffer().write("invalid.pbf") == 0);
+
+	// an index that is not in the palette: both readers reject the file
+	rt::IndexedBuffer(few, 2).write("corrupt.pbf");
+	std::fstream corrupt("corrupt.pbf", std::fstream::in|std::fstream::out|std::fstream::binary);
+	corrupt.seekp(8 + 4 + 2 * 4 + 1234);
+	corrupt.put((char) 2);
+	corrupt.close();
+	assert(rt::IndexedBuffer("corrupt.pbf").valid() == false);
+	rt::PixelBuffer corrupted;
+	assert(corrupted.read("corrupt.pbf") == 0);
+	assert(corrupted.width() == 0 && corrupted.pixels().empty());
+	std::ifstream corruptfile("corrupt.pbf", std::fstream::in|std::fstream::binary);
+	std::vector<uint8_t> corruptdata((std::istreambuf_iterator<char>(corruptfile)), std::istreambuf_iterator<char>());
+	assert(corrupted.read(corruptdata.data(), corruptdata.size()) == 0);
+
+	std::remove("indexed.pbf");
+	std::remove("full.pbf");
+	std::remove("truncated.pbf");
+	std::remove("corrupt.pbf");
+
+	return 1;
+}
+
+int main(void)
+{
+	srand(42);
+	rt::run_unit_test("palette_mediancut", palette_mediancut);
+	rt::run_unit_test("palette_index", palette_index);
+	rt::run_unit_test("palette_indexed", palette_indexed);
+
+	std::cout << "## finished ##" << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,80 @@
+#include <iostream>
+#include <cassert>
+#include <atomic>
+
+#include <pixelbuffer/parallel.h>
+#include <pixelbuffer/util.h>
+
+int test_threadpool()
+{
+	const unsigned counts[] = { 1, 2, 5 };
+	for (unsigned threads : counts) {
+		rt::ThreadPool pool(threads);
+		assert(pool.size() == threads);
+
+		for (int repeat = 0; repeat < 20; repeat++) {
+			std::vector<int> hits(1000, 0);
+			pool.run(hits.size(), [&](size_t i) { hits[i]++; });
+			for (int hit : hits) { assert(hit == 1); }
+		}
+
+		std::atomic<size_t> total(0);
+		pool.runRanges(1001, 7, [&](size_t begin, size_t end) {
+			assert(begin < end);
+			for (size_t i = begin; i < end; i++) { total += i; }
+		});
+		assert(total == 1000 * 1001 / 2);
+	}
+
+	return 1;
+}
+
+int test_parallel_read_write()
+{
+	rt::PixelBuffer pb(256, 203, 32);
+	for (int y = 0; y < pb.height(); y++) {
+		for (int x = 0; x < pb.width(); x++) {
+			pb.setPixel(x, y, rt::RGBAColor(x, y, x ^ y, 255 - y));
+		}
+	}
+
+	rt::ThreadPool pool(4);
+	const uint8_t bitdepths[] = { 1, 8, 16, 24, 32 };
+	for (uint8_t bitdepth : bitdepths) {
+		pb.bitdepth(bitdepth);
+		pb.write("serial.pbf");
+		rt::PixelBuffer serial("serial.pbf");
+
+		// parallel write, serial read
+		assert(rt::writeParallel(pb, "parallel.pbf", pool) == 1);
+		rt::PixelBuffer read("parallel.pbf");
+		assert(read.bitdepth() == bitdepth);
+		assert(read.pixels() == serial.pixels());
+
+		// serial write, parallel read
+		rt::PixelBuffer parallel;
+		assert(rt::readParallel(parallel, "serial.pbf", pool) > 0);
+		assert(parallel.bitdepth() == bitdepth);
+		assert(parallel.pixels() == serial.pixels());
+
+		// compressed
+		pb.writeCompressed("parallelcompressed.pbf", 16);
+		assert(rt::readParallel(parallel, "parallelcompressed.pbf", pool) > 0);
+		assert(parallel.pixels() == serial.pixels());
+	}
+
+	rt::PixelBuffer invalid;
+	assert(rt::readParallel(invalid, "doesnotexist.pbf", pool) == 0);
+
+	return 1;
+}
+
+int main(void)
+{
+	rt::run_unit_test("test_threadpool", test_threadpool);
+	rt::run_unit_test("test_parallel_read_write", test_parallel_read_write);
+
+	std::cout << "## finished ##" << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,79 @@
+#include <iostream>
+#include <cassert>
+
+#include <pixelbuffer/pbfcontainer.h>
+#include <pixelbuffer/util.h>
+
+rt::PixelBuffer create_frame(int n)
+{
+	rt::PixelBuffer pb(40 + n, 30, (n % 2) ? 24 : 32, BLACK);
+	pb.drawCircle(20, 15, n % 14, rt::RGBAColor(n * 8, 255 - n * 8, 128));
+	pb.setPixel(n % 40, 0, WHITE);
+	return pb;
+}
+
+int test_container()
+{
+	const int frames = 30;
+	{
+		rt::PbfContainerWriter writer("animation.pba");
+		assert(writer.isOpen());
+		for (int i = 0; i < frames; i++) {
+			assert(writer.append(create_frame(i), i % 3 == 0) == (size_t) i + 1);
+		}
+		assert(writer.frames() == frames);
+		assert(writer.close() == 1);
+	}
+
+	rt::PbfContainerReader reader("animation.pba");
+	assert(reader.isOpen());
+	assert(reader.frames() == frames);
+
+	// random access
+	rt::PixelBuffer pb;
+	const int order[] = { 17, 3, 29, 0, 12 };
+	for (int n : order) {
+		assert(reader.frame(n, pb) == 1);
+		assert(pb.width() == 40 + n);
+		assert(pb.pixels() == create_frame(n).pixels());
+	}
+	assert(reader.frame(frames, pb) == 0);
+
+	// sequential
+	reader.seek(10);
+	int n = 10;
+	while (reader.next(pb)) {
+		assert(pb.pixels() == create_frame(n).pixels());
+		n++;
+	}
+	assert(n == frames);
+
+	return 1;
+}
+
+int test_container_invalid()
+{
+	rt::PixelBuffer pb(8, 8);
+	pb.write("notacontainer.pba");
+	rt::PbfContainerReader reader;
+	assert(reader.open("notacontainer.pba") == 0);
+	assert(reader.frames() == 0);
+
+	rt::PbfContainerWriter writer("empty.pba");
+	writer.close();
+	assert(reader.open("empty.pba") > 0);
+	assert(reader.frames() == 0);
+	assert(reader.next(pb) == 0);
+
+	return 1;
+}
+
+int main(void)
+{
+	rt::run_unit_test("test_container", test_container);
+	rt::run_unit_test("test_container_invalid", test_container_invalid);
+
+	std::cout << "## finished ##" << std::endl;
+
+	return 0;
+}
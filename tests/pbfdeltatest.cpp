@@ -0,0 +1,167 @@
+#include <iostream>
+#include <cassert>
+
+#include <pixelbuffer/pbfdelta.h>
+#include <pixelbuffer/util.h>
+
+// a few moving particles on a static background
+rt::PixelBuffer simulate(int n, uint8_t bitdepth = 32)
+{
+	rt::PixelBuffer pb(200, 120, bitdepth, BLUE);
+	for (int y = 0; y < 120; y += 10) {
+		pb.drawLine(0, y, 199, y, GRAY);
+	}
+	for (int i = 0; i < 5; i++) {
+		pb.drawCircle(20 + i * 35 + n, 60 + i * 3, 4, rt::RGBAColor(255, i * 50, 0));
+	}
+	return pb;
+}
+
+int test_delta_frame()
+{
+	rt::PixelBuffer previous = simulate(0);
+	rt::PixelBuffer current = simulate(1);
+
+	std::vector<uint8_t> delta;
+	size_t tiles = rt::encodeDelta(previous, current, 16, delta);
+	assert(tiles > 0);
+	assert(tiles < 13 * 8 / 2);
+
+	assert(rt::applyDelta(delta.data(), delta.size(), previous) == 1);
+	assert(previous.pixels() == current.pixels());
+
+	// nothing changed
+	delta.clear();
+	assert(rt::encodeDelta(current, current, 16, delta) == 0);
+	assert(!delta.empty());
+
+	// a size, bitdepth or tilesize mismatch encodes nothing
+	delta.clear();
+	rt::PixelBuffer smaller(100, 60, 32, BLUE);
+	rt::PixelBuffer gray = simulate(1, 8);
+	assert(rt::encodeDelta(smaller, current, 16, delta) == 0);
+	assert(rt::encodeDelta(current, smaller, 16, delta) == 0);
+	assert(rt::encodeDelta(gray, current, 16, delta) == 0);
+	assert(rt::encodeDelta(previous, current, 0, delta) == 0);
+	assert(rt::encodeDelta(previous, current, 12, delta) == 0);
+	assert(delta.empty());
+
+	return 1;
+}
+
+int test_delta_sequence()
+{
+	const int frames = 40;
+	size_t fullsize = 0;
+	{
+		rt::DeltaSequenceWriter writer("delta.pba", 16, 16);
+		assert(writer.isOpen());
+		for (int i = 0; i < frames; i++) {
+			assert(writer.append(simulate(i)) == 1);
+			fullsize += sizeof(rt::PixelBuffer::PBHeader) + 200 * 120 * 4;
+		}
+		assert(writer.frames() == frames);
+		assert(writer.keyframes() == 3);
+		assert(writer.close() == 1);
+	}
+
+	std::ifstream file("delta.pba", std::fstream::binary|std::fstream::ate);
+	size_t size = file.tellg();
+	assert(size * 10 < fullsize);
+
+	rt::DeltaSequenceReader reader("delta.pba");
+	assert(reader.frames() == frames);
+
+	// sequential
+	rt::PixelBuffer pb;
+	int n = 0;
+	while (reader.next(pb)) {
+		assert(pb.pixels() == simulate(n).pixels());
+		n++;
+	}
+	assert(n == frames);
+
+	// random access, backwards and forwards
+	const int order[] = { 37, 5, 20, 21, 21, 0, 33 };
+	for (int i : order) {
+		assert(reader.frame(i, pb) == 1);
+		assert(pb.pixels() == simulate(i).pixels());
+	}
+
+	return 1;
+}
+
+int test_delta_bitdepths()
+{
+	const uint8_t bitdepths[] = { 1, 8, 16, 24 };
+	for (uint8_t bitdepth : bitdepths) {
+		rt::DeltaSequenceWriter writer("deltabd.pba", 4, 8);
+		for (int i = 0; i < 10; i++) {
+			assert(writer.append(simulate(i, bitdepth)) == 1);
+		}
+		writer.close();
+
+		rt::DeltaSequenceReader reader("deltabd.pba");
+		rt::PixelBuffer pb;
+		for (int i = 0; i < 10; i++) {
+			simulate(i, bitdepth).write("deltabd.pbf");
+			rt::PixelBuffer expected("deltabd.pbf");
+			assert(reader.next(pb) == 1);
+			assert(pb.bitdepth() == bitdepth);
+			assert(pb.pixels() == expected.pixels());
+		}
+	}
+
+	return 1;
+}
+
+int test_delta_premultiplied()
+{
+	// premultiplied frames: keyframes and delta frames are both straight alpha
+	std::vector<rt::PixelBuffer> expected;
+	{
+		rt::DeltaSequenceWriter writer("deltapm.pba", 4, 16);
+		for (int i = 0; i < 8; i++) {
+			rt::PixelBuffer frame = simulate(i);
+			frame.view(i * 10, 20, 30, 30).fill(rt::RGBAColor(200, 100, 50, 128));
+			frame.premultiply();
+			assert(writer.append(frame) == 1);
+			frame.unpremultiply();
+			expected.push_back(frame);
+		}
+		assert(writer.keyframes() == 2);
+		writer.close();
+	}
+	rt::DeltaSequenceReader reader("deltapm.pba");
+	rt::PixelBuffer pb;
+	for (int i = 0; i < 8; i++) {
+		assert(reader.next(pb) == 1);
+		assert(!pb.premultiplied());
+		assert(pb.pixels() == expected[i].pixels());
+	}
+	assert(pb.getPixel(75, 25) == expected[7].getPixel(75, 25) && pb.getPixel(75, 25).r > 150);
+
+	// a delta applied to a premultiplied frame stays premultiplied
+	std::vector<uint8_t> delta;
+	rt::encodeDelta(expected[0], expected[1], 16, delta);
+	rt::PixelBuffer frame = expected[0];
+	frame.premultiply();
+	assert(rt::applyDelta(delta.data(), delta.size(), frame) == 1);
+	rt::PixelBuffer premultiplied = expected[1];
+	premultiplied.premultiply();
+	assert(frame.premultiplied() && frame.pixels() == premultiplied.pixels());
+
+	return 1;
+}
+
+int main(void)
+{
+	rt::run_unit_test("test_delta_frame", test_delta_frame);
+	rt::run_unit_test("test_delta_sequence", test_delta_sequence);
+	rt::run_unit_test("test_delta_bitdepths", test_delta_bitdepths);
+	rt::run_unit_test("test_delta_premultiplied", test_delta_premultiplied);
+
+	std::cout << "## finished ##" << std::endl;
+
+	return 0;
+}
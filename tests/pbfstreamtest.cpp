@@ -0,0 +1,157 @@
+#include <iostream>
+#include <cassert>
+
+#include <pixelbuffer/pbfstream.h>
+#include <pixelbuffer/util.h>
+
+rt::RGBAColor gradient(int x, int y)
+{
+	return rt::RGBAColor(x % 256, y % 256, (x + y) % 256, 255 - (x % 256));
+}
+
+int test_stream_write()
+{
+	const uint16_t width = 320;
+	const uint16_t height = 200;
+	const size_t band = 16;
+
+	const uint8_t bitdepths[] = { 1, 8, 16, 24, 32 };
+	for (uint8_t bitdepth : bitdepths) {
+		rt::PbfWriter writer("stream.pbf", width, height, bitdepth);
+		assert(writer.isOpen());
+
+		// only a band of rows is ever in memory
+		std::vector<rt::RGBAColor> rows(band * width);
+		while (writer.row() < height) {
+			size_t y0 = writer.row();
+			for (size_t y = 0; y < band; y++) {
+				for (size_t x = 0; x < width; x++) {
+					rows[y * width + x] = gradient(x, y0 + y);
+				}
+			}
+			assert(writer.writeRows(rows.data(), band) > 0);
+		}
+		assert(writer.close() == 1);
+
+		// compare with a PixelBuffer written the regular way
+		rt::PixelBuffer pb(width, height, bitdepth);
+		for (int y = 0; y < height; y++) {
+			for (int x = 0; x < width; x++) {
+				pb.setPixel(x, y, gradient(x, y));
+			}
+		}
+		pb.write("regular.pbf");
+
+		rt::PixelBuffer streamed("stream.pbf");
+		rt::PixelBuffer regular("regular.pbf");
+		assert(streamed.valid());
+		assert(streamed.pixels() == regular.pixels());
+	}
+
+	return 1;
+}
+
+int test_stream_read()
+{
+	rt::PixelBuffer pb(64, 37, 24);
+	for (int y = 0; y < pb.height(); y++) {
+		for (int x = 0; x < pb.width(); x++) {
+			pb.setPixel(x, y, gradient(x, y));
+		}
+	}
+	pb.write("streamread.pbf");
+	rt::PixelBuffer regular("streamread.pbf");
+
+	rt::PbfReader reader("streamread.pbf");
+	assert(reader.isOpen());
+	assert(reader.width() == 64);
+	assert(reader.height() == 37);
+	assert(reader.bitdepth() == 24);
+
+	std::vector<rt::RGBAColor> rows(5 * reader.width());
+	size_t total = 0;
+	size_t n = 0;
+	while ((n = reader.readRows(rows.data(), 5)) > 0) {
+		for (size_t i = 0; i < n * reader.width(); i++) {
+			assert(rows[i] == regular.pixels()[total * reader.width() + i]);
+		}
+		total += n;
+	}
+	assert(total == 37);
+
+	// random access to a row
+	assert(reader.seekRow(20) == 1);
+	assert(reader.readRows(rows.data(), 1) == 1);
+	for (size_t x = 0; x < reader.width(); x++) {
+		assert(rows[x] == regular.getPixel(x, 20));
+	}
+
+	return 1;
+}
+
+int test_stream_compressed()
+{
+	rt::PixelBuffer pb(100, 50, 16);
+	for (int y = 0; y < pb.height(); y++) {
+		for (int x = 0; x < pb.width(); x++) {
+			pb.setPixel(x, y, gradient(x / 10, y / 10));
+		}
+	}
+	pb.write("streamplain.pbf");
+	assert(pb.writeCompressed("streamcompressed.pbf", 8) == 1);
+	rt::PixelBuffer regular("streamplain.pbf");
+
+	rt::PbfReader reader("streamcompressed.pbf");
+	assert(reader.isOpen());
+	assert(reader.compressed());
+	assert(reader.bitdepth() == 16);
+
+	// random access: only the chunk with row 33 is decompressed
+	std::vector<rt::RGBAColor> rows(20 * reader.width());
+	assert(reader.seekRow(33) == 1);
+	assert(reader.readRows(rows.data(), 1) == 1);
+	for (size_t x = 0; x < reader.width(); x++) {
+		assert(rows[x] == regular.getPixel(x, 33));
+	}
+
+	// bands that span several chunks
+	assert(reader.seekRow(0) == 1);
+	size_t total = 0;
+	size_t n = 0;
+	while ((n = reader.readRows(rows.data(), 20)) > 0) {
+		for (size_t i = 0; i < n * reader.width(); i++) {
+			assert(rows[i] == regular.pixels()[total * reader.width() + i]);
+		}
+		total += n;
+	}
+	assert(total == 50);
+
+	return 1;
+}
+
+int test_stream_invalid()
+{
+	rt::PbfWriter writer;
+	assert(writer.open("invalid.pbf", 7, 2, 1) == 0); // 1 bit needs width%8 == 0
+	assert(writer.open("partial.pbf", 8, 2, 32) == 1);
+	std::vector<rt::RGBAColor> row(8);
+	writer.writeRows(row.data(), 1);
+	assert(writer.close() == 0); // only 1 of 2 rows written
+
+	rt::PbfReader reader;
+	assert(reader.open("partial.pbf") == 0);
+
+	return 1;
+}
+
+int main(void)
+{
+	rt::run_unit_test("test_stream_write", test_stream_write);
+	rt::run_unit_test("test_stream_read", test_stream_read);
+	rt::run_unit_test("test_stream_compressed", test_stream_compressed);
+	rt::run_unit_test("test_stream_invalid", test_stream_invalid);
+
+	std::cout << "## finished ##" << std::endl;
+
+	return 0;
+}
@@ -1,9 +1,26 @@
 #include <iostream>
 #include <cassert>
+#include <cstdlib>
+#include <new>
 
 #include <pixelbuffer/pixelbuffer.h>
 #include <pixelbuffer/util.h>
 
+// count heap allocations (see test_no_allocations)
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+	// operator delete frees what our operator new mallocs
+	#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+static size_t allocations = 0;
+void* operator new(size_t size)
+{
+	allocations++;
+	void* p = std::malloc(size > 0 ? size : 1);
+	if (p == nullptr) { throw std::bad_alloc(); }
+	return p;
+}
+void operator delete(void* p) noexcept { std::free(p); }
+
 // ########################################################
 int floodfill()
 {
@@ -178,6 +195,351 @@ int test_drawline()
 	return 1;
 }
 
+int test_read_write()
+{
+	rt::PixelBuffer pb = rt::PixelBuffer(16, 4, 32, BLACK);
+	pb.setPixel(0, 0, WHITE);
+	pb.setPixel(1, 0, rt::RGBAColor(200, 100, 50, 128));
+	pb.setPixel(8, 3, rt::RGBAColor(255, 255, 255, 64));
+	pb.drawLine(0, 2, 15, 2, rt::RGBAColor(10, 220, 30));
+
+	const uint8_t bitdepths[] = { 1, 8, 16, 24, 32 };
+	for (uint8_t bitdepth : bitdepths) {
+		pb.bitdepth(bitdepth);
+		assert(pb.write("readwrite.pbf") == 1);
+
+		rt::PixelBuffer read("readwrite.pbf");
+		assert(read.valid());
+		assert(read.bitdepth() == bitdepth);
+		assert(read.width() == 16);
+		assert(read.height() == 4);
+
+		for (int y = 0; y < pb.height(); y++) {
+			for (int x = 0; x < pb.width(); x++) {
+				rt::RGBAColor in = pb.getPixel(x, y);
+				rt::RGBAColor gray = rt::luminance(in);
+				rt::RGBAColor out = read.getPixel(x, y);
+				if (bitdepth == 1) {
+					bool white = (in.r + in.g + in.b) / 3 >= 128 && in.a >= 128;
+					assert(out == (white ? WHITE : BLACK));
+				}
+				if (bitdepth == 8) { assert(out == rt::RGBAColor(gray.r, 255)); }
+				if (bitdepth == 16) { assert(out == rt::RGBAColor(gray.r, in.a)); }
+				if (bitdepth == 24) { assert(out == rt::RGBAColor(in.r, in.g, in.b, 255)); }
+				if (bitdepth == 32) { assert(out == in); }
+			}
+		}
+	}
+
+	return 1;
+}
+
+int test_tga_rle()
+{
+	rt::PixelBuffer pb = rt::PixelBuffer(200, 20, 32, rt::RGBAColor(0, 0, 255, 255));
+	pb.drawSquareFilled(10, 5, 100, 10, rt::RGBAColor(255, 0, 0, 200));
+	for (int x = 0; x < 200; x += 3) {
+		pb.setPixel(x, 0, rt::RGBAColor(x, 255-x, 7, 255)); // short raw packets
+	}
+
+	const uint8_t bitdepths[] = { 24, 32 };
+	for (uint8_t bitdepth : bitdepths) {
+		pb.bitdepth(bitdepth);
+		assert(pb.writeTGA("plain.tga") == 1);
+		assert(pb.writeTGA("rle.tga", true) == 1);
+
+		rt::PixelBuffer plain;
+		rt::PixelBuffer rle;
+		int plainsize = plain.fromTGA("plain.tga");
+		int rlesize = rle.fromTGA("rle.tga");
+		assert(plainsize > 0);
+		assert(rlesize > 0);
+		assert(rlesize < plainsize / 5);
+		assert(rle.bitdepth() == bitdepth);
+		assert(rle.pixels() == plain.pixels());
+
+		if (bitdepth == 32) {
+			assert(rle.pixels() == pb.pixels());
+		}
+	}
+
+	return 1;
+}
+
+int test_compressed()
+{
+	rt::PixelBuffer pb = rt::PixelBuffer(304, 130, 32, BLACK);
+	pb.drawSquareFilled(20, 20, 200, 50, rt::RGBAColor(255, 0, 0, 200));
+	pb.drawCircle(150, 65, 40, YELLOW);
+	for (int x = 0; x < 304; x++) {
+		pb.setPixel(x, 100, rt::RGBAColor(rand() % 256, rand() % 256, rand() % 256, rand() % 256));
+	}
+
+	const uint8_t bitdepths[] = { 1, 8, 16, 24, 32 };
+	for (uint8_t bitdepth : bitdepths) {
+		pb.bitdepth(bitdepth);
+		assert(pb.write("plain.pbf") == 1);
+		assert(pb.writeCompressed("compressed.pbf", 16) == 1);
+
+		rt::PixelBuffer plain;
+		rt::PixelBuffer compressed;
+		int plainsize = plain.read("plain.pbf");
+		int compressedsize = compressed.read("compressed.pbf");
+		assert(compressedsize > 0);
+		assert(compressedsize < plainsize);
+		assert(compressed.valid());
+		assert(compressed.bitdepth() == bitdepth);
+		assert(compressed.pixels() == plain.pixels());
+	}
+
+	return 1;
+}
+
+int test_filled_shapes()
+{
+	rt::PixelBuffer pb = rt::PixelBuffer(64, 64, 32, BLACK);
+	pb.drawCircleFilled(30, 30, 10, RED);
+	assert(pb.getPixel(30, 30) == RED);
+	assert(pb.getPixel(40, 30) == RED && pb.getPixel(20, 30) == RED);
+	assert(pb.getPixel(30, 40) == RED && pb.getPixel(30, 20) == RED);
+	assert(pb.getPixel(41, 30) == BLACK && pb.getPixel(30, 19) == BLACK);
+	assert(pb.getPixel(38, 38) == BLACK);
+
+	// clipped at the edges, blended when not opaque
+	pb.drawSquareFilled(-5, 60, 10, 10, rt::RGBAColor(255, 255, 255, 127));
+	assert(pb.getPixel(0, 63).r > 100 && pb.getPixel(0, 63).r < 150);
+	assert(pb.getPixel(4, 60) == pb.getPixel(0, 63));
+	assert(pb.getPixel(5, 60) == BLACK);
+
+	// odd number of rows
+	rt::PixelBuffer flip = rt::PixelBuffer(3, 5, 32, BLACK);
+	flip.setPixel(1, 0, RED);
+	flip.setPixel(2, 2, GREEN);
+	flip.flipRows();
+	assert(flip.getPixel(1, 4) == RED);
+	assert(flip.getPixel(2, 2) == GREEN);
+	assert(flip.getPixel(1, 0) == BLACK);
+
+	rt::PixelBuffer part = pb.copy(25, 25, 10, 10);
+	assert(part.width() == 10 && part.getPixel(5, 5) == RED);
+
+	// cropping in place gives the same pixels
+	rt::PixelBuffer gradient(8, 8, 32);
+	for (int y = 0; y < 8; y++) {
+		for (int x = 0; x < 8; x++) { gradient.setPixel(x, y, rt::RGBAColor(x * 10, y * 10, 0, 255)); }
+	}
+	rt::PixelBuffer expected = gradient.copy(2, 2, 4, 4);
+	gradient.copy(2, 2, 4, 4, gradient);
+	assert(gradient.width() == 4 && gradient.height() == 4);
+	assert(gradient.getPixel(0, 0) == rt::RGBAColor(20, 20, 0, 255));
+	assert(gradient.pixels() == expected.pixels());
+	gradient.copy(2, 2, 4, 4, gradient);
+	assert(gradient.getPixel(0, 0) == rt::RGBAColor(40, 40, 0, 255) && gradient.getPixel(2, 0) == TRANSPARENT);
+
+	return 1;
+}
+
+int test_no_allocations()
+{
+	rt::PixelBuffer pb = rt::PixelBuffer(256, 256, 24, BLACK);
+	rt::PixelBuffer part;
+	pb.copy(10, 10, 32, 32, part);
+
+	// steady-state drawing
+	size_t before = allocations;
+	for (int i = 0; i < 100; i++) {
+		pb.drawSquareFilled(i, i, 50, 30, rt::RGBAColor(255, i, 0, 128));
+		pb.drawCircleFilled(128, 128, i % 40, RED);
+		pb.drawCircle(100, 100, 20, GREEN);
+		pb.floodFill(128, 128, BLUE);
+		pb.flipRows();
+		pb.copy(i, i, 32, 32, part);
+	}
+	assert(allocations == before);
+
+	// encoding reuses the scratch buffer
+	rt::ScratchBuffer scratch;
+	for (int i = 0; i < 10; i++) {
+		assert(pb.write("scratch.pbf", scratch) == 1);
+	}
+	assert(scratch.requests() == 10);
+	assert(scratch.allocations() == 1);
+	assert(rt::PixelBuffer("scratch.pbf").pixels() == rt::PixelBuffer(pb).pixels());
+
+	return 1;
+}
+
+int test_move_copy_on_write()
+{
+	rt::PixelBuffer a = rt::PixelBuffer(300, 200, 32, BLUE);
+	const rt::RGBAColor* data = a.pixels().data();
+
+	// moves take the pixels
+	size_t before = allocations;
+	rt::PixelBuffer b = std::move(a);
+	assert(b.pixels().data() == data);
+	assert(a.width() == 0 && a.valid());
+	a = std::move(b);
+	assert(a.pixels().data() == data);
+	assert(allocations == before);
+	b = std::move(a);
+
+	// copies get their own pixels
+	rt::PixelBuffer c = b;
+	assert(c.pixels().data() != b.pixels().data());
+	assert(c.pixels() == b.pixels());
+	assert(!c.shared() && !b.shared());
+	const rt::RGBAColor* cdata = c.pixels().data();
+	c = b; // same size: copied in place
+	assert(c.pixels().data() == cdata);
+
+	// copy-on-write copies share the pixels until one changes
+	b.copyOnWrite(true);
+	before = allocations;
+	rt::PixelBuffer d = b;
+	rt::PixelBuffer e = d;
+	assert(allocations == before);
+	assert(d.shared() && e.copyOnWrite());
+	assert(static_cast<const rt::PixelBuffer&>(d).pixels().data() == data);
+	d.setPixel(1, 1, RED);
+	assert(d.getPixel(1, 1) == RED);
+	assert(b.getPixel(1, 1) == BLUE && e.getPixel(1, 1) == BLUE);
+	assert(!d.shared() && b.shared());
+
+	// snapshots of any buffer
+	rt::PixelBuffer snapshot = c.snapshot();
+	assert(c.shared());
+	c.fill(RED);
+	assert(snapshot.getPixel(5, 5) == BLUE);
+	assert(c.getPixel(5, 5) == RED);
+	assert(!snapshot.shared() && !c.shared());
+
+	return 1;
+}
+
+// the area of check around x, y, one neighbour at a time (the original floodFill)
+void reference_fill(rt::PixelBuffer& pb, int x, int y, rt::RGBAColor color, rt::RGBAColor check)
+{
+	const int neighbours[4][2] = { {0,-1}, {1,0}, {0,1}, {-1,0} };
+	if (x > 0 && x < pb.width()-1 && y > 0 && y < pb.height()-1) {
+		for (size_t i = 0; i < 4; i++) {
+			const int nx = x + neighbours[i][0];
+			const int ny = y + neighbours[i][1];
+			if (pb.getPixel(nx, ny) == check) {
+				pb.setPixel(nx, ny, color);
+				reference_fill(pb, nx, ny, color, check);
+			}
+		}
+	}
+}
+
+int test_fast_access()
+{
+	rt::PixelBuffer pb(40, 30, 32, BLACK);
+	pb.row(3)[5] = RED;
+	assert(pb.getPixel(5, 3) == RED);
+	assert(&pb.at(5, 3) == pb.row(3) + 5);
+	const rt::PixelBuffer& cpb = pb;
+	assert(cpb.at(5, 3) == RED && cpb.row(29) == &cpb.pixels()[29 * 40]);
+
+	// writing through row() copies shared pixels first
+	pb.copyOnWrite(true);
+	rt::PixelBuffer copy = pb;
+	copy.row(0)[0] = BLUE;
+	assert(pb.getPixel(0, 0) == BLACK && copy.getPixel(0, 0) == BLUE);
+
+	// a flood fill of a large area doesn't recurse
+	rt::PixelBuffer large(2000, 2000, 32, BLACK);
+	large.drawCircle(1000, 1000, 900, WHITE);
+	large.floodFill(1000, 1000, BLUE);
+	assert(large.getPixel(1000, 1899) == BLUE && large.getPixel(101, 1000) == BLUE);
+	assert(large.getPixel(1000, 1900) == WHITE && large.getPixel(10, 10) == BLACK);
+
+	// filling with the color that is already there does nothing
+	large.floodFill(10, 10, BLACK);
+	large.floodFill(10, 10, rt::RGBAColor(255, 255, 255, 0));
+	assert(large.getPixel(10, 10) == BLACK);
+
+	// the same pixels as filling neighbour by neighbour (edge pixels don't spread)
+	for (int n = 0; n < 200; n++) {
+		rt::PixelBuffer noise(3 + rand() % 20, 3 + rand() % 20, 32);
+		for (auto& pixel : noise.pixels()) { pixel = (rand() % 3) ? BLACK : WHITE; }
+		const int x = rand() % noise.width();
+		const int y = rand() % noise.height();
+		const rt::RGBAColor check = (n % 4 == 0) ? WHITE : noise.getPixel(x, y);
+		rt::PixelBuffer expected = noise;
+		reference_fill(expected, x, y, RED, check);
+		if (n % 4 == 0) {
+			noise.floodFill(x, y, RED, WHITE);
+		} else {
+			noise.floodFill(x, y, RED);
+		}
+		assert(noise.pixels() == expected.pixels());
+	}
+
+	// a large fill reuses the scratch buffer for its spans
+	rt::ScratchBuffer scratch;
+	rt::PixelBuffer dotted(500, 500, 32, BLACK);
+	for (int y = 2; y < 498; y += 2) {
+		for (int x = 2; x < 498; x += 2) { dotted.setPixel(x, y, WHITE); }
+	}
+	dotted.floodFill(1, 1, BLUE, BLACK, scratch);
+	assert(scratch.capacity() > 0);
+	const size_t before = allocations;
+	dotted.floodFill(1, 1, RED, BLUE, scratch);
+	assert(allocations == before);
+	assert(dotted.getPixel(497, 497) == RED && dotted.getPixel(2, 2) == WHITE);
+
+	return 1;
+}
+
+int test_premultiplied()
+{
+	rt::PixelBuffer pb(64, 64, 32, rt::RGBAColor(200, 100, 50, 128));
+	pb.premultiply();
+	assert(pb.premultiplied());
+	assert(pb.at(0, 0) == rt::RGBAColor(100, 50, 25, 128));
+	// colors in and out are straight alpha
+	assert(pb.getPixel(0, 0) == rt::RGBAColor(199, 100, 50, 128));
+	pb.setPixel(1, 1, BLUE);
+	assert(pb.getPixel(1, 1) == BLUE);
+
+	// drawing blends in premultiplied space
+	const rt::RGBAColor halfred(255, 0, 0, 128);
+	pb.fill(BLACK);
+	pb.drawSquareFilled(0, 0, 32, 64, halfred);
+	pb.drawLine(0, 40, 63, 40, halfred);
+	assert(pb.at(10, 10) == rt::RGBAColor(128, 0, 0, 255));
+	assert(pb.getPixel(40, 40) == pb.getPixel(10, 10));
+	assert(pb.getPixel(40, 39) == BLACK);
+
+	// pasting a straight alpha brush converts it
+	rt::PixelBuffer brush(8, 8, 32, halfred);
+	pb.paste(brush, 48, 0);
+	assert(pb.getPixel(50, 2) == pb.getPixel(10, 10));
+
+	pb.floodFill(50, 50, GREEN);
+	assert(pb.getPixel(60, 60) == GREEN && pb.getPixel(50, 20) == BLACK);
+
+	// copies keep the mode, files are straight alpha
+	rt::PixelBuffer copy = pb;
+	assert(copy.premultiplied());
+	rt::PixelBuffer transparent(8, 8, 32, rt::RGBAColor(200, 100, 50, 128));
+	transparent.premultiply();
+	assert(transparent.write("premultiplied.pbf") == 1);
+	rt::PixelBuffer loaded("premultiplied.pbf");
+	assert(!loaded.premultiplied());
+	assert(loaded.getPixel(3, 3) == rt::RGBAColor(199, 100, 50, 128));
+	assert(transparent.writeCompressed("premultiplied.pbf") == 1);
+	assert(loaded.read("premultiplied.pbf") && loaded.getPixel(3, 3) == rt::RGBAColor(199, 100, 50, 128));
+	assert(transparent.premultiplied() && transparent.at(3, 3) == rt::RGBAColor(100, 50, 25, 128));
+
+	transparent.unpremultiply();
+	assert(!transparent.premultiplied() && transparent.at(3, 3) == rt::RGBAColor(199, 100, 50, 128));
+
+	return 1;
+}
+
 int main(void)
 {
 	srand(time(nullptr));
@@ -189,6 +551,14 @@ int main(void)
 
 	rt::run_unit_test("test_create", test_create);
 	rt::run_unit_test("test_drawline", test_drawline);
+	rt::run_unit_test("test_read_write", test_read_write);
+	rt::run_unit_test("test_tga_rle", test_tga_rle);
+	rt::run_unit_test("test_compressed", test_compressed);
+	rt::run_unit_test("test_filled_shapes", test_filled_shapes);
+	rt::run_unit_test("test_no_allocations", test_no_allocations);
+	rt::run_unit_test("test_move_copy_on_write", test_move_copy_on_write);
+	rt::run_unit_test("test_fast_access", test_fast_access);
+	rt::run_unit_test("test_premultiplied", test_premultiplied);
 
 	return 0;
 }
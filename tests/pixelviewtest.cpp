@@ -0,0 +1,142 @@
+#include <iostream>
+#include <cassert>
+
+#include <pixelbuffer/pixelview.h>
+#include <pixelbuffer/pixelbuffer.h>
+#include <pixelbuffer/pbfstream.h>
+#include <pixelbuffer/util.h>
+
+int test_view()
+{
+	rt::PixelBuffer pb(64, 48, 32, BLACK);
+	rt::PixelView all = pb.view();
+	assert(all.width() == 64 && all.height() == 48 && all.stride() == 64);
+	assert(all.contiguous());
+	assert(all.data() == pb.pixels().data());
+
+	// sub views are clipped and share the pixels
+	rt::PixelView tile = pb.view(60, 40, 16, 16);
+	assert(tile.width() == 4 && tile.height() == 8 && tile.stride() == 64);
+	assert(!tile.contiguous());
+	tile.setPixel(1, 2, RED);
+	assert(pb.getPixel(61, 42) == RED);
+	assert(tile.setPixel(4, 0, RED) == 0);
+	assert(tile.getPixel(4, 0) == rt::RGBAColor(0, 0, 0, 0));
+
+	rt::PixelView inner = tile.sub(1, 1, 2, 2);
+	assert(inner.width() == 2 && &inner.at(0, 0) == &pb.pixels()[41 * 64 + 61]);
+	assert(pb.view(70, 0, 10, 10).empty());
+
+	// a PixelView is a ConstPixelView
+	rt::ConstPixelView readonly = tile;
+	assert(readonly.getPixel(1, 2) == RED);
+	const rt::PixelBuffer& cpb = pb;
+	assert(cpb.view(61, 42, 1, 1).at(0, 0) == RED);
+
+	// invalid buffers give an empty view
+	rt::PixelBuffer invalid(8, 8);
+	invalid.pixels().pop_back();
+	assert(invalid.view().empty());
+
+	return 1;
+}
+
+int test_draw_in_place()
+{
+	rt::PixelBuffer pb(64, 64, 32, BLACK);
+
+	// drawing in a tile is clipped to the tile
+	rt::PixelView tile = pb.view(16, 16, 16, 16);
+	tile.fill(BLUE);
+	tile.drawSquareFilled(-4, -4, 8, 8, RED);
+	tile.drawLine(0, 15, 40, 15, GREEN);
+	tile.drawCircleFilled(8, 8, 20, rt::RGBAColor(255, 255, 255, 0));
+	assert(pb.getPixel(16, 16) == RED && pb.getPixel(19, 19) == RED);
+	assert(pb.getPixel(20, 20) == BLUE);
+	assert(pb.getPixel(31, 31) == GREEN);
+	assert(pb.getPixel(32, 31) == BLACK && pb.getPixel(15, 16) == BLACK);
+
+	// filters only touch the tile
+	tile.blur();
+	tile.contrast_8();
+	assert(pb.getPixel(15, 20) == BLACK && pb.getPixel(32, 20) == BLACK);
+
+	// paste a part of one buffer into a part of another
+	rt::PixelBuffer canvas(32, 32, 32, WHITE);
+	canvas.paste(pb.view(16, 16, 4, 4), -2, 30);
+	assert(canvas.getPixel(0, 30) == pb.getPixel(18, 16));
+	assert(canvas.getPixel(1, 31) == pb.getPixel(19, 17));
+	assert(canvas.getPixel(2, 31) == WHITE);
+
+	// a copy of a view
+	rt::PixelBuffer copy(pb.view(16, 16, 16, 16), 24);
+	assert(copy.width() == 16 && copy.bitdepth() == 24);
+	assert(copy.getPixel(15, 15) == pb.getPixel(31, 31));
+	assert(pb.copy(16, 16, 16, 16).pixels() == copy.pixels());
+
+	// copy() still fills what is outside the buffer with transparent
+	rt::PixelBuffer edge = pb.copy(60, 60, 8, 8);
+	assert(edge.getPixel(3, 3) == BLACK);
+	assert(edge.getPixel(4, 4) == rt::RGBAColor(0, 0, 0, 0));
+
+	return 1;
+}
+
+int test_iterator()
+{
+	rt::PixelBuffer pb(16, 8, 32, BLACK);
+	for (size_t i = 0; i < pb.pixels().size(); i++) {
+		pb.pixels()[i] = rt::RGBAColor(i, 0, 0, 255);
+	}
+
+	// row by row, skipping the rest of the buffer
+	rt::ConstPixelView tile = static_cast<const rt::PixelBuffer&>(pb).view(14, 5, 4, 4);
+	std::vector<uint8_t> values;
+	for (const rt::RGBAColor& color : tile) {
+		values.push_back(color.r);
+	}
+	const uint8_t expected[] = { 5*16+14, 5*16+15, 6*16+14, 6*16+15, 7*16+14, 7*16+15 };
+	assert(values == std::vector<uint8_t>(expected, expected + 6));
+
+	// the whole buffer, written through the iterator
+	size_t count = 0;
+	for (rt::RGBAColor& color : pb.view()) {
+		color = BLUE;
+		count++;
+	}
+	assert(count == 16 * 8 && pb.getPixel(15, 7) == BLUE);
+	assert(std::distance(pb.view(2, 2, 3, 3).begin(), pb.view(2, 2, 3, 3).end()) == 9);
+
+	rt::PixelView empty;
+	assert(empty.begin() == empty.end());
+
+	return 1;
+}
+
+int test_write_view()
+{
+	rt::PixelBuffer pb(64, 64, 32, BLACK);
+	pb.drawCircleFilled(32, 32, 20, RED);
+
+	rt::PbfWriter writer("pixelview.pbf", 16, 16, 24);
+	assert(writer.writeRows(pb.view(24, 24, 16, 8)) == 8);
+	assert(writer.writeRows(pb.view(24, 32, 16, 8)) == 8);
+	assert(writer.close() == 1);
+
+	rt::PixelBuffer tile("pixelview.pbf");
+	assert(tile.pixels() == rt::PixelBuffer(pb.view(24, 24, 16, 16)).pixels());
+
+	return 1;
+}
+
+int main(void)
+{
+	rt::run_unit_test("test_view", test_view);
+	rt::run_unit_test("test_draw_in_place", test_draw_in_place);
+	rt::run_unit_test("test_iterator", test_iterator);
+	rt::run_unit_test("test_write_view", test_write_view);
+
+	std::cout << "## finished ##" << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,117 @@
+#include <iostream>
+#include <cassert>
+
+#include <pixelbuffer/planarbuffer.h>
+#include <pixelbuffer/util.h>
+
+rt::PixelBuffer testimage(uint16_t width, uint16_t height)
+{
+	rt::PixelBuffer pb(width, height, 32);
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			pb.setPixel(x, y, rt::RGBAColor(x * 3 + 20, y * 7, (x * y) & 0xFF, 255 - x));
+		}
+	}
+	return pb;
+}
+
+int test_layout()
+{
+	rt::PlanarBuffer planar(testimage(70, 33));
+	assert(planar.valid());
+	assert(planar.stride() == 128);
+	for (int c = 0; c < 4; c++) {
+		for (size_t y = 0; y < planar.height(); y++) {
+			assert((uintptr_t) planar.row(c, y) % rt::PlanarBuffer::ALIGNMENT == 0);
+		}
+	}
+
+	// copies are aligned too
+	rt::PlanarBuffer copy = planar;
+	assert((uintptr_t) copy.plane(rt::PlanarBuffer::G) % rt::PlanarBuffer::ALIGNMENT == 0);
+	assert(copy.getPixel(5, 6) == planar.getPixel(5, 6));
+
+	rt::PlanarBuffer moved = std::move(copy);
+	assert(moved.getPixel(5, 6) == planar.getPixel(5, 6));
+	assert(!copy.valid());
+
+	return 1;
+}
+
+int test_interleave()
+{
+	// odd widths cover both the 16 pixel and the single pixel loops
+	const uint16_t widths[] = { 1, 15, 16, 17, 64, 203 };
+	for (uint16_t width : widths) {
+		rt::PixelBuffer pb = testimage(width, 9);
+		rt::PlanarBuffer planar(pb);
+		assert(planar.getPixel(width - 1, 8) == pb.getPixel(width - 1, 8));
+		assert(planar.row(rt::PlanarBuffer::B, 3)[width / 2] == pb.getPixel(width / 2, 3).b);
+		assert(planar.toPixelBuffer().pixels() == pb.pixels());
+	}
+
+	// premultiplied pixels are split in straight alpha
+	rt::PixelBuffer premultiplied(20, 20, 32, rt::RGBAColor(200, 100, 50, 128));
+	premultiplied.premultiply();
+	rt::PlanarBuffer straight(premultiplied);
+	assert(straight.getPixel(5, 5) == premultiplied.getPixel(5, 5));
+	straight.toPixelBuffer(premultiplied);
+	assert(!premultiplied.premultiplied() && premultiplied.pixels()[0] == straight.getPixel(0, 0));
+
+	return 1;
+}
+
+int test_filters()
+{
+	rt::PixelBuffer pb = testimage(100, 40);
+
+	// same results as PixelBuffer
+	rt::PixelBuffer contrast = pb;
+	contrast.contrast_8();
+	rt::PlanarBuffer planar(pb);
+	planar.contrast_8();
+	assert(planar.toPixelBuffer().pixels() == contrast.pixels());
+
+	for (uint8_t levels = 1; levels < 12; levels++) {
+		rt::PixelBuffer posterized = pb;
+		posterized.posterize_8(levels);
+		planar.fromPixelBuffer(pb);
+		planar.posterize_8(levels);
+		assert(planar.toPixelBuffer().pixels() == posterized.pixels());
+	}
+
+	// blur against a straightforward 3x3 box blur
+	const int sharpnesses[] = { 1, 3, 50 };
+	for (int sharpness : sharpnesses) {
+		planar.fromPixelBuffer(pb);
+		planar.blur(sharpness);
+		for (int y = 0; y < pb.height(); y += 13) {
+			for (int x = 0; x < pb.width(); x += 11) {
+				int total[4] = { 0, 0, 0, 0 };
+				for (int r = -1; r < 2; r++) {
+					for (int c = -1; c < 2; c++) {
+						rt::vec2i n = rt::clamp(rt::vec2i(x+c, y+r), pb.width(), pb.height());
+						rt::RGBAColor color = pb.getPixel(n.x, n.y);
+						int weight = (r == 0 && c == 0) ? sharpness : 1;
+						for (int i = 0; i < 4; i++) { total[i] += color[i] * weight; }
+					}
+				}
+				rt::RGBAColor blurred = planar.getPixel(x, y);
+				for (int i = 0; i < 4; i++) { assert(blurred[i] == total[i] / (8 + sharpness)); }
+			}
+		}
+	}
+
+	return 1;
+}
+
+int main(void)
+{
+	rt::run_unit_test("test_layout", test_layout);
+	rt::run_unit_test("test_interleave", test_interleave);
+	rt::run_unit_test("test_filters", test_filters);
+
+	std::cout << "## finished ##" << std::endl;
+
+	return 0;
+}
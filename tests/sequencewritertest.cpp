@@ -0,0 +1,62 @@
+#include <iostream>
+#include <cassert>
+
+#include <pixelbuffer/sequencewriter.h>
+#include <pixelbuffer/util.h>
+
+int test_sequence()
+{
+	const int frames = 24;
+	rt::PixelBuffer pb(64, 48, 32, BLACK);
+	std::vector<std::string> filenames;
+	{
+		rt::SequenceWriter writer("sequence", 0, 3);
+		for (int i = 0; i < frames; i++) {
+			pb.fill(BLACK);
+			pb.drawLine(i, 0, i, 47, rt::RGBAColor(i * 10, 255, 0));
+			filenames.push_back(writer.write(pb));
+			// the frame can be changed right away, the writer has its own copy
+			pb.fill(WHITE);
+		}
+		assert(writer.counter() == frames);
+	} // destructor waits for the last frames
+
+	assert(filenames[0] == pb.createFilename("sequence", 0));
+	assert(filenames[17] == pb.createFilename("sequence", 17));
+
+	for (int i = 0; i < frames; i++) {
+		rt::PixelBuffer read(filenames[i]);
+		assert(read.valid());
+		assert(read.getPixel(i, 20) == rt::RGBAColor(i * 10, 255, 0));
+		assert(read.getPixel((i + 1) % 64, 20) == BLACK);
+	}
+
+	return 1;
+}
+
+int test_sequence_compressed()
+{
+	rt::PixelBuffer pb(32, 32, 24, RED);
+	rt::SequenceWriter writer("compressedsequence", 100, 2, 4, true);
+	std::string filename = writer.write(pb);
+	writer.close();
+	assert(writer.written() == 1);
+	assert(writer.failed() == 0);
+	assert(writer.write(pb) == ""); // closed
+
+	assert(filename == pb.createFilename("compressedsequence", 100));
+	rt::PixelBuffer read(filename);
+	assert(read.pixels() == pb.pixels());
+
+	return 1;
+}
+
+int main(void)
+{
+	rt::run_unit_test("test_sequence", test_sequence);
+	rt::run_unit_test("test_sequence_compressed", test_sequence_compressed);
+
+	std::cout << "## finished ##" << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,151 @@
+#include <iostream>
+#include <cassert>
+
+#include <pixelbuffer/sparsecanvas.h>
+#include <pixelbuffer/util.h>
+
+int test_lazy_tiles()
+{
+	rt::SparseCanvas canvas(200000, 200000);
+	assert(canvas.width() == 200000 && canvas.tilesX() == 782);
+	assert(canvas.tiles() == 0);
+	assert(canvas.getPixel(150000, 150000) == TRANSPARENT);
+	assert(canvas.getPixel(200000, 0) == rt::RGBAColor(0, 0, 0, 0));
+
+	// writing the background allocates nothing
+	canvas.setPixel(5, 5, TRANSPARENT);
+	canvas.drawSquareFilled(0, 0, 1000, 1000, rt::RGBAColor(255, 0, 0, 0));
+	assert(canvas.tiles() == 0);
+
+	// so does pasting transparent pixels
+	rt::PixelBuffer brush(16, 16, 32, TRANSPARENT);
+	canvas.paste(brush, 248, 248);
+	assert(canvas.tiles() == 0);
+	brush.view(8, 0, 8, 16).fill(RED);
+	canvas.paste(brush, 248, 248);
+	assert(canvas.tiles() == 2 && canvas.getPixel(256, 263) == RED);
+	canvas.clear();
+
+	canvas.setPixel(199999, 199999, RED);
+	assert(canvas.tiles() == 1 && canvas.getPixel(199999, 199999) == RED);
+	assert(canvas.setPixel(-1, 5, RED) == 0 && canvas.setPixel(200000, 5, RED) == 0);
+
+	// a line across the whole canvas only touches the tiles on the diagonal
+	canvas.drawLine(0, 0, 199999, 199999, GREEN);
+	assert(canvas.getPixel(123456, 123456) == GREEN);
+	assert(canvas.tiles() == 782);
+	assert(canvas.memoryUsage() == 782 * rt::SparseCanvas::TILE_PIXELS * sizeof(rt::RGBAColor));
+
+	// far outside the canvas is clipped
+	canvas.drawCircle(100000, 100000, 2000000000, BLUE);
+	canvas.drawLine(-2000000000, 5, 2000000000, 5, BLUE);
+	assert(canvas.getPixel(0, 5) == BLUE && canvas.getPixel(199999, 5) == BLUE);
+	assert(canvas.tiles() == 782 + 781);
+
+	canvas.clear();
+	assert(canvas.tiles() == 0 && canvas.getPixel(199999, 199999) == TRANSPARENT);
+
+	return 1;
+}
+
+int test_same_as_pixelbuffer()
+{
+	// drawing at an offset on the canvas gives the same pixels as on a PixelBuffer
+	const int ox = 100000 - 150;
+	const int oy = 70000 - 100;
+	rt::SparseCanvas canvas(150000, 150000, BLACK);
+	rt::PixelBuffer pb(300, 200, 32, BLACK);
+	const rt::RGBAColor halfred(255, 0, 0, 128);
+
+	pb.drawLine(3, 190, 290, 7, WHITE);
+	canvas.drawLine(ox + 3, oy + 190, ox + 290, oy + 7, WHITE);
+	pb.drawSquare(10, 10, 200, 100, GREEN);
+	canvas.drawSquare(ox + 10, oy + 10, 200, 100, GREEN);
+	pb.drawSquareFilled(100, 50, 150, 120, halfred);
+	canvas.drawSquareFilled(ox + 100, oy + 50, 150, 120, halfred);
+	pb.drawCircle(150, 100, 90, BLUE);
+	canvas.drawCircle(ox + 150, oy + 100, 90, BLUE);
+	pb.drawCircleFilled(60, 150, 40, rt::RGBAColor(0, 255, 255, 100));
+	canvas.drawCircleFilled(ox + 60, oy + 150, 40, rt::RGBAColor(0, 255, 255, 100));
+
+	rt::PixelBuffer brush(64, 64, 32, rt::RGBAColor(255, 255, 0, 200));
+	brush.drawLine(0, 0, 63, 63, RED);
+	pb.paste(brush, 220, 120);
+	canvas.paste(brush, ox + 220, oy + 120);
+
+	rt::PixelBuffer part = canvas.copy(ox, oy, 300, 200);
+	assert(part.pixels() == pb.pixels());
+
+	// outside of the canvas is transparent
+	rt::PixelBuffer edge = canvas.copy(149990, 0, 20, 2);
+	assert(edge.getPixel(9, 0) == BLACK && edge.getPixel(10, 0) == rt::RGBAColor(0, 0, 0, 0));
+
+	// a tile, in place
+	rt::PixelView tile = canvas.tileView(0, 0);
+	tile.fill(RED);
+	assert(canvas.getPixel(255, 255) == RED && canvas.getPixel(256, 256) == BLACK);
+	assert(canvas.tileView(585, 0).width() == 150000 - 585 * 256);
+	assert(canvas.tileView(586, 0).empty());
+
+	return 1;
+}
+
+int test_read_write()
+{
+	rt::SparseCanvas canvas(100000, 70000, rt::RGBAColor(10, 20, 30, 255));
+	canvas.drawCircleFilled(99990, 69990, 300, RED);
+	canvas.drawLine(0, 0, 5000, 60000, GREEN);
+	assert(canvas.write("sparsecanvas.pba") == 1);
+
+	rt::SparseCanvas loaded("sparsecanvas.pba");
+	assert(loaded.width() == 100000 && loaded.height() == 70000);
+	assert(loaded.background() == canvas.background());
+	assert(loaded.tiles() == canvas.tiles());
+	assert(loaded.tileList() == canvas.tileList());
+	assert(loaded.getPixel(99999, 69999) == RED);
+	assert(loaded.copy(99700, 69700, 300, 300).pixels() == canvas.copy(99700, 69700, 300, 300).pixels());
+	assert(loaded.copy(2000, 24000, 300, 300).pixels() == canvas.copy(2000, 24000, 300, 300).pixels());
+
+	assert(canvas.write("sparsecanvas.pba", false) == 1);
+	assert(loaded.read("sparsecanvas.pba") == 1);
+	assert(loaded.getPixel(5000, 60000) == GREEN);
+
+	// a pbf is not a canvas
+	rt::PixelBuffer(8, 8).write("notacanvas.pbf");
+	assert(loaded.read("notacanvas.pbf") == 0);
+
+	return 1;
+}
+
+int test_premultiplied_brush()
+{
+	// a premultiplied brush is pasted like PixelView::paste does it
+	rt::PixelBuffer brush(40, 30, 32, rt::RGBAColor(200, 100, 50, 128));
+	brush.drawLine(0, 0, 39, 29, RED);
+	brush.premultiply();
+	rt::PixelBuffer pb(300, 300, 32, BLACK);
+	rt::SparseCanvas canvas(100000, 100000, BLACK);
+	pb.paste(brush, 240, 250);
+	canvas.paste(brush, 240, 250);
+	assert(canvas.copy(0, 0, 300, 300).pixels() == pb.pixels());
+	assert(canvas.getPixel(260, 251).r == pb.getPixel(260, 251).r && canvas.getPixel(260, 251).r > 90);
+
+	// and written and read back
+	assert(canvas.write("sparsepm.pba") == 1);
+	rt::SparseCanvas loaded("sparsepm.pba");
+	assert(loaded.copy(200, 200, 100, 100).pixels() == pb.copy(200, 200, 100, 100).pixels());
+
+	return 1;
+}
+
+int main(void)
+{
+	rt::run_unit_test("test_lazy_tiles", test_lazy_tiles);
+	rt::run_unit_test("test_same_as_pixelbuffer", test_same_as_pixelbuffer);
+	rt::run_unit_test("test_read_write", test_read_write);
+	rt::run_unit_test("test_premultiplied_brush", test_premultiplied_brush);
+
+	std::cout << "## finished ##" << std::endl;
+
+	return 0;
+}
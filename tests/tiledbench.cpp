@@ -0,0 +1,127 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+
+#include <pixelbuffer/tiledbuffer.h>
+#include <pixelbuffer/planarbuffer.h>
+#include <pixelbuffer/util.h>
+
+// Row major (PixelBuffer) vs tiled (TiledBuffer) storage for column access,
+// vertical lines and the same 3x3 filter.
+// usage: tiledbench [size]
+
+double seconds_since(std::chrono::time_point<std::chrono::high_resolution_clock> start)
+{
+	std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - start;
+	return duration.count();
+}
+
+// sum all pixels column by column
+template <class Buffer>
+uint64_t sum_columns(const Buffer& buffer)
+{
+	uint64_t total = 0;
+	for (int x = 0; x < buffer.width(); x++) {
+		for (int y = 0; y < buffer.height(); y++) {
+			total += buffer.getPixel(x, y).r;
+		}
+	}
+	return total;
+}
+
+// a vertical line in every column
+template <class Buffer>
+void vertical_lines(Buffer& buffer)
+{
+	for (int x = 0; x < buffer.width(); x++) {
+		buffer.drawLine(x, 0, x, buffer.height() - 1, rt::RGBAColor(x, 0, 0, 255));
+	}
+}
+
+// 3x3 box blur from the original image on row major pixels: TiledBuffer::blur
+// without the tiles
+rt::PixelBuffer blur_rowmajor(const rt::PixelBuffer& pb, int sharpness)
+{
+	const int width = pb.width();
+	const int height = pb.height();
+	const int divisor = 8 + sharpness;
+	rt::PixelBuffer result(width, height, 32);
+	const rt::RGBAColor* src = pb.pixels().data();
+	rt::RGBAColor* dst = result.pixels().data();
+	for (int y = 0; y < height; y++) {
+		const rt::RGBAColor* above = src + std::max(y - 1, 0) * width;
+		const rt::RGBAColor* row = src + y * width;
+		const rt::RGBAColor* below = src + std::min(y + 1, height - 1) * width;
+		for (int x = 0; x < width; x++) {
+			const int l = std::max(x - 1, 0);
+			const int r = std::min(x + 1, width - 1);
+			const int red = above[l].r + above[x].r + above[r].r + row[l].r + row[x].r * sharpness + row[r].r + below[l].r + below[x].r + below[r].r;
+			const int green = above[l].g + above[x].g + above[r].g + row[l].g + row[x].g * sharpness + row[r].g + below[l].g + below[x].g + below[r].g;
+			const int blue = above[l].b + above[x].b + above[r].b + row[l].b + row[x].b * sharpness + row[r].b + below[l].b + below[x].b + below[r].b;
+			const int alpha = above[l].a + above[x].a + above[r].a + row[l].a + row[x].a * sharpness + row[r].a + below[l].a + below[x].a + below[r].a;
+			dst[y * width + x] = rt::RGBAColor(red / divisor, green / divisor, blue / divisor, alpha / divisor);
+		}
+	}
+	return result;
+}
+
+void report(const char* name, double rowmajor, double tiled)
+{
+	std::cout << std::setw(16) << std::left << name << std::right << std::fixed << std::setprecision(3)
+		<< std::setw(10) << rowmajor << std::setw(10) << tiled
+		<< std::setw(9) << std::setprecision(2) << rowmajor / tiled << "x" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	uint16_t size = 4096;
+	if (argc > 1) { size = std::max(64, std::min(65535, atoi(argv[1]))); }
+
+	rt::PixelBuffer pb(size, size, 32);
+	for (size_t i = 0; i < pb.pixels().size(); i++) {
+		pb.pixels()[i] = rt::RGBAColor(i, i >> 8, i >> 16, 255);
+	}
+	rt::TiledBuffer tb(pb);
+	std::cout << size << "x" << size << " pixels" << std::endl;
+	std::cout << "(seconds)       rowmajor     tiled  speedup" << std::endl;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	uint64_t a = sum_columns(pb);
+	double rowmajor = seconds_since(start);
+	start = std::chrono::high_resolution_clock::now();
+	uint64_t b = sum_columns(tb);
+	report("columns", rowmajor, seconds_since(start));
+	if (a != b) { std::cout << "column sums differ" << std::endl; return 1; }
+
+	start = std::chrono::high_resolution_clock::now();
+	vertical_lines(pb);
+	rowmajor = seconds_since(start);
+	start = std::chrono::high_resolution_clock::now();
+	vertical_lines(tb);
+	report("vertical lines", rowmajor, seconds_since(start));
+
+	// the same filter (TiledBuffer::blur) on both layouts, PlanarBuffer::blur
+	// is that filter on row major planes
+	rt::PixelBuffer original = pb;
+	start = std::chrono::high_resolution_clock::now();
+	rt::PixelBuffer blurred = blur_rowmajor(pb, 2);
+	rowmajor = seconds_since(start);
+	start = std::chrono::high_resolution_clock::now();
+	tb.blur(2);
+	report("blur", rowmajor, seconds_since(start));
+	if (blurred.pixels() != tb.toPixelBuffer().pixels()) { std::cout << "blurred pixels differ" << std::endl; return 1; }
+
+	rt::PlanarBuffer planar(original);
+	start = std::chrono::high_resolution_clock::now();
+	planar.blur(2);
+	std::cout << "blur (planar)   " << std::fixed << std::setprecision(3) << std::setw(10) << seconds_since(start) << std::endl;
+
+	start = std::chrono::high_resolution_clock::now();
+	pb.flipRows();
+	rowmajor = seconds_since(start);
+	start = std::chrono::high_resolution_clock::now();
+	tb.flipRows();
+	report("flipRows", rowmajor, seconds_since(start));
+
+	return 0;
+}
@@ -0,0 +1,108 @@
+#include <iostream>
+#include <cassert>
+
+#include <pixelbuffer/tiledbuffer.h>
+#include <pixelbuffer/planarbuffer.h>
+#include <pixelbuffer/util.h>
+
+// an image with a different color for every pixel
+rt::PixelBuffer pattern(uint16_t width, uint16_t height)
+{
+	rt::PixelBuffer pb(width, height, 32);
+	for (size_t y = 0; y < height; y++) {
+		for (size_t x = 0; x < width; x++) {
+			pb.setPixel(x, y, rt::RGBAColor(x * 7, y * 13, x ^ y, 128 + (x + y) % 128));
+		}
+	}
+	return pb;
+}
+
+int test_layout()
+{
+	rt::TiledBuffer tb(100, 70, 24, RED);
+	assert(tb.valid());
+	assert(tb.tilesX() == 2 && tb.tilesY() == 2);
+	assert(tb.bitdepth() == 24);
+	assert(tb.getPixel(99, 69) == RED);
+	assert(tb.getPixel(100, 0) == rt::RGBAColor(0, 0, 0, 0));
+	assert(tb.setPixel(0, 70, BLUE) == 0);
+
+	// 64x64 tiles, row major within a tile
+	tb.setPixel(65, 2, BLUE);
+	assert(tb.tile(1, 0)[2 * rt::TiledBuffer::TILE + 1] == BLUE);
+	tb.setPixel(3, 64, GREEN);
+	assert(tb.tile(0, 1)[3] == GREEN);
+
+	return 1;
+}
+
+int test_conversion()
+{
+	rt::PixelBuffer pb = pattern(100, 70);
+	pb.bitdepth(24);
+	rt::TiledBuffer tb(pb);
+	assert(tb.width() == 100 && tb.height() == 70 && tb.bitdepth() == 24);
+	for (int y = 0; y < 70; y++) {
+		for (int x = 0; x < 100; x++) {
+			assert(tb.getPixel(x, y) == pb.getPixel(x, y));
+		}
+	}
+	rt::PixelBuffer back = tb.toPixelBuffer();
+	assert(back.pixels() == pb.pixels() && back.bitdepth() == 24);
+
+	// file i/o through a row major PixelBuffer
+	rt::TiledBuffer tiles(pattern(130, 65));
+	assert(tiles.write("tiledbuffer.pbf") == 1);
+	rt::TiledBuffer loaded("tiledbuffer.pbf");
+	assert(loaded.toPixelBuffer().pixels() == tiles.toPixelBuffer().pixels());
+
+	// premultiplied pixels are stored in straight alpha
+	rt::PixelBuffer premultiplied(70, 70, 32, rt::RGBAColor(200, 100, 50, 128));
+	premultiplied.premultiply();
+	rt::TiledBuffer straight(premultiplied);
+	assert(straight.getPixel(65, 65) == premultiplied.getPixel(65, 65));
+	straight.toPixelBuffer(premultiplied);
+	assert(!premultiplied.premultiplied() && premultiplied.pixels()[0] == straight.getPixel(0, 0));
+
+	return 1;
+}
+
+int test_draw_and_filter()
+{
+	// drawing gives the same pixels as PixelBuffer
+	rt::PixelBuffer pb(150, 90, 32, BLACK);
+	rt::TiledBuffer tb(150, 90, 32, BLACK);
+	const rt::RGBAColor halfred(255, 0, 0, 128);
+	pb.drawLine(3, 1, 140, 88, WHITE);
+	tb.drawLine(3, 1, 140, 88, WHITE);
+	pb.drawSquare(10, 10, 100, 60, GREEN);
+	tb.drawSquare(10, 10, 100, 60, GREEN);
+	pb.drawSquareFilled(60, 50, 100, 100, halfred);
+	tb.drawSquareFilled(60, 50, 100, 100, halfred);
+	assert(tb.toPixelBuffer().pixels() == pb.pixels());
+
+	pb.flipRows();
+	tb.flipRows();
+	assert(tb.toPixelBuffer().pixels() == pb.pixels());
+
+	// blurring from the original image, like PlanarBuffer
+	rt::PixelBuffer image = pattern(150, 90);
+	rt::TiledBuffer tiled(image);
+	rt::PlanarBuffer planar(image);
+	tiled.blur(3);
+	planar.blur(3);
+	assert(tiled.toPixelBuffer().pixels() == planar.toPixelBuffer().pixels());
+
+	return 1;
+}
+
+int main(void)
+{
+	rt::run_unit_test("test_layout", test_layout);
+	rt::run_unit_test("test_conversion", test_conversion);
+	rt::run_unit_test("test_draw_and_filter", test_draw_and_filter);
+
+	std::cout << "## finished ##" << std::endl;
+
+	return 0;
+}
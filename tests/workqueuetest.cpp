@@ -0,0 +1,70 @@
+#include <iostream>
+#include <cassert>
+#include <thread>
+#include <vector>
+
+#include <pixelbuffer/workqueue.h>
+#include <pixelbuffer/util.h>
+
+int test_fifo()
+{
+	rt::BoundedQueue<int> queue(4);
+	assert(queue.capacity() == 4);
+	assert(queue.push(1));
+	assert(queue.push(2));
+	assert(queue.push(3));
+	assert(queue.size() == 3);
+
+	int value = 0;
+	assert(queue.pop(value) && value == 1);
+	assert(queue.pop(value) && value == 2);
+
+	queue.close();
+	assert(!queue.push(4));
+	assert(queue.pop(value) && value == 3); // drain after close
+	assert(!queue.pop(value));
+
+	return 1;
+}
+
+int test_producer_consumer()
+{
+	rt::BoundedQueue<int> queue(2);
+	const int count = 10000;
+
+	std::vector<long> sums(4, 0);
+	std::vector<std::thread> consumers;
+	for (size_t i = 0; i < sums.size(); i++) {
+		consumers.emplace_back([&queue, &sums, i] {
+			int value;
+			while (queue.pop(value)) {
+				sums[i] += value;
+			}
+		});
+	}
+
+	for (int i = 1; i <= count; i++) {
+		assert(queue.push(i));
+		assert(queue.size() <= queue.capacity());
+	}
+	queue.close();
+	for (auto& consumer : consumers) {
+		consumer.join();
+	}
+
+	long total = 0;
+	for (long sum : sums) { total += sum; }
+	assert(total == (long) count * (count + 1) / 2);
+
+	return 1;
+}
+
+int main(void)
+{
+	rt::run_unit_test("test_fifo", test_fifo);
+	rt::run_unit_test("test_producer_consumer", test_producer_consumer);
+
+	std::cout << "## finished ##" << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,147 @@
+/**
+ * @file pbfbatch.cpp
+ * @brief Convert all .pbf files in a directory to .tga (or .tga to .pbf) on all cores
+ * @see https://github.com/rktrlng/pixelbuffer
+ *
+ * usage: pbfbatch <tga|pbf> <inputdir> [outputdir] [threads]
+ *
+ *   pbfbatch tga frames          # frames/name.pbf => frames/name.tga
+ *   pbfbatch pbf frames out 8    # frames/name.tga => out/name.pbf, 8 threads
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <cctype>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <pixelbuffer/pixelbuffer.h>
+#include <pixelbuffer/workqueue.h>
+
+struct Job
+{
+	std::string input;
+	std::string output;
+};
+
+struct Stats
+{
+	std::atomic<size_t> frames{0};
+	std::atomic<size_t> failed{0};
+	std::atomic<size_t> bytesin{0};
+	std::atomic<size_t> bytesout{0};
+};
+
+static std::string extension(const std::string& filename)
+{
+	size_t dot = filename.find_last_of('.');
+	if (dot == std::string::npos) { return ""; }
+	std::string ext = filename.substr(dot + 1);
+	std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+	return ext;
+}
+
+static size_t filesize(const std::string& filename)
+{
+	struct stat st;
+	if (stat(filename.c_str(), &st) != 0) { return 0; }
+	return st.st_size;
+}
+
+static void convert(const Job& job, const std::string& type, Stats& stats)
+{
+	rt::PixelBuffer pb;
+	int size = 0;
+	int written = 0;
+	if (type == "tga") {
+		size = pb.read(job.input);
+		if (size) { written = pb.writeTGA(job.output); }
+	} else {
+		size = pb.fromTGA(job.input);
+		if (size) { written = pb.write(job.output); }
+	}
+
+	if (!size || !written) {
+		stats.failed++;
+		std::cout << "Unable to convert: " << job.input << std::endl;
+		return;
+	}
+	stats.frames++;
+	stats.bytesin += size;
+	stats.bytesout += filesize(job.output);
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3) {
+		std::cout << "usage: pbfbatch <tga|pbf> <inputdir> [outputdir] [threads]" << std::endl;
+		return 1;
+	}
+
+	const std::string type = argv[1];
+	const std::string inputdir = argv[2];
+	const std::string outputdir = argc > 3 ? argv[3] : argv[2];
+	unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+	if (argc > 4) { threads = std::max(1, atoi(argv[4])); }
+
+	if (type != "tga" && type != "pbf") {
+		std::cout << "Unknown type: " << type << " (use tga or pbf)" << std::endl;
+		return 1;
+	}
+	const std::string source = (type == "tga") ? "pbf" : "tga";
+
+	DIR* dir = opendir(inputdir.c_str());
+	if (dir == nullptr) {
+		std::cout << "Unable to open directory: " << inputdir << std::endl;
+		return 1;
+	}
+
+	// a few jobs per thread is enough to keep every core busy
+	rt::BoundedQueue<Job> queue(threads * 4);
+	Stats stats;
+
+	std::vector<std::thread> workers;
+	for (unsigned i = 0; i < threads; i++) {
+		workers.emplace_back([&queue, &stats, &type] {
+			Job job;
+			while (queue.pop(job)) {
+				convert(job, type, stats);
+			}
+		});
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	struct dirent* entry;
+	while ((entry = readdir(dir)) != nullptr) {
+		std::string name = entry->d_name;
+		if (extension(name) != source) { continue; }
+		std::string base = name.substr(0, name.find_last_of('.'));
+		queue.push( { inputdir + "/" + name, outputdir + "/" + base + "." + type } );
+	}
+	closedir(dir);
+
+	queue.close();
+	for (auto& worker : workers) {
+		worker.join();
+	}
+
+	std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - start;
+	double seconds = std::max(duration.count(), 1e-9);
+	double mbin = stats.bytesin / 1024.0 / 1024.0;
+	double mbout = stats.bytesout / 1024.0 / 1024.0;
+
+	std::cout << "converted: " << stats.frames << " frames (" << stats.failed << " failed) with " << threads << " threads" << std::endl;
+	std::cout << "time: " << seconds << " s" << std::endl;
+	std::cout << "throughput: " << stats.frames / seconds << " frames/s | ";
+	std::cout << mbin / seconds << " MB/s read | " << mbout / seconds << " MB/s written" << std::endl;
+
+	return stats.failed > 0;
+}